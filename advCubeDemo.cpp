@@ -4,60 +4,150 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
+#include <sstream>
+#include <iomanip>
 #include <vector>
+#include <cmath>
+#include "shapes.h"
+#include "meshFile.h"
+#include "objectConstants.h"
+#include "frameStats.h"
+#include "clusteredLights.h"
+#include "deferredShading.h"
+#include "shadowMaps.h"
+#include "renderQueue.h"
+#include "dynamicResolution.h"
+#include "shaderUtil.h"
+
+// The cube lit by one light, or a floor of cubes lit by up to 1000 moving
+// point lights through clustered forward shading (see clusteredLights.h).
+// L switches between the two, N cycles 10, 100 and 1000 lights and V shows
+// how many lights each cluster holds (blue none, red 32 or more).
+//
+// G switches to deferred shading (see deferredShading.h) and T between its
+// compact and wide G-buffer. B times forward against both G-buffers at
+// three resolutions and light counts and prints the table.
+//
+// A dim sun casts cascaded shadows (see shadowMaps.h). The floor and most
+// cubes are static casters whose shadow maps are cached; one row of cubes
+// bounces and is drawn over the cache every frame. H toggles the sun and J
+// sets it moving, which forces the caches to be redrawn.
+//
+// The scene is drawn offscreen at a resolution that follows a frame time
+// target and scaled up to the window (see dynamicResolution.h). R toggles
+// this and F switches the upscale between sharpened and plain bilinear.
 
 const char* vertexShaderSource = R"glsl(
 #version 330 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 
+uniform mat4 mvp;           // per-object constants, see objectConstants.h
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform vec3 lightPos;
-uniform vec3 viewPos;
+uniform mat3 normalMatrix;
+uniform vec3 positionScale;  // packed vertex decode, see vertexCompress.h
+uniform vec3 positionBias;
+uniform bool octahedralNormals;
 
 out vec3 FragPos;
 out vec3 Normal;
-out vec3 LightPos;
-out vec3 ViewPos;
+
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
-    LightPos = lightPos;
-    ViewPos = viewPos;
-    gl_Position = projection * view * vec4(FragPos, 1.0);
+    vec3 normal = octahedralNormals ? decodeOctahedral(aNormal.xy) : aNormal;
+    vec4 position = vec4(aPos * positionScale + positionBias, 1.0);
+    FragPos = vec3(model * position);
+    Normal = normalMatrix * normal;
+    gl_Position = mvp * position;
 }
 )glsl";
 
-const char* fragmentShaderSource = R"glsl(
-#version 330 core
+const char* fragmentShaderSource = "#version 330 core\n" CLUSTERED_LIGHTS_GLSL SHADOW_MAPS_GLSL R"glsl(
 out vec4 FragColor;
 
 in vec3 FragPos;
 in vec3 Normal;
-in vec3 LightPos;
-in vec3 ViewPos;
+
+uniform vec3 lightPos;
+uniform vec3 viewPos;
+uniform vec3 albedo = vec3(1.0, 0.65, 0.0); // Orange color
+uniform bool clustered;
+uniform bool shadows;
+uniform vec3 sunDir;    // direction the sunlight travels
+uniform vec3 sunColor;
 
 void main()
 {
+    vec3 norm = normalize(Normal);
+    vec3 sun = shadows ? albedo * sunColor * (max(dot(norm, -sunDir), 0.0) * shadowFactor(FragPos, norm)) : vec3(0.0);
+    if (clustered) {
+        FragColor = vec4(albedo * 0.05 + sun + clusteredLighting(FragPos, norm, albedo), 1.0);
+        return;
+    }
+
     // Ambient light
     float ambientStrength = 0.5;
-    vec3 ambient = ambientStrength * vec3(1.0, 0.65, 0.0); // Orange color
+    vec3 ambient = ambientStrength * albedo;
 
     // Diffuse light
-    vec3 norm = normalize(Normal);
-    vec3 lightDir = normalize(LightPos - FragPos);
+    vec3 lightDir = normalize(lightPos - FragPos);
     float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = diff * vec3(1.0, 0.65, 0.0); // Orange color
+    vec3 diffuse = diff * albedo;
 
-    vec3 result = (ambient + diffuse);
+    vec3 result = (ambient + diffuse) + sun;
     FragColor = vec4(result, 1.0);
 }
 )glsl";
 
+// Deferred geometry pass, used with vertexShaderSource
+const char* gBufferFragmentSource = "#version 330 core\n" DEFERRED_GBUFFER_GLSL R"glsl(
+in vec3 FragPos;
+in vec3 Normal;
+
+uniform vec3 albedo = vec3(1.0, 0.65, 0.0);
+
+void main()
+{
+    writeGBuffer(FragPos, normalize(Normal), albedo);
+}
+)glsl";
+
+// Deferred lighting pass: the forward shader's lighting, once per pixel
+const char* lightingFragmentSource = "#version 330 core\n" CLUSTERED_LIGHTS_GLSL SHADOW_MAPS_GLSL DEFERRED_RESOLVE_GLSL R"glsl(
+out vec4 FragColor;
+
+uniform vec3 lightPos;
+uniform bool clustered;
+uniform bool shadows;
+uniform vec3 sunDir;
+uniform vec3 sunColor;
+
+void main()
+{
+    vec3 fragPos, norm, albedo;
+    float depth;
+    if (!readGBuffer(fragPos, norm, albedo, depth))
+        discard;
+    vec3 sun = shadows ? albedo * sunColor * (max(dot(norm, -sunDir), 0.0) * shadowFactor(fragPos, norm)) : vec3(0.0);
+    if (clustered) {
+        FragColor = vec4(albedo * 0.05 + sun + clusteredLightingAt(fragPos, norm, albedo, vec3(gl_FragCoord.xy, depth)), 1.0);
+        return;
+    }
+
+    vec3 lightDir = normalize(lightPos - fragPos);
+    float diff = max(dot(norm, lightDir), 0.0);
+    FragColor = vec4((0.5 + diff) * albedo + sun, 1.0);
+}
+)glsl";
+
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 
@@ -73,6 +163,31 @@ float fov = 45.0f;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
+// Lighting
+const int LIGHT_COUNTS[] = { 10, 100, 1000 };
+const int MAX_LIGHTS = 1000;
+const int FLOOR_CUBES = 8;  // per side
+bool useClusteredLighting = true;
+bool showClusterDensity = false;
+int lightCountIndex = 2;
+bool clusteredKeyWasPressed = false, countKeyWasPressed = false, densityKeyWasPressed = false;
+bool useDeferredShading = false;
+GBufferLayout gBufferLayout = GBUFFER_COMPACT;
+bool benchmarkRequested = false;
+bool deferredKeyWasPressed = false, layoutKeyWasPressed = false, benchmarkKeyWasPressed = false;
+
+// Sun and shadows
+const int BOUNCING_ROW = 3;  // this row of floor cubes moves: the dynamic casters
+bool useShadows = true;
+bool sunMoving = false;
+bool shadowKeyWasPressed = false, sunKeyWasPressed = false;
+
+// Dynamic resolution
+const double FRAME_TIME_TARGET_MS = 1000.0 / 30.0;
+bool useDynamicResolution = true;
+bool sharpenUpscale = true;
+bool resolutionKeyWasPressed = false, sharpenKeyWasPressed = false;
+
 void processInput(GLFWwindow *window) {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
@@ -90,52 +205,67 @@ void processInput(GLFWwindow *window) {
         cameraPos += cameraSpeed * cameraUp;
     if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS)
         cameraPos -= cameraSpeed * cameraUp;
+
+    bool clusteredKeyPressed = glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS;
+    if (clusteredKeyPressed && !clusteredKeyWasPressed)
+        useClusteredLighting = !useClusteredLighting;
+    clusteredKeyWasPressed = clusteredKeyPressed;
+
+    bool countKeyPressed = glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS;
+    if (countKeyPressed && !countKeyWasPressed)
+        lightCountIndex = (lightCountIndex + 1) % 3;
+    countKeyWasPressed = countKeyPressed;
+
+    bool densityKeyPressed = glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS;
+    if (densityKeyPressed && !densityKeyWasPressed)
+        showClusterDensity = !showClusterDensity;
+    densityKeyWasPressed = densityKeyPressed;
+
+    bool deferredKeyPressed = glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS;
+    if (deferredKeyPressed && !deferredKeyWasPressed)
+        useDeferredShading = !useDeferredShading;
+    deferredKeyWasPressed = deferredKeyPressed;
+
+    bool layoutKeyPressed = glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS;
+    if (layoutKeyPressed && !layoutKeyWasPressed)
+        gBufferLayout = gBufferLayout == GBUFFER_COMPACT ? GBUFFER_WIDE : GBUFFER_COMPACT;
+    layoutKeyWasPressed = layoutKeyPressed;
+
+    bool benchmarkKeyPressed = glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS;
+    if (benchmarkKeyPressed && !benchmarkKeyWasPressed)
+        benchmarkRequested = true;
+    benchmarkKeyWasPressed = benchmarkKeyPressed;
+
+    bool shadowKeyPressed = glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS;
+    if (shadowKeyPressed && !shadowKeyWasPressed)
+        useShadows = !useShadows;
+    shadowKeyWasPressed = shadowKeyPressed;
+
+    bool sunKeyPressed = glfwGetKey(window, GLFW_KEY_J) == GLFW_PRESS;
+    if (sunKeyPressed && !sunKeyWasPressed)
+        sunMoving = !sunMoving;
+    sunKeyWasPressed = sunKeyPressed;
+
+    bool resolutionKeyPressed = glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS;
+    if (resolutionKeyPressed && !resolutionKeyWasPressed)
+        useDynamicResolution = !useDynamicResolution;
+    resolutionKeyWasPressed = resolutionKeyPressed;
+
+    bool sharpenKeyPressed = glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS;
+    if (sharpenKeyPressed && !sharpenKeyWasPressed)
+        sharpenUpscale = !sharpenUpscale;
+    sharpenKeyWasPressed = sharpenKeyPressed;
 }
 
-std::vector<float> vertices = {
-    // positions         // normals
-    -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-     0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-     0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-     0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-    -0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-    -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-
-    -0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,
-     0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,
-     0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,
-     0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,
-    -0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,
-    -0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,
-
-    -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,
-    -0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f,
-    -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,
-    -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,
-    -0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f,
-    -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,
-
-     0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,
-     0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,
-     0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,
-     0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,
-     0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,
-     0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,
-
-    -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,
-     0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,
-     0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,
-     0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,
-    -0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,
-    -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,
-
-    -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,
-     0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,
-     0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,
-     0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,
-    -0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,
-    -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f
-};
+// Small deterministic hash so every run places the lights the same way
+inline float lightRandom(unsigned int i) {
+    i ^= i >> 16;
+    i *= 0x7FEB352Du;
+    i ^= i >> 15;
+    i *= 0x846CA68Bu;
+    i ^= i >> 16;
+    return (i >> 8) * (1.0f / 16777216.0f);
+}
 
 int main() {
     glfwInit();
@@ -156,19 +286,10 @@ int main() {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    installGLStateCache();
 
-    unsigned int VBO, VAO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices[0], GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    // Use the exported mesh when meshExport has been run, otherwise build it here
+    GpuMesh cube = loadMeshOr("meshes/cube.rwm", [] { return createCubeMesh(); });
 
     unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
     glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
@@ -216,6 +337,191 @@ int main() {
 
     glm::vec3 lightPos(1.2f, 1.0f, 2.0f);
 
+    // The many-light scene: a floor with a grid of cubes in front of the
+    // original one, and lights circling just above it
+    const float nearPlane = 0.1f, farPlane = 120.0f;
+    std::vector<glm::mat4> models(2 + FLOOR_CUBES * FLOOR_CUBES);
+    std::vector<glm::vec3> albedos(models.size(), glm::vec3(0.8f));
+    albedos[0] = glm::vec3(1.0f, 0.65f, 0.0f);
+    models[1] = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -1.5f, -10.0f)), glm::vec3(40.0f, 0.2f, 40.0f));
+    for (int i = 0; i < FLOOR_CUBES * FLOOR_CUBES; ++i) {
+        glm::vec3 position((i % FLOOR_CUBES) * 4.0f - 14.0f, -0.9f, (i / FLOOR_CUBES) * 4.0f - 24.0f);
+        models[2 + i] = glm::translate(glm::mat4(1.0f), position);
+    }
+    std::vector<ObjectConstants> constants(models.size());
+
+    // Bounding spheres of the cubes (half diagonal 0.87) and the floor slab
+    std::vector<ShadowCaster> casters(models.size());
+    for (size_t i = 0; i < models.size(); ++i) {
+        ShadowCaster& caster = casters[i];
+        for (int k = 0; k < 3; ++k)
+            caster.center[k] = models[i][3][k];
+        caster.radius = i == 1 ? 28.3f : 0.87f;
+        caster.dynamic = i >= 2 && (int)(i - 2) / FLOOR_CUBES == BOUNCING_ROW;
+    }
+    ShadowMaps shadowMaps;
+    initShadowMaps(shadowMaps, 1024, 3, 40.0f);
+    float sunAngle = 0.6f;
+    size_t lastCasterCount = 0;
+
+    std::vector<PointLight> lights(MAX_LIGHTS);
+    std::vector<glm::vec4> lightOrbits(MAX_LIGHTS);  // center xz, phase, speed
+    for (int i = 0; i < MAX_LIGHTS; ++i) {
+        PointLight& light = lights[i];
+        lightOrbits[i] = glm::vec4(lightRandom(8 * i) * 40.0f - 20.0f, lightRandom(8 * i + 1) * 40.0f - 30.0f,
+                                   lightRandom(8 * i + 2) * 6.2831853f, 0.3f + lightRandom(8 * i + 3));
+        light.position[1] = -1.2f + lightRandom(8 * i + 4) * 2.0f;
+        light.radius = 1.5f + lightRandom(8 * i + 5) * 2.0f;
+        glm::vec3 color = glm::normalize(glm::vec3(lightRandom(8 * i + 6), lightRandom(8 * i + 7), lightRandom(8 * i + 8)) + 0.1f);
+        light.color[0] = color.x;
+        light.color[1] = color.y;
+        light.color[2] = color.z;
+        light.intensity = 3.0f;
+    }
+    ClusteredLights clusters;
+    initClusteredLights(clusters);
+
+    GLuint gBufferProgram = createShaderProgram(vertexShaderSource, gBufferFragmentSource);
+    GLuint lightingProgram = createShaderProgram(DEFERRED_FULLSCREEN_VS, lightingFragmentSource);
+    GBuffer gBuffer;
+    initGBuffer(gBuffer);
+    DynamicResolution dynamicResolution;
+    initDynamicResolution(dynamicResolution, FRAME_TIME_TARGET_MS);
+
+    FrameStats frameStats;
+    initFrameStats(frameStats, "OpenGL Cube Demo");
+
+    // Light uniforms shared by the forward and the deferred lighting shaders
+    auto setLightingUniforms = [&](GLuint program, int width, int height) {
+        glUniform3fv(glGetUniformLocation(program, "lightPos"), 1, &lightPos[0]);
+        glUniform3fv(glGetUniformLocation(program, "viewPos"), 1, &cameraPos[0]);
+        glUniform1i(glGetUniformLocation(program, "clustered"), useClusteredLighting);
+        // Bound even when unused so no two sampler types share a texture unit
+        bindClusteredLights(clusters, program, 4, width, height, showClusterDensity);
+        glUniform1i(glGetUniformLocation(program, "shadows"), useShadows);
+        glUniform3fv(glGetUniformLocation(program, "sunDir"), 1, shadowMaps.lightDir);
+        glUniform3f(glGetUniformLocation(program, "sunColor"), 0.35f, 0.33f, 0.3f);
+        bindShadowMaps(shadowMaps, program, 7);
+    };
+    // Objects are drawn through a render queue (see renderQueue.h), front to
+    // back, so early depth testing skips the lighting of hidden fragments
+    struct ObjectDraws {
+        const ObjectConstants* constants;
+        const glm::vec3* albedos;
+        const GpuMesh* mesh;
+    };
+    RenderQueue renderQueue;
+    auto drawObjects = [&](GLuint program, size_t objectCount) {
+        ObjectDraws draws = { constants.data(), albedos.data(), &cube };
+        clearRenderQueue(renderQueue);
+        for (size_t i = 0; i < objectCount; ++i) {
+            glm::vec3 toObject(models[i][3][0] - cameraPos.x, models[i][3][1] - cameraPos.y, models[i][3][2] - cameraPos.z);
+            float depth = glm::dot(toObject, cameraFront) / farPlane;
+            RenderItem item = makeRenderItem(makeRenderKey(0, RENDER_OPAQUE, program, 0, cube.VAO, depth), program, 0, cube.VAO,
+                                             RENDER_OPAQUE, GL_TRIANGLES, 0);
+            item.draw = [](GLuint itemProgram, const void* data, size_t index) {
+                const ObjectDraws* d = (const ObjectDraws*)data;
+                setObjectConstantUniforms(itemProgram, d->constants[index]);
+                glUniform3fv(glGetUniformLocation(itemProgram, "albedo"), 1, &d->albedos[index][0]);
+                drawMesh(*d->mesh);
+            };
+            item.data = &draws;
+            item.index = i;
+            submitRenderItem(renderQueue, item);
+        }
+        sortRenderQueue(renderQueue);
+        executeRenderQueue(renderQueue);
+    };
+    // Draws the first objectCount objects into the bound framebuffer, which
+    // is width x height, shading them forward or through the G-buffer
+    auto renderScene = [&](bool deferred, GBufferLayout layout, int width, int height, const glm::mat4& viewProjection,
+                           size_t objectCount) {
+        if (!deferred) {
+            glUseProgram(shaderProgram);
+            setMeshDecodeUniforms(shaderProgram, cube);
+            setLightingUniforms(shaderProgram, width, height);
+            drawObjects(shaderProgram, objectCount);
+            return;
+        }
+        GLint target = 0;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+        resizeGBuffer(gBuffer, width, height, layout);
+        beginGBufferPass(gBuffer, gBufferProgram);
+        setMeshDecodeUniforms(gBufferProgram, cube);
+        drawObjects(gBufferProgram, objectCount);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, target);
+        glViewport(0, 0, width, height);
+        glUseProgram(lightingProgram);
+        glm::mat4 invViewProjection = glm::inverse(viewProjection);
+        bindGBufferForLighting(gBuffer, lightingProgram, 0, glm::value_ptr(invViewProjection));
+        setLightingUniforms(lightingProgram, width, height);
+        drawGBufferLighting(gBuffer);
+    };
+    // Times forward, deferred compact and deferred wide shading of the whole
+    // scene at three resolutions and every light count, offscreen so the
+    // window size does not matter
+    auto runLightingBenchmark = [&](const glm::mat4& view) {
+        const int sizes[][2] = { { 640, 360 }, { 1280, 720 }, { 1920, 1080 } };
+        const int BENCHMARK_FRAMES = 5;
+        GLuint framebuffer, renderbuffers[2], query;
+        glGenFramebuffers(1, &framebuffer);
+        glGenRenderbuffers(2, renderbuffers);
+        glGenQueries(1, &query);
+        bool clusteredWas = useClusteredLighting, densityWas = showClusterDensity;
+        useClusteredLighting = true;
+        showClusterDensity = false;
+
+        std::cout << "lights  resolution  forward ms  deferred compact ms  deferred wide ms" << std::endl;
+        for (const int* size : sizes) {
+            int width = size[0], height = size[1];
+            glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+            glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                std::cout << "ERROR::FRAMEBUFFER::BENCHMARK::NOT_COMPLETE" << std::endl;
+
+            glm::mat4 projection = glm::perspective(glm::radians(fov), (float)width / (float)height, nearPlane, farPlane);
+            glm::mat4 viewProjection = projection * view;
+            computeObjectConstants(glm::value_ptr(viewProjection), glm::value_ptr(models[0]), models.size(), constants.data());
+            for (int lightCount : LIGHT_COUNTS) {
+                assignLightsToClusters(clusters, lights.data(), lightCount, glm::value_ptr(view), glm::value_ptr(projection),
+                                       nearPlane, farPlane);
+                double ms[3];
+                for (int path = 0; path < 3; ++path) {
+                    // One untimed frame first to size the G-buffer
+                    for (int frame = -1; frame < BENCHMARK_FRAMES; ++frame) {
+                        if (frame == 0)
+                            glBeginQuery(GL_TIME_ELAPSED, query);
+                        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+                        glViewport(0, 0, width, height);
+                        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                        renderScene(path != 0, path == 2 ? GBUFFER_WIDE : GBUFFER_COMPACT, width, height, viewProjection,
+                                    models.size());
+                    }
+                    glEndQuery(GL_TIME_ELAPSED);
+                    GLuint64 ns = 0;
+                    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+                    ms[path] = ns / 1.0e6 / BENCHMARK_FRAMES;
+                }
+                std::cout << std::setw(6) << lightCount << "  " << std::setw(4) << width << "x" << std::setw(4) << height
+                          << std::fixed << std::setprecision(2) << std::setw(12) << ms[0] << std::setw(21) << ms[1]
+                          << std::setw(18) << ms[2] << std::endl;
+            }
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(2, renderbuffers);
+        glDeleteQueries(1, &query);
+        useClusteredLighting = clusteredWas;
+        showClusterDensity = densityWas;
+    };
+
     while (!glfwWindowShouldClose(window)) {
         float currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
@@ -225,9 +531,9 @@ int main() {
 
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glUseProgram(shaderProgram);
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr( glm::perspective(glm::radians(fov), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 120.0f)));
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp)));
+        glm::mat4 projection = glm::perspective(glm::radians(fov), (float)SCR_WIDTH / (float)SCR_HEIGHT, nearPlane, farPlane);
+        glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
+        glm::mat4 viewProjection = projection * view;
 
         // This code rotates the object so we can better see how the lighting works
         float distance = -2.0f; 
@@ -242,20 +548,116 @@ int main() {
         // Replace the code above with this to set the cube to face front again
         //glm::mat4 model = glm::mat4(1.0f);
 
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-
-        glUniform3fv(glGetUniformLocation(shaderProgram, "lightPos"), 1, &lightPos[0]);
-        glUniform3fv(glGetUniformLocation(shaderProgram, "viewPos"), 1, &cameraPos[0]);
-
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
+        models[0] = model;
+
+        // The main cube is a static caster; its cached cascades are redrawn
+        // where it was and where it is whenever its position changes
+        ShadowCaster& cubeCaster = casters[0];
+        if (cubeCaster.center[0] != model[3][0] || cubeCaster.center[1] != model[3][1] || cubeCaster.center[2] != model[3][2]) {
+            invalidateStaticShadows(shadowMaps, cubeCaster.center, cubeCaster.radius);
+            for (int k = 0; k < 3; ++k)
+                cubeCaster.center[k] = model[3][k];
+            invalidateStaticShadows(shadowMaps, cubeCaster.center, cubeCaster.radius);
+        }
+
+        // The bouncing row moves every frame; the other casters never do
+        for (int i = 0; i < FLOOR_CUBES; ++i) {
+            size_t object = 2 + BOUNCING_ROW * FLOOR_CUBES + i;
+            models[object][3][1] = -0.9f + 0.8f * fabsf(sinf(currentFrame * 2.0f + i * 0.7f));
+            casters[object].center[1] = models[object][3][1];
+        }
+
+        for (int i = 0; i < MAX_LIGHTS; ++i) {
+            float angle = lightOrbits[i].z + currentFrame * lightOrbits[i].w;
+            lights[i].position[0] = lightOrbits[i].x + 1.5f * cosf(angle);
+            lights[i].position[2] = lightOrbits[i].y + 1.5f * sinf(angle);
+        }
+        if (benchmarkRequested) {
+            benchmarkRequested = false;
+            runLightingBenchmark(view);
+        }
+
+        int width, height;
+        glfwGetFramebufferSize(window, &width, &height);
+        // The scene is drawn offscreen at the controller's size, then scaled up to the window
+        int renderWidth = width, renderHeight = height;
+        if (useDynamicResolution) {
+            updateDynamicResolution(dynamicResolution, deltaTime * 1000.0);
+            dynamicResolutionSize(dynamicResolution, width, height, renderWidth, renderHeight);
+        }
+        size_t objectCount = 1;
+        std::ostringstream hud;
+        if (useDeferredShading)
+            hud << "deferred, " << gBufferLayoutName(gBufferLayout) << " G-buffer " << gBufferBytesPerPixel(gBufferLayout)
+                << " B/px (" << std::fixed << std::setprecision(1)
+                << gBufferBytesPerPixel(gBufferLayout) * (double)renderWidth * renderHeight / (1 << 20) << " MB) | ";
+        else
+            hud << "forward | ";
+        if (useClusteredLighting) {
+            int lightCount = LIGHT_COUNTS[lightCountIndex];
+            assignLightsToClusters(clusters, lights.data(), lightCount, glm::value_ptr(view), glm::value_ptr(projection),
+                                   nearPlane, farPlane);
+            objectCount = models.size();
+
+            const ClusterStats& stats = clusters.stats;
+            hud << renderQueue.stats.items << " draws, " << lightCount << " lights, " << stats.indices << " light-cluster pairs, "
+                << std::fixed << std::setprecision(1) << (stats.litClusters ? (double)stats.indices / stats.litClusters : 0.0)
+                << " per lit cluster, busiest " << stats.busiestCluster << ", binning " << std::setprecision(2)
+                << stats.ms << " ms";
+        } else {
+            hud << "one light";
+        }
+
+        // Every object's matrices in one batch
+        computeObjectConstants(glm::value_ptr(viewProjection), glm::value_ptr(models[0]), objectCount, constants.data());
+        beginGpuTimer(frameStats);
+        if (useShadows) {
+            if (sunMoving)
+                sunAngle += deltaTime * 0.2f;
+            float sunDirection[3] = { cosf(sunAngle) * 0.5f, -1.0f, sinf(sunAngle) * 0.5f };
+            setShadowLightDirection(shadowMaps, sunDirection);
+            // The caster set changes with the lighting mode
+            if (objectCount != lastCasterCount)
+                invalidateShadowMaps(shadowMaps);
+            lastCasterCount = objectCount;
+            fitShadowCascades(shadowMaps, &cameraPos[0], &cameraFront[0], glm::radians(fov), (float)SCR_WIDTH / (float)SCR_HEIGHT,
+                              nearPlane);
+            updateShadowMaps(shadowMaps, casters.data(), objectCount, [&](GLuint program, size_t i) {
+                glUniformMatrix4fv(glGetUniformLocation(program, "model"), 1, GL_FALSE, glm::value_ptr(models[i]));
+                setMeshDecodeUniforms(program, cube);
+                drawMesh(cube);
+            });
+            glViewport(0, 0, width, height);
+            const ShadowStats& shadowStats = shadowMaps.stats;
+            hud << " | shadows " << shadowStats.staticPasses << " static + " << shadowStats.compositePasses
+                << " composite passes, " << shadowStats.skippedPasses << " skipped";
+        }
+        if (useDynamicResolution) {
+            dynamicResolution.sharpen = sharpenUpscale;
+            beginDynamicResolution(dynamicResolution, width, height);
+            hud << " | " << renderWidth << "x" << renderHeight << " (" << std::fixed << std::setprecision(0)
+                << dynamicResolution.scale * 100.0f << "%, " << (sharpenUpscale ? "sharpened" : "bilinear")
+                << "), last change: " << dynamicResolution.lastDecision;
+        }
+        frameStats.hud = hud.str();
+        renderScene(useDeferredShading, gBufferLayout, renderWidth, renderHeight, viewProjection, objectCount);
+        if (useDynamicResolution)
+            endDynamicResolution(dynamicResolution, width, height);
+        endGpuTimer(frameStats);
+        updateFrameStats(frameStats, window, deltaTime);
 
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
+    destroyMesh(cube);
+    destroyClusteredLights(clusters);
+    destroyGBuffer(gBuffer);
+    destroyShadowMaps(shadowMaps);
+    destroyDynamicResolution(dynamicResolution);
+    glDeleteProgram(gBufferProgram);
+    glDeleteProgram(lightingProgram);
+    destroyFrameStats(frameStats);
 
     glfwTerminate();
     return 0;
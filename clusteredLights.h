@@ -0,0 +1,249 @@
+#ifndef CLUSTERED_LIGHTS_H
+#define CLUSTERED_LIGHTS_H
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Clustered forward lighting for many point lights on GL 3.3.
+//
+// The view frustum is cut into CLUSTER_TILES_X x CLUSTER_TILES_Y screen
+// tiles and CLUSTER_SLICES depth slices, spaced exponentially from a first
+// slice depth out to the far plane so clusters stay roughly cube-shaped
+// (everything nearer than that shares slice 0). Every frame the
+// CPU bins each light into the clusters its sphere can touch, then uploads
+// three texture buffers: the lights, a (first, count) range per cluster and
+// the light index list those ranges point into. The fragment shader finds its
+// cluster from gl_FragCoord and its depth and loops over that cluster's lights
+// only, so its cost follows the number of lights nearby, not the total.
+//
+// Paste CLUSTERED_LIGHTS_GLSL into a fragment shader (after #version) and
+// call clusteredLighting(); bindClusteredLights() sets its uniforms. A
+// fullscreen pass that lights pixels it did not rasterize (deferred shading)
+// calls clusteredLightingAt() with the pixel's window coordinates and depth.
+
+const int CLUSTER_TILES_X = 16;
+const int CLUSTER_TILES_Y = 9;
+const int CLUSTER_SLICES = 24;
+const int CLUSTER_COUNT = CLUSTER_TILES_X * CLUSTER_TILES_Y * CLUSTER_SLICES;
+
+#define CLUSTERED_LIGHTS_GLSL \
+    "uniform samplerBuffer lightData;     // per light: position, radius; color, intensity\n" \
+    "uniform usamplerBuffer clusterData;  // per cluster: first index, light count\n" \
+    "uniform usamplerBuffer lightIndices;\n" \
+    "uniform ivec3 clusterCounts;\n" \
+    "uniform vec2 clusterScreenSize;\n" \
+    "uniform float clusterNear;           // projection planes\n" \
+    "uniform float clusterFar;\n" \
+    "uniform float clusterSliceNear;      // depths below this share slice 0\n" \
+    "uniform float clusterSliceScale;     // slices per unit of log(depth / clusterSliceNear)\n" \
+    "uniform int clusterDebug;\n" \
+    "vec3 clusteredLightingAt(vec3 fragPos, vec3 normal, vec3 albedo, vec3 windowCoord)\n" \
+    "{\n" \
+    "    // View depth from the depth buffer value, no view matrix needed\n" \
+    "    float ndcZ = windowCoord.z * 2.0 - 1.0;\n" \
+    "    float depth = 2.0 * clusterNear * clusterFar / (clusterFar + clusterNear - ndcZ * (clusterFar - clusterNear));\n" \
+    "    ivec3 cell = ivec3(ivec2(windowCoord.xy / clusterScreenSize * vec2(clusterCounts.xy)),\n" \
+    "                       int(log(max(depth, clusterSliceNear) / clusterSliceNear) * clusterSliceScale));\n" \
+    "    cell = clamp(cell, ivec3(0), clusterCounts - 1);\n" \
+    "    uvec2 range = texelFetch(clusterData, (cell.z * clusterCounts.y + cell.y) * clusterCounts.x + cell.x).xy;\n" \
+    "    if (clusterDebug != 0)\n" \
+    "        return vec3(float(range.y) / 32.0, 0.0, 1.0 - float(range.y) / 32.0);\n" \
+    "    vec3 result = vec3(0.0);\n" \
+    "    for (uint i = 0u; i < range.y; ++i) {\n" \
+    "        int light = int(texelFetch(lightIndices, int(range.x + i)).r);\n" \
+    "        vec4 positionRadius = texelFetch(lightData, light * 2);\n" \
+    "        vec4 colorIntensity = texelFetch(lightData, light * 2 + 1);\n" \
+    "        vec3 toLight = positionRadius.xyz - fragPos;\n" \
+    "        float distance2 = dot(toLight, toLight);\n" \
+    "        // Inverse square, windowed to reach zero at the radius\n" \
+    "        float window = clamp(1.0 - distance2 * distance2 / pow(positionRadius.w, 4.0), 0.0, 1.0);\n" \
+    "        float falloff = window * window / (distance2 + 1.0);\n" \
+    "        float diffuse = max(dot(normal, toLight * inversesqrt(max(distance2, 1e-8))), 0.0);\n" \
+    "        result += albedo * colorIntensity.rgb * (colorIntensity.a * diffuse * falloff);\n" \
+    "    }\n" \
+    "    return result;\n" \
+    "}\n" \
+    "vec3 clusteredLighting(vec3 fragPos, vec3 normal, vec3 albedo)\n" \
+    "{\n" \
+    "    return clusteredLightingAt(fragPos, normal, albedo, gl_FragCoord.xyz);\n" \
+    "}\n"
+
+// Two RGBA32F texels in the light texture buffer
+struct PointLight {
+    float position[3];  // world space
+    float radius;       // no light past this distance
+    float color[3];
+    float intensity;
+};
+
+struct ClusterStats {
+    size_t lights;
+    size_t indices;        // light-cluster pairs
+    size_t busiestCluster; // most lights in one cluster
+    size_t litClusters;    // clusters with at least one light
+    double ms;             // binning and upload
+};
+
+struct ClusteredLights {
+    GLuint lightBuffer, clusterBuffer, indexBuffer;
+    GLuint lightTexture, clusterTexture, indexTexture;
+    float nearPlane, farPlane, sliceNear;
+    std::vector<uint32_t> pairs;     // cluster << 16 | light, this frame's binning
+    std::vector<GLuint> clusters;    // first, count
+    std::vector<GLuint> indices;
+    ClusterStats stats;
+};
+
+inline void initClusteredLights(ClusteredLights& cl) {
+    cl = ClusteredLights();
+    // Placeholders until the first assignLightsToClusters
+    cl.nearPlane = 0.1f;
+    cl.farPlane = 100.0f;
+    cl.sliceNear = 1.0f;
+    GLuint* buffers[] = { &cl.lightBuffer, &cl.clusterBuffer, &cl.indexBuffer };
+    GLuint* textures[] = { &cl.lightTexture, &cl.clusterTexture, &cl.indexTexture };
+    const GLenum formats[] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+    for (int i = 0; i < 3; ++i) {
+        glGenBuffers(1, buffers[i]);
+        glBindBuffer(GL_TEXTURE_BUFFER, *buffers[i]);
+        glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+        glGenTextures(1, textures[i]);
+        glBindTexture(GL_TEXTURE_BUFFER, *textures[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, formats[i], *buffers[i]);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+// Replaces a texture buffer's contents, orphaning the old storage
+inline void uploadTextureBuffer(GLuint buffer, const void* data, size_t bytes) {
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(bytes, 16), NULL, GL_STREAM_DRAW);
+    if (bytes)
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, data);
+}
+
+// Range of cells [first, last] along one axis that the view-space interval
+// [lo, hi] can cover at view depths [nearDepth, farDepth] (both positive) under
+// projection scale p. Returns false when the range misses the screen.
+inline bool clusterTileRange(float lo, float hi, float nearDepth, float farDepth, float p, int cells, int& first, int& last) {
+    float ndcLo = p * lo / (lo >= 0.0f ? farDepth : nearDepth);
+    float ndcHi = p * hi / (hi >= 0.0f ? nearDepth : farDepth);
+    if (ndcHi < -1.0f || ndcLo > 1.0f)
+        return false;
+    first = std::max(0, (int)floorf((ndcLo * 0.5f + 0.5f) * cells));
+    last = std::min(cells - 1, (int)floorf((ndcHi * 0.5f + 0.5f) * cells));
+    return first <= last;
+}
+
+inline float clusterSliceScale(const ClusteredLights& cl) {
+    return CLUSTER_SLICES / logf(cl.farPlane / cl.sliceNear);
+}
+
+// Bins `count` lights into the clusters of the frustum given by the
+// column-major view matrix and a perspective projection (projection[0] and
+// projection[5] are its x and y scales) with planes nearPlane and farPlane,
+// then uploads the three texture buffers. Up to 65535 lights.
+inline void assignLightsToClusters(ClusteredLights& cl, const PointLight* lights, size_t count, const float* view,
+                                   const float* projection, float nearPlane, float farPlane, float firstSliceDepth = 1.0f) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    count = std::min<size_t>(count, 65535);
+    cl.nearPlane = nearPlane;
+    cl.farPlane = farPlane;
+    cl.sliceNear = std::max(nearPlane, firstSliceDepth);
+    const float sliceScale = clusterSliceScale(cl);
+    cl.pairs.clear();
+    for (size_t l = 0; l < count; ++l) {
+        const PointLight& light = lights[l];
+        const float* p = light.position;
+        float x = view[0] * p[0] + view[4] * p[1] + view[8] * p[2] + view[12];
+        float y = view[1] * p[0] + view[5] * p[1] + view[9] * p[2] + view[13];
+        float depth = -(view[2] * p[0] + view[6] * p[1] + view[10] * p[2] + view[14]);
+        float r = light.radius;
+        if (depth + r < nearPlane || depth - r > farPlane)
+            continue;
+        int firstSlice = std::max(0, (int)(logf(std::max(depth - r, cl.sliceNear) / cl.sliceNear) * sliceScale));
+        int lastSlice = std::min(CLUSTER_SLICES - 1, (int)(logf(std::max(depth + r, cl.sliceNear) / cl.sliceNear) * sliceScale));
+        for (int z = firstSlice; z <= lastSlice; ++z) {
+            // The part of the light's depth range inside this slice
+            float sliceStart = z == 0 ? nearPlane : cl.sliceNear * expf(z / sliceScale);
+            float sliceEnd = z == CLUSTER_SLICES - 1 ? farPlane : cl.sliceNear * expf((z + 1) / sliceScale);
+            float nearDepth = std::max(std::max(sliceStart, depth - r), nearPlane);
+            float farDepth = std::min(sliceEnd, depth + r);
+            int x0, x1, y0, y1;
+            if (!clusterTileRange(x - r, x + r, nearDepth, farDepth, projection[0], CLUSTER_TILES_X, x0, x1)
+                || !clusterTileRange(y - r, y + r, nearDepth, farDepth, projection[5], CLUSTER_TILES_Y, y0, y1))
+                continue;
+            for (int ty = y0; ty <= y1; ++ty)
+                for (int tx = x0; tx <= x1; ++tx)
+                    cl.pairs.push_back((uint32_t)((z * CLUSTER_TILES_Y + ty) * CLUSTER_TILES_X + tx) << 16 | (uint32_t)l);
+        }
+    }
+
+    // Counting sort by cluster: ranges first, then the indices
+    cl.clusters.assign(CLUSTER_COUNT * 2, 0);
+    for (size_t i = 0; i < cl.pairs.size(); ++i)
+        ++cl.clusters[(cl.pairs[i] >> 16) * 2 + 1];
+    GLuint next = 0;
+    size_t busiest = 0, lit = 0;
+    for (int c = 0; c < CLUSTER_COUNT; ++c) {
+        GLuint n = cl.clusters[c * 2 + 1];
+        cl.clusters[c * 2] = next;
+        next += n;
+        busiest = std::max<size_t>(busiest, n);
+        lit += n != 0;
+    }
+    cl.indices.resize(cl.pairs.size());
+    std::vector<GLuint> fill(CLUSTER_COUNT);
+    for (int c = 0; c < CLUSTER_COUNT; ++c)
+        fill[c] = cl.clusters[c * 2];
+    for (size_t i = 0; i < cl.pairs.size(); ++i)
+        cl.indices[fill[cl.pairs[i] >> 16]++] = cl.pairs[i] & 0xFFFF;
+
+    uploadTextureBuffer(cl.lightBuffer, lights, count * sizeof(PointLight));
+    uploadTextureBuffer(cl.clusterBuffer, cl.clusters.data(), cl.clusters.size() * sizeof(GLuint));
+    uploadTextureBuffer(cl.indexBuffer, cl.indices.data(), cl.indices.size() * sizeof(GLuint));
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    cl.stats.lights = count;
+    cl.stats.indices = cl.indices.size();
+    cl.stats.busiestCluster = busiest;
+    cl.stats.litClusters = lit;
+    cl.stats.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Binds the texture buffers to units firstUnit..firstUnit + 2 and sets the
+// CLUSTERED_LIGHTS_GLSL uniforms of the bound program. screenWidth/Height
+// are the framebuffer size in pixels.
+inline void bindClusteredLights(const ClusteredLights& cl, GLuint program, int firstUnit, int screenWidth, int screenHeight,
+                                bool debugView = false) {
+    const GLuint textures[] = { cl.lightTexture, cl.clusterTexture, cl.indexTexture };
+    const char* names[] = { "lightData", "clusterData", "lightIndices" };
+    for (int i = 0; i < 3; ++i) {
+        glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+        glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+        glUniform1i(glGetUniformLocation(program, names[i]), firstUnit + i);
+    }
+    glActiveTexture(GL_TEXTURE0);
+    glUniform3i(glGetUniformLocation(program, "clusterCounts"), CLUSTER_TILES_X, CLUSTER_TILES_Y, CLUSTER_SLICES);
+    glUniform2f(glGetUniformLocation(program, "clusterScreenSize"), (float)screenWidth, (float)screenHeight);
+    glUniform1f(glGetUniformLocation(program, "clusterNear"), cl.nearPlane);
+    glUniform1f(glGetUniformLocation(program, "clusterFar"), cl.farPlane);
+    glUniform1f(glGetUniformLocation(program, "clusterSliceNear"), cl.sliceNear);
+    glUniform1f(glGetUniformLocation(program, "clusterSliceScale"), clusterSliceScale(cl));
+    glUniform1i(glGetUniformLocation(program, "clusterDebug"), debugView);
+}
+
+inline void destroyClusteredLights(ClusteredLights& cl) {
+    GLuint buffers[] = { cl.lightBuffer, cl.clusterBuffer, cl.indexBuffer };
+    GLuint textures[] = { cl.lightTexture, cl.clusterTexture, cl.indexTexture };
+    glDeleteBuffers(3, buffers);
+    glDeleteTextures(3, textures);
+    cl = ClusteredLights();
+}
+
+#endif
@@ -0,0 +1,214 @@
+#ifndef DEFERRED_SHADING_H
+#define DEFERRED_SHADING_H
+
+#include <glad/glad.h>
+#include <iostream>
+
+// Deferred shading on GL 3.3: the scene is drawn once into a G-buffer holding
+// each pixel's surface, then one fullscreen pass lights every pixel exactly
+// once, however much overdraw the geometry had.
+//
+// The lighting pass reads the whole G-buffer for every pixel, so its size is
+// what costs bandwidth and fill rate (and on llvmpipe, CPU time). Two layouts
+// can be compared:
+//   GBUFFER_COMPACT  RG16 octahedral normal, RGBA8 albedo, 32-bit depth.
+//                    The position is rebuilt from depth: 12 bytes per pixel.
+//   GBUFFER_WIDE     RGBA16F normal, RGBA8 albedo, RGBA32F world position
+//                    and depth: 32 bytes per pixel.
+//
+// The geometry pass fragment shader pastes DEFERRED_GBUFFER_GLSL after
+// #version and calls writeGBuffer(); the lighting pass uses
+// DEFERRED_FULLSCREEN_VS with a fragment shader that pastes
+// DEFERRED_RESOLVE_GLSL and calls readGBuffer().
+//
+// The attachments only ever grow. A frame smaller than them (dynamic
+// resolution) draws and lights their lower-left corner, so changing the
+// render size does not reallocate anything.
+
+enum GBufferLayout { GBUFFER_COMPACT, GBUFFER_WIDE };
+
+#define DEFERRED_GBUFFER_GLSL \
+    "layout (location = 0) out vec4 gNormal;    // RG16 octahedral or RGBA16F xyz\n" \
+    "layout (location = 1) out vec4 gAlbedo;\n" \
+    "layout (location = 2) out vec4 gPosition;  // wide layout only\n" \
+    "uniform bool gBufferWide;\n" \
+    "vec2 encodeOctahedral(vec3 n)\n" \
+    "{\n" \
+    "    n /= abs(n.x) + abs(n.y) + abs(n.z);\n" \
+    "    if (n.z < 0.0)\n" \
+    "        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);\n" \
+    "    return n.xy;\n" \
+    "}\n" \
+    "void writeGBuffer(vec3 fragPos, vec3 normal, vec3 albedo)\n" \
+    "{\n" \
+    "    gNormal = gBufferWide ? vec4(normal, 0.0) : vec4(encodeOctahedral(normal) * 0.5 + 0.5, 0.0, 0.0);\n" \
+    "    gAlbedo = vec4(albedo, 1.0);\n" \
+    "    gPosition = vec4(fragPos, 1.0);\n" \
+    "}\n"
+
+#define DEFERRED_RESOLVE_GLSL \
+    "uniform sampler2D gNormal;\n" \
+    "uniform sampler2D gAlbedo;\n" \
+    "uniform sampler2D gPosition;\n" \
+    "uniform sampler2D gDepth;\n" \
+    "uniform bool gBufferWide;\n" \
+    "uniform mat4 invViewProjection;\n" \
+    "uniform vec2 gBufferViewSize;  // the part of the G-buffer in use\n" \
+    "vec3 decodeGBufferOctahedral(vec2 e)\n" \
+    "{\n" \
+    "    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));\n" \
+    "    if (n.z < 0.0)\n" \
+    "        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);\n" \
+    "    return normalize(n);\n" \
+    "}\n" \
+    "// False where nothing was drawn. depth is the window-space depth.\n" \
+    "bool readGBuffer(out vec3 fragPos, out vec3 normal, out vec3 albedo, out float depth)\n" \
+    "{\n" \
+    "    ivec2 pixel = ivec2(gl_FragCoord.xy);\n" \
+    "    depth = texelFetch(gDepth, pixel, 0).r;\n" \
+    "    if (depth == 1.0)\n" \
+    "        return false;\n" \
+    "    albedo = texelFetch(gAlbedo, pixel, 0).rgb;\n" \
+    "    if (gBufferWide) {\n" \
+    "        normal = normalize(texelFetch(gNormal, pixel, 0).xyz);\n" \
+    "        fragPos = texelFetch(gPosition, pixel, 0).xyz;\n" \
+    "        return true;\n" \
+    "    }\n" \
+    "    normal = decodeGBufferOctahedral(texelFetch(gNormal, pixel, 0).xy * 2.0 - 1.0);\n" \
+    "    vec2 ndc = gl_FragCoord.xy / gBufferViewSize * 2.0 - 1.0;\n" \
+    "    vec4 position = invViewProjection * vec4(ndc, depth * 2.0 - 1.0, 1.0);\n" \
+    "    fragPos = position.xyz / position.w;\n" \
+    "    return true;\n" \
+    "}\n"
+
+// One triangle covering the screen, no vertex buffer needed
+const char* const DEFERRED_FULLSCREEN_VS = R"glsl(
+#version 330 core
+void main()
+{
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
+)glsl";
+
+struct GBuffer {
+    GLuint framebuffer;
+    GLuint normalTexture, albedoTexture, positionTexture, depthTexture;
+    GLuint emptyVao;  // for the fullscreen triangle
+    int width, height;          // allocated
+    int viewWidth, viewHeight;  // in use this frame
+    GBufferLayout layout;
+};
+
+inline int gBufferBytesPerPixel(GBufferLayout layout) {
+    return layout == GBUFFER_COMPACT ? 4 + 4 + 4 : 8 + 4 + 16 + 4;
+}
+
+inline const char* gBufferLayoutName(GBufferLayout layout) {
+    return layout == GBUFFER_COMPACT ? "compact" : "wide";
+}
+
+inline void initGBuffer(GBuffer& g) {
+    g = GBuffer();
+    glGenFramebuffers(1, &g.framebuffer);
+    glGenVertexArrays(1, &g.emptyVao);
+}
+
+inline GLuint createGBufferTexture(GLint internalFormat, GLenum format, GLenum type, int width, int height) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    return texture;
+}
+
+// Sets the size this frame uses, (re)creating the attachments when the
+// layout changed or they are too small
+inline void resizeGBuffer(GBuffer& g, int width, int height, GBufferLayout layout) {
+    g.viewWidth = width;
+    g.viewHeight = height;
+    if (g.normalTexture && width <= g.width && height <= g.height && layout == g.layout)
+        return;
+    GLuint textures[] = { g.normalTexture, g.albedoTexture, g.positionTexture, g.depthTexture };
+    glDeleteTextures(4, textures);
+    width = width > g.width ? width : g.width;
+    height = height > g.height ? height : g.height;
+    g.width = width;
+    g.height = height;
+    g.layout = layout;
+
+    bool wide = layout == GBUFFER_WIDE;
+    g.normalTexture = wide ? createGBufferTexture(GL_RGBA16F, GL_RGBA, GL_FLOAT, width, height)
+                           : createGBufferTexture(GL_RG16, GL_RG, GL_UNSIGNED_SHORT, width, height);
+    g.albedoTexture = createGBufferTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+    g.positionTexture = wide ? createGBufferTexture(GL_RGBA32F, GL_RGBA, GL_FLOAT, width, height) : 0;
+    g.depthTexture = createGBufferTexture(GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT, width, height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, g.framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, g.normalTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, g.albedoTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, g.positionTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, g.depthTexture, 0);
+    // The compact layout leaves gPosition unbound, so its writes cost nothing
+    const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, wide ? (GLenum)GL_COLOR_ATTACHMENT2 : (GLenum)GL_NONE };
+    glDrawBuffers(3, drawBuffers);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::FRAMEBUFFER::GBUFFER::NOT_COMPLETE" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+// Binds the G-buffer, clears the part in use and sets gBufferWide on the
+// geometry pass program. Restore the framebuffer and viewport before the
+// lighting pass.
+inline void beginGBufferPass(const GBuffer& g, GLuint program) {
+    glBindFramebuffer(GL_FRAMEBUFFER, g.framebuffer);
+    glViewport(0, 0, g.viewWidth, g.viewHeight);
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(0, 0, g.viewWidth, g.viewHeight);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glDisable(GL_SCISSOR_TEST);
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "gBufferWide"), g.layout == GBUFFER_WIDE);
+}
+
+// Binds the G-buffer to texture units firstUnit..firstUnit + 3 and sets the
+// DEFERRED_RESOLVE_GLSL uniforms of the bound program. invViewProjection is
+// column-major and only needed by the compact layout.
+inline void bindGBufferForLighting(const GBuffer& g, GLuint program, int firstUnit, const float* invViewProjection) {
+    const GLuint textures[] = { g.normalTexture, g.albedoTexture, g.positionTexture, g.depthTexture };
+    const char* names[] = { "gNormal", "gAlbedo", "gPosition", "gDepth" };
+    for (int i = 0; i < 4; ++i) {
+        glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        glUniform1i(glGetUniformLocation(program, names[i]), firstUnit + i);
+    }
+    glActiveTexture(GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(program, "gBufferWide"), g.layout == GBUFFER_WIDE);
+    glUniformMatrix4fv(glGetUniformLocation(program, "invViewProjection"), 1, GL_FALSE, invViewProjection);
+    glUniform2f(glGetUniformLocation(program, "gBufferViewSize"), (float)g.viewWidth, (float)g.viewHeight);
+}
+
+// Runs the bound lighting program over the viewport, which should match the
+// G-buffer's size in use
+inline void drawGBufferLighting(const GBuffer& g) {
+    GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+    glDisable(GL_DEPTH_TEST);
+    glBindVertexArray(g.emptyVao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    if (depthTest)
+        glEnable(GL_DEPTH_TEST);
+}
+
+inline void destroyGBuffer(GBuffer& g) {
+    GLuint textures[] = { g.normalTexture, g.albedoTexture, g.positionTexture, g.depthTexture };
+    glDeleteTextures(4, textures);
+    glDeleteFramebuffers(1, &g.framebuffer);
+    glDeleteVertexArrays(1, &g.emptyVao);
+    g = GBuffer();
+}
+
+#endif
@@ -4,17 +4,24 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
+#include <sstream>
 #include <vector>
+#include "shapes.h"
+#include "meshFile.h"
+#include "frameStats.h"
+#include "wireframe.h"
+#include "objectConstants.h"
+#include "idleFrames.h"
 
 const char* vertexShaderSource = R"glsl(
 #version 330 core
 layout (location = 0) in vec3 aPos;
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform mat4 mvp;  // projection * view * model, see objectConstants.h
+uniform vec3 positionScale;  // packed vertex decode, see vertexCompress.h
+uniform vec3 positionBias;
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = mvp * vec4(aPos * positionScale + positionBias, 1.0);
 }
 )glsl";
 
@@ -46,6 +53,11 @@ float fov = 45.0f;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
+// F switches between the single-pass wireframe (wireframe.h) and a second
+// glPolygonMode(GL_LINE) draw, compare the GPU times in the title bar
+bool singlePassWireframe = true;
+bool wireframeKeyWasPressed = false;
+
 void processInput(GLFWwindow *window) {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
@@ -74,6 +86,13 @@ void processInput(GLFWwindow *window) {
     if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
         yaw += rotationSpeed;
 
+    bool wireframeKeyPressed = glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS;
+    if (wireframeKeyPressed && !wireframeKeyWasPressed) {
+        singlePassWireframe = !singlePassWireframe;
+        std::cout << (singlePassWireframe ? "Single-pass wireframe" : "Two-pass wireframe") << std::endl;
+    }
+    wireframeKeyWasPressed = wireframeKeyPressed;
+
     glm::vec3 front;
     front.x = cos(glm::radians(yaw)) * cos(glm::radians(pitch));
     front.y = sin(glm::radians(pitch));
@@ -81,34 +100,6 @@ void processInput(GLFWwindow *window) {
     cameraFront = glm::normalize(front);
 }
 
-std::vector<float> vertices = {
-    // Top half vertices
-    0.0f, 1.0f, 0.0f,  // Top point
-    -0.5f, 0.0f, -0.5f,  // Base square
-    0.5f, 0.0f, -0.5f,
-    0.5f, 0.0f, 0.5f,
-    -0.5f, 0.0f, 0.5f,
-    // Bottom half vertices
-    0.0f, -1.0f, 0.0f,  // Bottom point
-    -0.5f, 0.0f, -0.5f,  // Base square (reused)
-    0.5f, 0.0f, -0.5f,
-    0.5f, 0.0f, 0.5f,
-    -0.5f, 0.0f, 0.5f
-};
-
-std::vector<unsigned int> indices = {
-    // Top pyramid
-    0, 1, 2,
-    0, 2, 3,
-    0, 3, 4,
-    0, 4, 1,
-    // Bottom pyramid
-    5, 6, 7,
-    5, 7, 8,
-    5, 8, 9,
-    5, 9, 6
-};
-
 int main() {
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -128,21 +119,15 @@ int main() {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    installGLStateCache();
 
-    unsigned int VBO, VAO, EBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
+    // The diamond never moves on its own, so the loop sleeps until the
+    // camera or the wireframe mode changes
+    IdleFrames idleFrames;
+    initIdleFrames(idleFrames, window);
 
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+    // Use the exported mesh when meshExport has been run, otherwise build it here
+    GpuMesh diamond = loadMeshOr("meshes/diamond.rwm", [] { return createDiamondMesh(); });
 
     unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
     glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
@@ -175,9 +160,13 @@ int main() {
     }
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
+    GLuint wireProgram = createWireframeProgram(vertexShaderSource);
 
     glEnable(GL_DEPTH_TEST);
 
+    FrameStats frameStats;
+    initFrameStats(frameStats, "OpenGL Diamond");
+
     while (!glfwWindowShouldClose(window)) {
         float currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
@@ -185,34 +174,46 @@ int main() {
 
         processInput(window);
 
+        uint64_t frameState = hashFrameValue(FRAME_HASH_SEED, cameraPos);
+        frameState = hashFrameValue(frameState, cameraFront);
+        frameState = hashFrameValue(frameState, fov);
+        frameState = hashFrameValue(frameState, singlePassWireframe);
+        if (!frameNeedsRender(idleFrames, frameState)) {
+            waitForFrameChange(idleFrames, lastFrame);
+            continue;
+        }
+
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glUseProgram(shaderProgram);
+        GLuint program = singlePassWireframe ? wireProgram : shaderProgram;
+        glUseProgram(program);
+        setMeshDecodeUniforms(program, diamond);
 
         glm::mat4 model = glm::mat4(1.0f);
         glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
         glm::mat4 projection = glm::perspective(glm::radians(fov), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+        glm::mat4 viewProjection = projection * view;
+        ObjectConstants constants = computeObjectConstants(glm::value_ptr(viewProjection), glm::value_ptr(model));
+        glUniformMatrix4fv(glGetUniformLocation(program, "mvp"), 1, GL_FALSE, constants.mvp);
 
-        glUniform1i(glGetUniformLocation(shaderProgram, "isWireframe"), GL_FALSE);
-        glBindVertexArray(VAO);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        beginGpuTimer(frameStats);
+        drawSolidAndWireframe(program, singlePassWireframe, [&]() { drawMesh(diamond); });
+        endGpuTimer(frameStats);
 
-        glUniform1i(glGetUniformLocation(shaderProgram, "isWireframe"), GL_TRUE);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        std::ostringstream hud;
+        hud << (singlePassWireframe ? "single-pass wireframe" : "two-pass wireframe") << ", idle " << idleFrames.waits
+            << " times";
+        frameStats.hud = hud.str();
+        updateFrameStats(frameStats, window, deltaTime);
 
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
+    destroyMesh(diamond);
+    destroyFrameStats(frameStats);
+    glDeleteProgram(wireProgram);
 
     glfwTerminate();
     return 0;
@@ -0,0 +1,216 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <glad/glad.h>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "shaderUtil.h"
+
+// Renders the scene at a fraction of the window size that follows a frame
+// time target, then scales it up to the window.
+//
+// With a software rasterizer the fragment work grows with the pixel count and
+// the window is a fixed SCR_WIDTH x SCR_HEIGHT, so the resolution the scene
+// is drawn at is the knob left to turn. beginDynamicResolution() binds an
+// offscreen framebuffer with the viewport set to scale times the window
+// size; endDynamicResolution() draws it over the window with a bilinear or a
+// sharpening filter. The framebuffer is allocated at the window size and the
+// scene drawn into its lower-left corner, so changing the scale never
+// reallocates anything.
+//
+// updateDynamicResolution() is the controller. It smooths the frame time and,
+// when it leaves a band around the target, moves the scale part of the way
+// towards the one that would meet it, assuming the cost goes with the pixel
+// count (scale squared). The scale moves in steps of 1/20 and then holds for
+// a few frames, since frames already queued still show the old cost.
+
+const float DYNAMIC_RESOLUTION_STEP = 0.05f;
+const int DYNAMIC_RESOLUTION_HOLD_FRAMES = 15;
+
+const char* const DYNAMIC_RESOLUTION_VS = R"glsl(
+#version 330 core
+void main()
+{
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
+)glsl";
+
+const char* const DYNAMIC_RESOLUTION_FS = R"glsl(
+#version 330 core
+uniform sampler2D scene;
+uniform vec2 uvScale;     // the part of the texture the scene was drawn in
+uniform vec2 texelSize;
+uniform vec2 outputSize;
+uniform float sharpness;  // 0 for plain bilinear
+out vec4 FragColor;
+
+vec3 sceneAt(vec2 uv)
+{
+    // Half a texel inside the drawn part, so nothing past its edge bleeds in
+    return texture(scene, clamp(uv, 0.5 * texelSize, uvScale - 0.5 * texelSize)).rgb;
+}
+
+void main()
+{
+    vec2 uv = gl_FragCoord.xy / outputSize * uvScale;
+    vec3 color = sceneAt(uv);
+    if (sharpness > 0.0) {
+        // Unsharp mask over the four neighbours, kept inside their range so
+        // edges do not ring
+        vec3 n = sceneAt(uv + vec2(0.0, texelSize.y));
+        vec3 s = sceneAt(uv - vec2(0.0, texelSize.y));
+        vec3 e = sceneAt(uv + vec2(texelSize.x, 0.0));
+        vec3 w = sceneAt(uv - vec2(texelSize.x, 0.0));
+        vec3 lo = min(color, min(min(n, s), min(e, w)));
+        vec3 hi = max(color, max(max(n, s), max(e, w)));
+        color = clamp(color + (color - 0.25 * (n + s + e + w)) * sharpness, lo, hi);
+    }
+    FragColor = vec4(color, 1.0);
+}
+)glsl";
+
+struct DynamicResolution {
+    GLuint framebuffer, colorTexture, depthRenderbuffer;
+    GLuint program, emptyVao;
+    int allocatedWidth, allocatedHeight;
+    int width, height;        // what this frame is drawn at
+    float scale;              // of the window size, per axis
+    float minScale, maxScale;
+    double targetMs;
+    double smoothedMs;
+    int holdFrames;
+    bool sharpen;
+    int changes;              // scale changes so far
+    std::string lastDecision;
+};
+
+inline void initDynamicResolution(DynamicResolution& dr, double targetMs, float minScale = 0.5f, float maxScale = 1.0f) {
+    dr = DynamicResolution();
+    dr.targetMs = targetMs;
+    dr.minScale = minScale;
+    dr.maxScale = maxScale;
+    dr.scale = maxScale;
+    dr.sharpen = true;
+    dr.lastDecision = "none yet";
+    dr.program = createShaderProgram(DYNAMIC_RESOLUTION_VS, DYNAMIC_RESOLUTION_FS);
+    glGenVertexArrays(1, &dr.emptyVao);
+    glGenFramebuffers(1, &dr.framebuffer);
+    glGenTextures(1, &dr.colorTexture);
+    glGenRenderbuffers(1, &dr.depthRenderbuffer);
+}
+
+inline void allocateDynamicResolution(DynamicResolution& dr, int width, int height) {
+    glBindTexture(GL_TEXTURE_2D, dr.colorTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindRenderbuffer(GL_RENDERBUFFER, dr.depthRenderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, dr.framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, dr.colorTexture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, dr.depthRenderbuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::FRAMEBUFFER::DYNAMIC_RESOLUTION::NOT_COMPLETE" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    dr.allocatedWidth = width;
+    dr.allocatedHeight = height;
+}
+
+// The size the scene is drawn at for this window size and the current scale
+inline void dynamicResolutionSize(const DynamicResolution& dr, int windowWidth, int windowHeight, int& width, int& height) {
+    width = (int)(windowWidth * dr.scale + 0.5f);
+    height = (int)(windowHeight * dr.scale + 0.5f);
+    if (width < 1)
+        width = 1;
+    if (height < 1)
+        height = 1;
+}
+
+// Binds the offscreen framebuffer, sets the viewport to this frame's size
+// (dr.width x dr.height) and clears it with the current clear color
+inline void beginDynamicResolution(DynamicResolution& dr, int windowWidth, int windowHeight) {
+    if (windowWidth != dr.allocatedWidth || windowHeight != dr.allocatedHeight)
+        allocateDynamicResolution(dr, windowWidth, windowHeight);
+    dynamicResolutionSize(dr, windowWidth, windowHeight, dr.width, dr.height);
+    glBindFramebuffer(GL_FRAMEBUFFER, dr.framebuffer);
+    glViewport(0, 0, dr.width, dr.height);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+// Scales what was drawn up over the whole window framebuffer
+inline void endDynamicResolution(DynamicResolution& dr, int windowWidth, int windowHeight) {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, windowWidth, windowHeight);
+    GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+    glDisable(GL_DEPTH_TEST);
+
+    glUseProgram(dr.program);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, dr.colorTexture);
+    glUniform1i(glGetUniformLocation(dr.program, "scene"), 0);
+    glUniform2f(glGetUniformLocation(dr.program, "uvScale"), (float)dr.width / dr.allocatedWidth,
+                (float)dr.height / dr.allocatedHeight);
+    glUniform2f(glGetUniformLocation(dr.program, "texelSize"), 1.0f / dr.allocatedWidth, 1.0f / dr.allocatedHeight);
+    glUniform2f(glGetUniformLocation(dr.program, "outputSize"), (float)windowWidth, (float)windowHeight);
+    // Nothing to sharpen at full size
+    glUniform1f(glGetUniformLocation(dr.program, "sharpness"), dr.sharpen && dr.scale < 1.0f ? 0.5f : 0.0f);
+    glBindVertexArray(dr.emptyVao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+
+    if (depthTest)
+        glEnable(GL_DEPTH_TEST);
+}
+
+// Feeds the controller one frame time. Returns true when the scale changed;
+// the reason is in dr.lastDecision and is also printed.
+inline bool updateDynamicResolution(DynamicResolution& dr, double frameMs) {
+    dr.smoothedMs = dr.smoothedMs > 0.0 ? dr.smoothedMs + (frameMs - dr.smoothedMs) * 0.1 : frameMs;
+    if (dr.holdFrames > 0) {
+        --dr.holdFrames;
+        return false;
+    }
+    // Over the target costs frames; well under it only costs sharpness
+    bool over = dr.smoothedMs > dr.targetMs * 1.05;
+    bool under = dr.smoothedMs < dr.targetMs * 0.85;
+    if ((!over || dr.scale <= dr.minScale) && (!under || dr.scale >= dr.maxScale))
+        return false;
+
+    float wanted = dr.scale * (float)std::sqrt(dr.targetMs / dr.smoothedMs);
+    float next = dr.scale + (wanted - dr.scale) * 0.5f;
+    next = over ? std::floor(next / DYNAMIC_RESOLUTION_STEP) * DYNAMIC_RESOLUTION_STEP
+                : std::ceil(next / DYNAMIC_RESOLUTION_STEP) * DYNAMIC_RESOLUTION_STEP;
+    next = next < dr.minScale ? dr.minScale : (next > dr.maxScale ? dr.maxScale : next);
+    if (next == dr.scale)
+        return false;
+
+    std::ostringstream decision;
+    decision << std::fixed << std::setprecision(1) << dr.smoothedMs << " ms " << (over ? "over" : "under") << " the "
+             << dr.targetMs << " ms target, scale " << std::setprecision(2) << dr.scale << " -> " << next;
+    dr.lastDecision = decision.str();
+    std::cout << "dynamic resolution: " << dr.lastDecision << std::endl;
+    dr.scale = next;
+    dr.holdFrames = DYNAMIC_RESOLUTION_HOLD_FRAMES;
+    ++dr.changes;
+    return true;
+}
+
+inline void destroyDynamicResolution(DynamicResolution& dr) {
+    glDeleteTextures(1, &dr.colorTexture);
+    glDeleteRenderbuffers(1, &dr.depthRenderbuffer);
+    glDeleteFramebuffers(1, &dr.framebuffer);
+    glDeleteVertexArrays(1, &dr.emptyVao);
+    glDeleteProgram(dr.program);
+    dr = DynamicResolution();
+}
+
+#endif
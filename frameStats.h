@@ -0,0 +1,119 @@
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include "glStateCache.h"
+
+// Frame timing for the demos. Once a second the averages are printed to
+// stdout and shown in the window title, which doubles as the demos' HUD.
+//
+// CPU time is the time between frames. GPU time comes from GL_TIME_ELAPSED
+// queries around whatever the demo brackets with beginGpuTimer/endGpuTimer,
+// so it still means something when vsync caps the frame rate. Queries are
+// read back a few frames late to avoid stalling the pipeline.
+//
+// With glStateCache.h installed, the report also says how many of the
+// tracked GL calls per frame the cache kept from reaching the driver.
+
+const int FRAME_STATS_QUERY_COUNT = 4;
+
+struct FrameStats {
+    std::string title;        // window title without the stats
+    std::string hud;          // extra text a demo wants shown (mode, LOD, ...)
+    double reportStart;
+    int frames;
+    double cpuMsSum;
+    double gpuMsSum;
+    int gpuSamples;
+    double lastCpuMs;         // averages from the last report
+    double lastGpuMs;
+    double glCallsSum;        // state cache counters since the last report
+    double glElidedSum;
+    GLuint queries[FRAME_STATS_QUERY_COUNT];
+    bool queryPending[FRAME_STATS_QUERY_COUNT];
+    int queryIndex;
+};
+
+inline void initFrameStats(FrameStats& stats, const char* title) {
+    stats.title = title;
+    stats.hud.clear();
+    stats.reportStart = glfwGetTime();
+    stats.frames = 0;
+    stats.cpuMsSum = stats.gpuMsSum = 0.0;
+    stats.gpuSamples = 0;
+    stats.lastCpuMs = stats.lastGpuMs = 0.0;
+    stats.glCallsSum = stats.glElidedSum = 0.0;
+    takeGLStateCacheStats();
+    glGenQueries(FRAME_STATS_QUERY_COUNT, stats.queries);
+    for (int i = 0; i < FRAME_STATS_QUERY_COUNT; ++i)
+        stats.queryPending[i] = false;
+    stats.queryIndex = 0;
+}
+
+inline void beginGpuTimer(FrameStats& stats) {
+    int i = stats.queryIndex;
+    // Collect the oldest query before reusing its slot
+    if (stats.queryPending[i]) {
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(stats.queries[i], GL_QUERY_RESULT, &ns);
+        stats.gpuMsSum += ns / 1.0e6;
+        ++stats.gpuSamples;
+        stats.queryPending[i] = false;
+    }
+    glBeginQuery(GL_TIME_ELAPSED, stats.queries[i]);
+}
+
+inline void endGpuTimer(FrameStats& stats) {
+    glEndQuery(GL_TIME_ELAPSED);
+    stats.queryPending[stats.queryIndex] = true;
+    stats.queryIndex = (stats.queryIndex + 1) % FRAME_STATS_QUERY_COUNT;
+}
+
+// Call once per frame with the frame's deltaTime. Returns true on the frames
+// where a report was printed.
+inline bool updateFrameStats(FrameStats& stats, GLFWwindow* window, float deltaTime) {
+    stats.cpuMsSum += deltaTime * 1000.0;
+    ++stats.frames;
+    GLStateCacheStats gl = takeGLStateCacheStats();
+    stats.glCallsSum += gl.calls;
+    stats.glElidedSum += gl.elided;
+
+    double now = glfwGetTime();
+    if (now - stats.reportStart < 1.0)
+        return false;
+
+    stats.lastCpuMs = stats.cpuMsSum / stats.frames;
+    stats.lastGpuMs = stats.gpuSamples ? stats.gpuMsSum / stats.gpuSamples : 0.0;
+
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(2)
+         << stats.frames / (now - stats.reportStart) << " fps, frame " << stats.lastCpuMs << " ms";
+    if (stats.gpuSamples)
+        line << ", draw " << stats.lastGpuMs << " ms";
+    if (glStateCacheInstalled())
+        line << std::setprecision(0) << ", elided " << stats.glElidedSum / stats.frames << " of "
+             << stats.glCallsSum / stats.frames << " GL calls" << std::setprecision(2);
+    if (!stats.hud.empty())
+        line << " | " << stats.hud;
+
+    std::cout << stats.title << ": " << line.str() << std::endl;
+    glfwSetWindowTitle(window, (stats.title + " - " + line.str()).c_str());
+
+    stats.reportStart = now;
+    stats.frames = 0;
+    stats.cpuMsSum = stats.gpuMsSum = 0.0;
+    stats.glCallsSum = stats.glElidedSum = 0.0;
+    stats.gpuSamples = 0;
+    return true;
+}
+
+inline void destroyFrameStats(FrameStats& stats) {
+    glDeleteQueries(FRAME_STATS_QUERY_COUNT, stats.queries);
+}
+
+#endif
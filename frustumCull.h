@@ -0,0 +1,279 @@
+#ifndef FRUSTUM_CULL_H
+#define FRUSTUM_CULL_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define FRUSTUM_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FRUSTUM_SSE 1
+#endif
+#include "meshlet.h"     // extractFrustumPlanes
+#include "meshImport.h"  // parallelFor
+
+// Per-object frustum culling. Object bounds are kept as structure-of-arrays
+// columns (sphere center and radius, plus AABB half extents around the same
+// center) so eight objects (AVX2) or four (SSE) are tested against a plane
+// with a handful of instructions; there is a scalar path for everything
+// else. An object is culled when it lies behind any of the six planes of
+// projection * view, using the tighter of its sphere and its box for the
+// distance it reaches towards the plane.
+//
+// Large object counts are split into chunks culled on parallel threads. The
+// result is a compact, ascending list of visible object indices, so objects
+// that were stored grouped (by mesh, say) are still grouped afterwards.
+//
+// AVX2 is used when the file is compiled with it (-mavx2 or -march=native),
+// SSE otherwise on x86. Build with -pthread.
+
+enum FrustumCullPath {
+    FRUSTUM_CULL_SCALAR,
+    FRUSTUM_CULL_SSE,
+    FRUSTUM_CULL_AVX2,
+    FRUSTUM_CULL_PATH_COUNT
+};
+const char* const frustumCullPathNames[FRUSTUM_CULL_PATH_COUNT] = { "scalar", "SSE", "AVX2" };
+
+const size_t FRUSTUM_CULL_LANES = 8;             // columns are padded to this, chunks start on it
+const size_t FRUSTUM_CULL_MIN_CHUNK = 32 * 1024;  // below this a thread costs more than it saves
+
+inline bool frustumCullPathSupported(FrustumCullPath path) {
+    switch (path) {
+    case FRUSTUM_CULL_SCALAR: return true;
+#ifdef FRUSTUM_SSE
+    case FRUSTUM_CULL_SSE: return true;
+#endif
+#ifdef FRUSTUM_AVX2
+    case FRUSTUM_CULL_AVX2: return true;
+#endif
+    default: return false;
+    }
+}
+
+inline FrustumCullPath bestFrustumCullPath() {
+    for (int path = FRUSTUM_CULL_PATH_COUNT - 1; path > 0; --path)
+        if (frustumCullPathSupported((FrustumCullPath)path))
+            return (FrustumCullPath)path;
+    return FRUSTUM_CULL_SCALAR;
+}
+
+struct FrustumCullStats {
+    size_t objects;
+    size_t visible;
+    unsigned int threads;
+    double ms;
+};
+
+// Bounds columns plus the output of the last cull. visible[0, visibleCount)
+// holds the indices of the objects that survived.
+struct FrustumCuller {
+    std::vector<float> centerX, centerY, centerZ, radius;
+    std::vector<float> extentX, extentY, extentZ;
+    size_t count;
+    std::vector<uint32_t> visible;  // padded like the columns, chunks write their own ranges
+    size_t visibleCount;
+    FrustumCullStats stats;
+};
+
+// Sizes the columns for `count` objects. The padding never passes the test:
+// a negative radius reaches nowhere.
+inline void resizeFrustumCuller(FrustumCuller& culler, size_t count) {
+    size_t padded = (count + FRUSTUM_CULL_LANES - 1) / FRUSTUM_CULL_LANES * FRUSTUM_CULL_LANES;
+    std::vector<float>* columns[] = { &culler.centerX, &culler.centerY, &culler.centerZ,
+                                      &culler.extentX, &culler.extentY, &culler.extentZ };
+    for (int c = 0; c < 6; ++c)
+        columns[c]->assign(padded, 0.0f);
+    culler.radius.assign(padded, -1e30f);
+    culler.visible.resize(padded);
+    culler.count = count;
+    culler.visibleCount = 0;
+    culler.stats = FrustumCullStats();
+}
+
+inline void setCullBounds(FrustumCuller& culler, size_t i, const float center[3], float radius, const float extent[3]) {
+    culler.centerX[i] = center[0];
+    culler.centerY[i] = center[1];
+    culler.centerZ[i] = center[2];
+    culler.radius[i] = radius;
+    culler.extentX[i] = extent[0];
+    culler.extentY[i] = extent[1];
+    culler.extentZ[i] = extent[2];
+}
+
+// Each range function tests objects [begin, end), writes the indices of the
+// visible ones to out and returns how many there were. end may run into the
+// padding but not past it. Indices are written unconditionally and the count
+// only advances for visible objects, so there is no branch per object.
+inline size_t cullRangeScalar(const FrustumCuller& c, const float planes[6][4], size_t begin, size_t end, uint32_t* out) {
+    size_t n = 0;
+    for (size_t i = begin; i < end; ++i) {
+        bool in = true;
+        for (int p = 0; p < 6; ++p) {
+            float d = c.centerX[i] * planes[p][0] + c.centerY[i] * planes[p][1] + c.centerZ[i] * planes[p][2] + planes[p][3];
+            float box = fabsf(planes[p][0]) * c.extentX[i] + fabsf(planes[p][1]) * c.extentY[i]
+                      + fabsf(planes[p][2]) * c.extentZ[i];
+            in &= d >= -std::min(c.radius[i], box);
+        }
+        out[n] = (uint32_t)i;
+        n += in;
+    }
+    return n;
+}
+
+#ifdef FRUSTUM_SSE
+inline size_t cullRangeSSE(const FrustumCuller& c, const float planes[6][4], size_t begin, size_t end, uint32_t* out) {
+    size_t n = 0;
+    for (size_t i = begin; i < end; i += 4) {
+        __m128 cx = _mm_loadu_ps(&c.centerX[i]);
+        __m128 cy = _mm_loadu_ps(&c.centerY[i]);
+        __m128 cz = _mm_loadu_ps(&c.centerZ[i]);
+        __m128 r = _mm_loadu_ps(&c.radius[i]);
+        __m128 ex = _mm_loadu_ps(&c.extentX[i]);
+        __m128 ey = _mm_loadu_ps(&c.extentY[i]);
+        __m128 ez = _mm_loadu_ps(&c.extentZ[i]);
+        __m128 in = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p) {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(planes[p][0])), _mm_mul_ps(cy, _mm_set1_ps(planes[p][1]))),
+                                  _mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(planes[p][2])), _mm_set1_ps(planes[p][3])));
+            __m128 box = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(fabsf(planes[p][0]))),
+                                               _mm_mul_ps(ey, _mm_set1_ps(fabsf(planes[p][1])))),
+                                    _mm_mul_ps(ez, _mm_set1_ps(fabsf(planes[p][2]))));
+            __m128 reach = _mm_sub_ps(_mm_setzero_ps(), _mm_min_ps(r, box));
+            in = _mm_and_ps(in, _mm_cmpge_ps(d, reach));
+        }
+        int mask = _mm_movemask_ps(in);
+        for (int k = 0; k < 4; ++k) {
+            out[n] = (uint32_t)(i + k);
+            n += mask >> k & 1;
+        }
+    }
+    return n;
+}
+#endif
+
+#ifdef FRUSTUM_AVX2
+inline size_t cullRangeAVX2(const FrustumCuller& c, const float planes[6][4], size_t begin, size_t end, uint32_t* out) {
+    size_t n = 0;
+    for (size_t i = begin; i < end; i += 8) {
+        __m256 cx = _mm256_loadu_ps(&c.centerX[i]);
+        __m256 cy = _mm256_loadu_ps(&c.centerY[i]);
+        __m256 cz = _mm256_loadu_ps(&c.centerZ[i]);
+        __m256 r = _mm256_loadu_ps(&c.radius[i]);
+        __m256 ex = _mm256_loadu_ps(&c.extentX[i]);
+        __m256 ey = _mm256_loadu_ps(&c.extentY[i]);
+        __m256 ez = _mm256_loadu_ps(&c.extentZ[i]);
+        __m256 in = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p) {
+            __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cx, _mm256_set1_ps(planes[p][0])),
+                                                   _mm256_mul_ps(cy, _mm256_set1_ps(planes[p][1]))),
+                                     _mm256_add_ps(_mm256_mul_ps(cz, _mm256_set1_ps(planes[p][2])), _mm256_set1_ps(planes[p][3])));
+            __m256 box = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ex, _mm256_set1_ps(fabsf(planes[p][0]))),
+                                                     _mm256_mul_ps(ey, _mm256_set1_ps(fabsf(planes[p][1])))),
+                                       _mm256_mul_ps(ez, _mm256_set1_ps(fabsf(planes[p][2]))));
+            __m256 reach = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_min_ps(r, box));
+            in = _mm256_and_ps(in, _mm256_cmp_ps(d, reach, _CMP_GE_OQ));
+        }
+        int mask = _mm256_movemask_ps(in);
+        for (int k = 0; k < 8; ++k) {
+            out[n] = (uint32_t)(i + k);
+            n += mask >> k & 1;
+        }
+    }
+    return n;
+}
+#endif
+
+inline size_t cullRange(FrustumCullPath path, const FrustumCuller& c, const float planes[6][4], size_t begin, size_t end,
+                        uint32_t* out) {
+#ifdef FRUSTUM_AVX2
+    if (path == FRUSTUM_CULL_AVX2)
+        return cullRangeAVX2(c, planes, begin, end, out);
+#endif
+#ifdef FRUSTUM_SSE
+    if (path == FRUSTUM_CULL_SSE)
+        return cullRangeSSE(c, planes, begin, end, out);
+#endif
+    return cullRangeScalar(c, planes, begin, end, out);
+}
+
+// Thread count for `count` objects, at most maxThreads (0 means one per core)
+inline unsigned int frustumCullThreadCount(size_t count, unsigned int maxThreads = 0) {
+    unsigned int threads = maxThreads ? maxThreads : meshImportThreadCount();
+    return (unsigned int)std::max<size_t>(1, std::min<size_t>(threads, count / FRUSTUM_CULL_MIN_CHUNK));
+}
+
+// Culls every object against the frustum of a column-major projection * view
+// matrix and leaves the visible indices, in ascending order, at the front of
+// culler.visible. Returns the visible count.
+inline size_t frustumCull(FrustumCuller& culler, const float* viewProjection,
+                          FrustumCullPath path = bestFrustumCullPath(), unsigned int maxThreads = 0) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (!frustumCullPathSupported(path))
+        path = FRUSTUM_CULL_SCALAR;
+    float planes[6][4];
+    extractFrustumPlanes(viewProjection, planes);
+
+    // Chunks start on a lane boundary and end in the padding at the latest
+    const size_t groups = (culler.count + FRUSTUM_CULL_LANES - 1) / FRUSTUM_CULL_LANES;
+    const unsigned int threads = frustumCullThreadCount(culler.count, maxThreads);
+    std::vector<size_t> found(threads, 0);
+    uint32_t* out = culler.visible.data();
+    parallelFor(threads, [&](unsigned int t) {
+        size_t begin = groups * t / threads * FRUSTUM_CULL_LANES;
+        size_t end = groups * (t + 1) / threads * FRUSTUM_CULL_LANES;
+        found[t] = cullRange(path, culler, planes, begin, end, out + begin);
+    });
+
+    // Each chunk wrote to the front of its own range, close the gaps
+    size_t visible = found[0];
+    for (unsigned int t = 1; t < threads; ++t) {
+        size_t begin = groups * t / threads * FRUSTUM_CULL_LANES;
+        memmove(out + visible, out + begin, found[t] * sizeof(uint32_t));
+        visible += found[t];
+    }
+    culler.visibleCount = visible;
+
+    culler.stats.objects = culler.count;
+    culler.stats.visible = visible;
+    culler.stats.threads = threads;
+    culler.stats.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return visible;
+}
+
+// Times every available path on one thread and on all of them over the
+// current bounds and prints objects tested per nanosecond. Leaves the result
+// of the last run in the culler.
+inline void benchmarkFrustumCull(FrustumCuller& culler, const float* viewProjection, int repeats = 50) {
+    std::cout << "Frustum cull benchmark, " << culler.count << " objects, " << repeats << " runs each" << std::endl;
+    unsigned int threadCounts[2] = { 1, frustumCullThreadCount(culler.count) };
+    for (int path = 0; path < FRUSTUM_CULL_PATH_COUNT; ++path) {
+        if (!frustumCullPathSupported((FrustumCullPath)path))
+            continue;
+        for (int t = 0; t < 2; ++t) {
+            if (t == 1 && threadCounts[1] == threadCounts[0])
+                continue;
+            frustumCull(culler, viewProjection, (FrustumCullPath)path, threadCounts[t]);  // warm up
+            double best = 1e30;
+            for (int r = 0; r < repeats; ++r) {
+                frustumCull(culler, viewProjection, (FrustumCullPath)path, threadCounts[t]);
+                best = std::min(best, culler.stats.ms);
+            }
+            std::cout << "  " << std::left << std::setw(7) << frustumCullPathNames[path] << std::right
+                      << std::setw(3) << threadCounts[t] << (threadCounts[t] == 1 ? " thread:  " : " threads: ")
+                      << std::fixed << std::setprecision(3) << best << " ms, "
+                      << std::setprecision(2) << culler.count / (best * 1.0e6) << " objects/ns, "
+                      << culler.visibleCount << " visible" << std::endl;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,202 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "mesh.h"
+#include "meshWeld.h"
+#include "meshOptimize.h"
+#include "vertexCompress.h"
+
+// Geometry arena: every shape in one VAO, one vertex buffer and one index
+// buffer. Each mesh records where its vertices start (baseVertex) and where
+// each of its LODs starts in the index buffer, so any mix of objects is one
+// glMultiDrawElementsIndirect call over a command buffer built per frame. There
+// are no per-object VAO binds and no per-object draw calls.
+//
+// Meshes are added as float data and reduced to positions, then welded and
+// reordered. At upload time all positions are packed to 16-bit UNORM inside
+// the union of the mesh bounds, so the whole arena shares one decode and the
+// vertex shader needs no per-draw state. That suits shapes of similar size,
+// like the demo shapes.
+
+// Layout GL reads from GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand {
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t baseVertex;
+    uint32_t baseInstance;
+};
+
+struct ArenaMesh {
+    std::string name;
+    uint32_t baseVertex;        // first vertex in the arena vertex buffer
+    uint32_t vertexCount;
+    std::vector<MeshLOD> lods;  // index ranges in the arena index buffer, at least one
+    MeshBounds bounds;
+};
+
+struct GeometryArena {
+    // Staging, emptied by uploadGeometryArena
+    std::vector<float> positions;       // xyz
+    std::vector<unsigned int> indices;  // relative to each mesh's baseVertex
+
+    std::vector<ArenaMesh> meshes;
+    MeshDecode decode;  // shared by every mesh
+    GLuint VAO, VBO, EBO;
+    GLenum indexType;
+    size_t vertexBytes, indexBytes;
+    GLuint commandBuffer;
+    size_t commandCapacity;  // commands the indirect buffer can hold
+};
+
+// Stages a mesh and returns its id. Only the positions (location 0, float)
+// are kept. Returns -1 for meshes the arena cannot take.
+inline int addArenaMesh(GeometryArena& arena, const MeshData& mesh, const char* name) {
+    const MeshAttrib* position = NULL;
+    for (size_t i = 0; i < mesh.layout.size(); ++i)
+        if (mesh.layout[i].location == 0 && mesh.layout[i].type == GL_FLOAT && mesh.layout[i].components == 3)
+            position = &mesh.layout[i];
+    if (!position || mesh.quantized || !mesh.batches.empty()) {
+        std::cout << "ERROR::ARENA::UNSUPPORTED_MESH " << name << " (needs unsplit float positions)" << std::endl;
+        return -1;
+    }
+
+    // Positions only: normals and UVs would stop the weld and differ between shapes
+    const size_t vertexCount = meshVertexCount(mesh);
+    const size_t strideFloats = mesh.stride / sizeof(float);
+    MeshData stripped;
+    stripped.layout.assign(1, *position);
+    stripped.layout[0].offset = 0;
+    stripped.stride = 3 * sizeof(float);
+    stripped.vertices.resize(vertexCount * 3);
+    for (size_t v = 0; v < vertexCount; ++v)
+        for (int k = 0; k < 3; ++k)
+            stripped.vertices[v * 3 + k] = mesh.vertices[v * strideFloats + position->offset / sizeof(float) + k];
+    stripped.indices = mesh.indices;
+    stripped.lods = mesh.lods;
+    weldMesh(stripped);
+    optimizeMesh(stripped);
+
+    ArenaMesh entry;
+    entry.name = name;
+    entry.baseVertex = arena.positions.size() / 3;
+    entry.vertexCount = meshVertexCount(stripped);
+    entry.bounds = computeMeshBounds(stripped.vertices.data(), entry.vertexCount, 3);
+    uint32_t firstIndex = arena.indices.size();
+    if (stripped.lods.empty()) {
+        MeshLOD whole = { 0, (uint32_t)stripped.indices.size(), entry.vertexCount, 0 };
+        stripped.lods.push_back(whole);
+    }
+    for (size_t l = 0; l < stripped.lods.size(); ++l) {
+        MeshLOD lod = stripped.lods[l];
+        lod.firstIndex += firstIndex;
+        entry.lods.push_back(lod);
+    }
+    arena.positions.insert(arena.positions.end(), stripped.vertices.begin(), stripped.vertices.end());
+    arena.indices.insert(arena.indices.end(), stripped.indices.begin(), stripped.indices.end());
+    arena.meshes.push_back(entry);
+    return (int)arena.meshes.size() - 1;
+}
+
+// Packs the staged meshes and creates the GL objects. Prints the arena size.
+inline void uploadGeometryArena(GeometryArena& arena) {
+    const size_t vertexCount = arena.positions.size() / 3;
+    MeshBounds bounds = computeMeshBounds(arena.positions.data(), vertexCount, 3);
+    arena.decode = identityMeshDecode();
+    for (int k = 0; k < 3; ++k) {
+        float extent = bounds.max[k] - bounds.min[k];
+        arena.decode.positionScale[k] = extent > 0.0f ? extent : 1.0f;
+        arena.decode.positionBias[k] = bounds.min[k];
+    }
+
+    // Same UNORM16 layout compressVertices uses, the fourth component is padding
+    std::vector<uint16_t> packed(vertexCount * 4, 0);
+    for (size_t v = 0; v < vertexCount; ++v)
+        for (int k = 0; k < 3; ++k)
+            packed[v * 4 + k] = (uint16_t)quantizeUnorm((arena.positions[v * 3 + k] - arena.decode.positionBias[k])
+                                                        / arena.decode.positionScale[k], 16);
+    MeshAttrib position = { 0, 3, GL_UNSIGNED_SHORT, GL_TRUE, 0 };
+
+    // Indices are relative to baseVertex, so the largest mesh decides the type
+    size_t largest = 0;
+    for (size_t m = 0; m < arena.meshes.size(); ++m)
+        largest = std::max<size_t>(largest, arena.meshes[m].vertexCount);
+    arena.indexType = narrowestIndexType(largest);
+    std::vector<unsigned char> indexBytes = packIndices(arena.indices, arena.indexType);
+    arena.vertexBytes = packed.size() * sizeof(uint16_t);
+    arena.indexBytes = indexBytes.size();
+
+    glGenVertexArrays(1, &arena.VAO);
+    glGenBuffers(1, &arena.VBO);
+    glGenBuffers(1, &arena.EBO);
+    glBindVertexArray(arena.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, arena.VBO);
+    glBufferData(GL_ARRAY_BUFFER, arena.vertexBytes, packed.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena.EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, arena.indexBytes, indexBytes.data(), GL_STATIC_DRAW);
+    setupMeshAttribs(&position, 1, 4 * sizeof(uint16_t));
+    glBindVertexArray(0);
+
+    glGenBuffers(1, &arena.commandBuffer);
+    arena.commandCapacity = 0;
+
+    std::cout << "Geometry arena: " << arena.meshes.size() << " meshes, " << vertexCount << " vertices, "
+              << arena.indices.size() << " " << indexTypeName(arena.indexType) << " indices, "
+              << arena.vertexBytes + arena.indexBytes << " bytes" << std::endl;
+    arena.positions = std::vector<float>();
+    arena.indices = std::vector<unsigned int>();
+}
+
+// glMultiDrawElementsIndirect is GL 4.3; baseInstance needs 4.2
+inline bool arenaIndirectSupported() {
+    return GLAD_GL_ARB_multi_draw_indirect && GLAD_GL_ARB_base_instance;
+}
+
+// The command drawing `instanceCount` instances of one mesh LOD, reading
+// per-instance attributes from baseInstance on
+inline DrawElementsIndirectCommand arenaDrawCommand(const GeometryArena& arena, unsigned int mesh, unsigned int lod,
+                                                    uint32_t instanceCount, uint32_t baseInstance) {
+    const ArenaMesh& m = arena.meshes[mesh];
+    const MeshLOD& range = m.lods[lod < m.lods.size() ? lod : m.lods.size() - 1];
+    DrawElementsIndirectCommand command = { range.indexCount, instanceCount, range.firstIndex,
+                                            (int32_t)m.baseVertex, baseInstance };
+    return command;
+}
+
+inline void setArenaDecodeUniforms(GLuint program, const GeometryArena& arena) {
+    glUniform3fv(glGetUniformLocation(program, "positionScale"), 1, arena.decode.positionScale);
+    glUniform3fv(glGetUniformLocation(program, "positionBias"), 1, arena.decode.positionBias);
+}
+
+// Uploads this frame's commands and draws them all with one call. The
+// command buffer is orphaned first so the upload does not wait on the
+// previous frame.
+inline void drawGeometryArena(GeometryArena& arena, const DrawElementsIndirectCommand* commands, size_t count,
+                              GLenum mode = GL_TRIANGLES) {
+    if (!count)
+        return;
+    glBindVertexArray(arena.VAO);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, arena.commandBuffer);
+    size_t capacity = std::max(arena.commandCapacity, count);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, capacity * sizeof(DrawElementsIndirectCommand), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, count * sizeof(DrawElementsIndirectCommand), commands);
+    arena.commandCapacity = capacity;
+    glMultiDrawElementsIndirect(mode, arena.indexType, 0, (GLsizei)count, 0);
+}
+
+inline void destroyGeometryArena(GeometryArena& arena) {
+    glDeleteVertexArrays(1, &arena.VAO);
+    glDeleteBuffers(1, &arena.VBO);
+    glDeleteBuffers(1, &arena.EBO);
+    glDeleteBuffers(1, &arena.commandBuffer);
+    arena.VAO = arena.VBO = arena.EBO = arena.commandBuffer = 0;
+    arena.meshes.clear();
+}
+
+#endif
@@ -0,0 +1,348 @@
+#ifndef GL_STATE_CACHE_H
+#define GL_STATE_CACHE_H
+
+#include <glad/glad.h>
+#include <cstddef>
+
+// Skips GL calls that would not change anything. Every call into Mesa costs
+// CPU time even when it only sets what is already set, and the demos and
+// mainWindow re-bind the same program, VAO and textures and set the same
+// polygon mode every frame.
+//
+// installGLStateCache() swaps the GLAD entry points for the tracked calls
+// (glUseProgram, glBindVertexArray, glBindBuffer*, glActiveTexture,
+// glBindTexture, glEnable/glDisable, glBlendFunc, glDepthFunc, glDepthMask,
+// glPolygonMode and the glDelete* calls that unbind things) for wrappers that
+// remember the current value and only call the driver when it changes, so
+// no call site needs to change. Call it right after gladLoadGLLoader, with
+// one context per process. Values start unknown, so the first call of each
+// always goes through; state set any other way (glBlendFuncSeparate, ...)
+// is not seen, so avoid mixing those with the tracked calls.
+//
+// takeGLStateCacheStats() returns and resets the call counters; frameStats.h
+// shows them in the title bar when the cache is installed.
+
+const GLuint GL_STATE_UNKNOWN = 0xFFFFFFFFu;
+const int GL_STATE_TEXTURE_UNITS = 32;
+const int GL_STATE_BUFFER_TARGETS = 14;
+const int GL_STATE_TEXTURE_TARGETS = 5;
+const int GL_STATE_CAPS = 7;
+
+struct GLStateCacheStats {
+    size_t calls;   // tracked calls made by the program
+    size_t elided;  // of those, the ones that never reached the driver
+};
+
+struct GLStateCache {
+    bool installed;
+    GLuint program, vao;
+    GLuint buffers[GL_STATE_BUFFER_TARGETS];
+    GLuint activeUnit;  // 0-based
+    GLuint textures[GL_STATE_TEXTURE_UNITS][GL_STATE_TEXTURE_TARGETS];
+    int caps[GL_STATE_CAPS];  // -1 unknown, 0 disabled, 1 enabled
+    GLenum blendSrc, blendDst, depthFunc, polygonMode;
+    GLuint depthMask;
+    GLStateCacheStats stats;
+
+    // The driver's entry points
+    PFNGLUSEPROGRAMPROC useProgram;
+    PFNGLBINDVERTEXARRAYPROC bindVertexArray;
+    PFNGLBINDBUFFERPROC bindBuffer;
+    PFNGLBINDBUFFERBASEPROC bindBufferBase;
+    PFNGLBINDBUFFERRANGEPROC bindBufferRange;
+    PFNGLACTIVETEXTUREPROC activeTexture;
+    PFNGLBINDTEXTUREPROC bindTexture;
+    PFNGLENABLEPROC enable;
+    PFNGLDISABLEPROC disable;
+    PFNGLBLENDFUNCPROC blendFunc;
+    PFNGLDEPTHFUNCPROC depthFuncCall;
+    PFNGLDEPTHMASKPROC depthMaskCall;
+    PFNGLPOLYGONMODEPROC polygonModeCall;
+    PFNGLDELETEPROGRAMPROC deleteProgram;
+    PFNGLDELETEVERTEXARRAYSPROC deleteVertexArrays;
+    PFNGLDELETEBUFFERSPROC deleteBuffers;
+    PFNGLDELETETEXTURESPROC deleteTextures;
+};
+
+inline GLStateCache& glStateCache() {
+    static GLStateCache cache;
+    return cache;
+}
+
+inline int glStateBufferSlot(GLenum target) {
+    switch (target) {
+        case GL_ARRAY_BUFFER:              return 0;
+        case GL_ELEMENT_ARRAY_BUFFER:      return 1;
+        case GL_UNIFORM_BUFFER:            return 2;
+        case GL_TEXTURE_BUFFER:            return 3;
+        case GL_COPY_READ_BUFFER:          return 4;
+        case GL_COPY_WRITE_BUFFER:         return 5;
+        case GL_PIXEL_PACK_BUFFER:         return 6;
+        case GL_PIXEL_UNPACK_BUFFER:       return 7;
+        case GL_TRANSFORM_FEEDBACK_BUFFER: return 8;
+        case GL_DRAW_INDIRECT_BUFFER:      return 9;
+        case GL_DISPATCH_INDIRECT_BUFFER:  return 10;
+        case GL_SHADER_STORAGE_BUFFER:     return 11;
+        case GL_ATOMIC_COUNTER_BUFFER:     return 12;
+        case GL_QUERY_BUFFER:              return 13;
+        default:                           return -1;
+    }
+}
+
+inline int glStateTextureSlot(GLenum target) {
+    switch (target) {
+        case GL_TEXTURE_2D:       return 0;
+        case GL_TEXTURE_2D_ARRAY: return 1;
+        case GL_TEXTURE_BUFFER:   return 2;
+        case GL_TEXTURE_3D:       return 3;
+        case GL_TEXTURE_CUBE_MAP: return 4;
+        default:                  return -1;
+    }
+}
+
+inline int glStateCapSlot(GLenum cap) {
+    switch (cap) {
+        case GL_BLEND:               return 0;
+        case GL_DEPTH_TEST:          return 1;
+        case GL_CULL_FACE:           return 2;
+        case GL_POLYGON_OFFSET_FILL: return 3;
+        case GL_DEPTH_CLAMP:         return 4;
+        case GL_SCISSOR_TEST:        return 5;
+        case GL_STENCIL_TEST:        return 6;
+        default:                     return -1;
+    }
+}
+
+// Counts a tracked call and returns true when it changes nothing
+inline bool glStateUnchanged(bool same) {
+    GLStateCache& c = glStateCache();
+    ++c.stats.calls;
+    if (same)
+        ++c.stats.elided;
+    return same;
+}
+
+inline void APIENTRY cachedUseProgram(GLuint program) {
+    GLStateCache& c = glStateCache();
+    if (glStateUnchanged(c.program == program))
+        return;
+    c.program = program;
+    c.useProgram(program);
+}
+
+inline void APIENTRY cachedBindVertexArray(GLuint vao) {
+    GLStateCache& c = glStateCache();
+    if (glStateUnchanged(c.vao == vao))
+        return;
+    c.vao = vao;
+    // The element buffer binding belongs to the VAO
+    c.buffers[1] = GL_STATE_UNKNOWN;
+    c.bindVertexArray(vao);
+}
+
+inline void APIENTRY cachedBindBuffer(GLenum target, GLuint buffer) {
+    GLStateCache& c = glStateCache();
+    int slot = glStateBufferSlot(target);
+    if (slot < 0) {
+        c.bindBuffer(target, buffer);
+        return;
+    }
+    if (glStateUnchanged(c.buffers[slot] == buffer))
+        return;
+    c.buffers[slot] = buffer;
+    c.bindBuffer(target, buffer);
+}
+
+// Indexed binds always go through, but they also move the generic binding
+inline void APIENTRY cachedBindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+    GLStateCache& c = glStateCache();
+    int slot = glStateBufferSlot(target);
+    if (slot >= 0)
+        c.buffers[slot] = buffer;
+    c.bindBufferBase(target, index, buffer);
+}
+
+inline void APIENTRY cachedBindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+    GLStateCache& c = glStateCache();
+    int slot = glStateBufferSlot(target);
+    if (slot >= 0)
+        c.buffers[slot] = buffer;
+    c.bindBufferRange(target, index, buffer, offset, size);
+}
+
+inline void APIENTRY cachedActiveTexture(GLenum texture) {
+    GLStateCache& c = glStateCache();
+    GLuint unit = texture - GL_TEXTURE0;
+    if (glStateUnchanged(c.activeUnit == unit))
+        return;
+    c.activeUnit = unit;
+    c.activeTexture(texture);
+}
+
+inline void APIENTRY cachedBindTexture(GLenum target, GLuint texture) {
+    GLStateCache& c = glStateCache();
+    int slot = glStateTextureSlot(target);
+    if (slot < 0 || c.activeUnit >= (GLuint)GL_STATE_TEXTURE_UNITS) {
+        c.bindTexture(target, texture);
+        return;
+    }
+    GLuint& bound = c.textures[c.activeUnit][slot];
+    if (glStateUnchanged(bound == texture))
+        return;
+    bound = texture;
+    c.bindTexture(target, texture);
+}
+
+inline void APIENTRY cachedEnable(GLenum cap) {
+    GLStateCache& c = glStateCache();
+    int slot = glStateCapSlot(cap);
+    if (slot >= 0) {
+        if (glStateUnchanged(c.caps[slot] == 1))
+            return;
+        c.caps[slot] = 1;
+    }
+    c.enable(cap);
+}
+
+inline void APIENTRY cachedDisable(GLenum cap) {
+    GLStateCache& c = glStateCache();
+    int slot = glStateCapSlot(cap);
+    if (slot >= 0) {
+        if (glStateUnchanged(c.caps[slot] == 0))
+            return;
+        c.caps[slot] = 0;
+    }
+    c.disable(cap);
+}
+
+inline void APIENTRY cachedBlendFunc(GLenum src, GLenum dst) {
+    GLStateCache& c = glStateCache();
+    if (glStateUnchanged(c.blendSrc == src && c.blendDst == dst))
+        return;
+    c.blendSrc = src;
+    c.blendDst = dst;
+    c.blendFunc(src, dst);
+}
+
+inline void APIENTRY cachedDepthFunc(GLenum func) {
+    GLStateCache& c = glStateCache();
+    if (glStateUnchanged(c.depthFunc == func))
+        return;
+    c.depthFunc = func;
+    c.depthFuncCall(func);
+}
+
+inline void APIENTRY cachedDepthMask(GLboolean flag) {
+    GLStateCache& c = glStateCache();
+    if (glStateUnchanged(c.depthMask == (GLuint)flag))
+        return;
+    c.depthMask = flag;
+    c.depthMaskCall(flag);
+}
+
+// Core profiles only take GL_FRONT_AND_BACK, so one mode covers both faces
+inline void APIENTRY cachedPolygonMode(GLenum face, GLenum mode) {
+    GLStateCache& c = glStateCache();
+    if (face != GL_FRONT_AND_BACK) {
+        c.polygonMode = GL_STATE_UNKNOWN;
+        c.polygonModeCall(face, mode);
+        return;
+    }
+    if (glStateUnchanged(c.polygonMode == mode))
+        return;
+    c.polygonMode = mode;
+    c.polygonModeCall(face, mode);
+}
+
+// Deleting a bound object unbinds it, and its name can come back from glGen*
+inline void APIENTRY cachedDeleteProgram(GLuint program) {
+    GLStateCache& c = glStateCache();
+    if (program && c.program == program)
+        c.program = GL_STATE_UNKNOWN;
+    c.deleteProgram(program);
+}
+
+inline void APIENTRY cachedDeleteVertexArrays(GLsizei n, const GLuint* arrays) {
+    GLStateCache& c = glStateCache();
+    for (GLsizei i = 0; i < n; ++i)
+        if (arrays[i] && c.vao == arrays[i]) {
+            c.vao = 0;
+            c.buffers[1] = GL_STATE_UNKNOWN;
+        }
+    c.deleteVertexArrays(n, arrays);
+}
+
+inline void APIENTRY cachedDeleteBuffers(GLsizei n, const GLuint* buffers) {
+    GLStateCache& c = glStateCache();
+    for (GLsizei i = 0; i < n; ++i)
+        for (int t = 0; t < GL_STATE_BUFFER_TARGETS; ++t)
+            if (buffers[i] && c.buffers[t] == buffers[i])
+                c.buffers[t] = 0;
+    c.deleteBuffers(n, buffers);
+}
+
+inline void APIENTRY cachedDeleteTextures(GLsizei n, const GLuint* textures) {
+    GLStateCache& c = glStateCache();
+    for (GLsizei i = 0; i < n; ++i)
+        for (int u = 0; u < GL_STATE_TEXTURE_UNITS; ++u)
+            for (int t = 0; t < GL_STATE_TEXTURE_TARGETS; ++t)
+                if (textures[i] && c.textures[u][t] == textures[i])
+                    c.textures[u][t] = 0;
+    c.deleteTextures(n, textures);
+}
+
+// Forgets everything the cache knows, e.g. after code that bypassed it
+inline void resetGLStateCache() {
+    GLStateCache& c = glStateCache();
+    c.program = c.vao = GL_STATE_UNKNOWN;
+    for (int t = 0; t < GL_STATE_BUFFER_TARGETS; ++t)
+        c.buffers[t] = GL_STATE_UNKNOWN;
+    c.activeUnit = GL_STATE_UNKNOWN;
+    for (int u = 0; u < GL_STATE_TEXTURE_UNITS; ++u)
+        for (int t = 0; t < GL_STATE_TEXTURE_TARGETS; ++t)
+            c.textures[u][t] = GL_STATE_UNKNOWN;
+    for (int i = 0; i < GL_STATE_CAPS; ++i)
+        c.caps[i] = -1;
+    c.blendSrc = c.blendDst = c.depthFunc = c.polygonMode = GL_STATE_UNKNOWN;
+    c.depthMask = GL_STATE_UNKNOWN;
+}
+
+inline void installGLStateCache() {
+    GLStateCache& c = glStateCache();
+    if (c.installed)
+        return;
+    c.installed = true;
+    resetGLStateCache();
+    c.stats = GLStateCacheStats();
+
+    c.useProgram = glad_glUseProgram;                 glad_glUseProgram = cachedUseProgram;
+    c.bindVertexArray = glad_glBindVertexArray;       glad_glBindVertexArray = cachedBindVertexArray;
+    c.bindBuffer = glad_glBindBuffer;                 glad_glBindBuffer = cachedBindBuffer;
+    c.bindBufferBase = glad_glBindBufferBase;         glad_glBindBufferBase = cachedBindBufferBase;
+    c.bindBufferRange = glad_glBindBufferRange;       glad_glBindBufferRange = cachedBindBufferRange;
+    c.activeTexture = glad_glActiveTexture;           glad_glActiveTexture = cachedActiveTexture;
+    c.bindTexture = glad_glBindTexture;               glad_glBindTexture = cachedBindTexture;
+    c.enable = glad_glEnable;                         glad_glEnable = cachedEnable;
+    c.disable = glad_glDisable;                       glad_glDisable = cachedDisable;
+    c.blendFunc = glad_glBlendFunc;                   glad_glBlendFunc = cachedBlendFunc;
+    c.depthFuncCall = glad_glDepthFunc;               glad_glDepthFunc = cachedDepthFunc;
+    c.depthMaskCall = glad_glDepthMask;               glad_glDepthMask = cachedDepthMask;
+    c.polygonModeCall = glad_glPolygonMode;           glad_glPolygonMode = cachedPolygonMode;
+    c.deleteProgram = glad_glDeleteProgram;           glad_glDeleteProgram = cachedDeleteProgram;
+    c.deleteVertexArrays = glad_glDeleteVertexArrays; glad_glDeleteVertexArrays = cachedDeleteVertexArrays;
+    c.deleteBuffers = glad_glDeleteBuffers;           glad_glDeleteBuffers = cachedDeleteBuffers;
+    c.deleteTextures = glad_glDeleteTextures;         glad_glDeleteTextures = cachedDeleteTextures;
+}
+
+inline bool glStateCacheInstalled() {
+    return glStateCache().installed;
+}
+
+inline GLStateCacheStats takeGLStateCacheStats() {
+    GLStateCache& c = glStateCache();
+    GLStateCacheStats stats = c.stats;
+    c.stats = GLStateCacheStats();
+    return stats;
+}
+
+#endif
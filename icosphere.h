@@ -0,0 +1,171 @@
+#ifndef ICOSPHERE_H
+#define ICOSPHERE_H
+
+#include <vector>
+#include <unordered_map>
+#include <cmath>
+#include <cstdint>
+
+// Icosphere generator with a discrete LOD chain.
+//
+// Every level is built by splitting each triangle of the previous level into
+// four. Midpoints are cached per edge, so a vertex created at level k keeps its
+// index at every finer level. That means all levels share one vertex buffer:
+// level k only touches the first levelVertexCount[k] vertices, and its indices
+// live at [firstIndex, firstIndex + indexCount) of the shared index buffer.
+
+struct IcosphereLevel {
+    unsigned int firstIndex;   // offset into the shared index buffer (in indices)
+    unsigned int indexCount;   // number of indices to draw for this level
+    unsigned int vertexCount;  // highest vertex used + 1 (for glDrawRangeElements)
+};
+
+struct IcosphereLODs {
+    std::vector<float> vertices;          // xyz per vertex, on the unit sphere * radius
+    std::vector<unsigned int> indices;    // all levels back to back
+    std::vector<IcosphereLevel> levels;   // levels[0] is the plain icosahedron
+};
+
+// Returns the index of the vertex halfway between a and b, creating it the
+// first time the edge is seen. The key is order independent so both triangles
+// sharing an edge get the same midpoint.
+inline unsigned int icosphereMidpoint(std::unordered_map<uint64_t, unsigned int>& edgeCache,
+                                      std::vector<float>& vertices, unsigned int a, unsigned int b) {
+    uint64_t lo = a < b ? a : b;
+    uint64_t hi = a < b ? b : a;
+    uint64_t key = (lo << 32) | hi;
+
+    std::unordered_map<uint64_t, unsigned int>::iterator it = edgeCache.find(key);
+    if (it != edgeCache.end())
+        return it->second;
+
+    float x = vertices[a * 3 + 0] + vertices[b * 3 + 0];
+    float y = vertices[a * 3 + 1] + vertices[b * 3 + 1];
+    float z = vertices[a * 3 + 2] + vertices[b * 3 + 2];
+    float len = sqrtf(x * x + y * y + z * z);
+
+    unsigned int index = vertices.size() / 3;
+    vertices.push_back(x / len);
+    vertices.push_back(y / len);
+    vertices.push_back(z / len);
+    edgeCache[key] = index;
+    return index;
+}
+
+// Builds levels 0..maxLevel. Level 0 has 20 triangles, each level after that
+// has four times as many as the one before.
+inline IcosphereLODs createIcosphereLODs(float radius, unsigned int maxLevel) {
+    IcosphereLODs lods;
+
+    // The 12 icosahedron corners are the cyclic permutations of (0, +-1, +-t)
+    const float t = (1.0f + sqrtf(5.0f)) / 2.0f;
+    const float len = sqrtf(1.0f + t * t);
+    const float a = 1.0f / len;
+    const float b = t / len;
+    const float corners[] = {
+        -a,  b, 0.0f,   a,  b, 0.0f,  -a, -b, 0.0f,   a, -b, 0.0f,
+        0.0f, -a,  b,   0.0f,  a,  b,  0.0f, -a, -b,  0.0f,  a, -b,
+         b, 0.0f, -a,   b, 0.0f,  a,  -b, 0.0f, -a,  -b, 0.0f,  a
+    };
+    const unsigned int faces[] = {
+        0, 11, 5,   0, 5, 1,    0, 1, 7,    0, 7, 10,   0, 10, 11,
+        1, 5, 9,    5, 11, 4,   11, 10, 2,  10, 7, 6,   7, 1, 8,
+        3, 9, 4,    3, 4, 2,    3, 2, 6,    3, 6, 8,    3, 8, 9,
+        4, 9, 5,    2, 4, 11,   6, 2, 10,   8, 6, 7,    9, 8, 1
+    };
+
+    lods.vertices.assign(corners, corners + sizeof(corners) / sizeof(float));
+    std::vector<unsigned int> current(faces, faces + sizeof(faces) / sizeof(unsigned int));
+
+    // Final sizes are known up front: V = 10 * 4^L + 2, and the index total is
+    // a geometric series over all levels.
+    size_t totalIndices = 0;
+    for (unsigned int level = 0; level <= maxLevel; ++level)
+        totalIndices += 60u << (2 * level);
+    lods.vertices.reserve((10u * (1u << (2 * maxLevel)) + 2u) * 3u);
+    lods.indices.reserve(totalIndices);
+
+    std::unordered_map<uint64_t, unsigned int> edgeCache;
+    for (unsigned int level = 0; level <= maxLevel; ++level) {
+        if (level > 0) {
+            std::vector<unsigned int> next;
+            next.reserve(current.size() * 4);
+            edgeCache.reserve(current.size() / 2);
+            for (size_t i = 0; i < current.size(); i += 3) {
+                unsigned int v0 = current[i];
+                unsigned int v1 = current[i + 1];
+                unsigned int v2 = current[i + 2];
+                unsigned int m01 = icosphereMidpoint(edgeCache, lods.vertices, v0, v1);
+                unsigned int m12 = icosphereMidpoint(edgeCache, lods.vertices, v1, v2);
+                unsigned int m20 = icosphereMidpoint(edgeCache, lods.vertices, v2, v0);
+
+                unsigned int tris[] = {
+                    v0, m01, m20,
+                    v1, m12, m01,
+                    v2, m20, m12,
+                    m01, m12, m20
+                };
+                next.insert(next.end(), tris, tris + 12);
+            }
+            current.swap(next);
+            // Edges of this level are never seen again once it is finished
+            edgeCache.clear();
+        }
+
+        IcosphereLevel info;
+        info.firstIndex = lods.indices.size();
+        info.indexCount = current.size();
+        info.vertexCount = lods.vertices.size() / 3;
+        lods.levels.push_back(info);
+        lods.indices.insert(lods.indices.end(), current.begin(), current.end());
+    }
+
+    if (radius != 1.0f) {
+        for (size_t i = 0; i < lods.vertices.size(); ++i)
+            lods.vertices[i] *= radius;
+    }
+    return lods;
+}
+
+// Picks a level from the sphere's projected size on screen.
+//
+// A level-0 edge spans about 63.4 degrees of arc (1.107 radians), and every
+// level halves it. The wanted level is the one whose edges come out at roughly
+// targetEdgePixels on screen. Refining happens as soon as it is needed, but
+// coarsening waits until the sphere is `hysteresis` levels past the switch
+// point so the level does not flicker when the camera sits on a boundary.
+struct IcosphereLODSelector {
+    unsigned int maxLevel;
+    unsigned int currentLevel;
+    float targetEdgePixels;
+    float hysteresis;
+
+    IcosphereLODSelector(unsigned int maxLevel, float targetEdgePixels = 12.0f, float hysteresis = 0.3f)
+        : maxLevel(maxLevel), currentLevel(0), targetEdgePixels(targetEdgePixels), hysteresis(hysteresis) {}
+
+    // radius and distance in world units, fovY in radians, viewport height in pixels
+    unsigned int select(float radius, float distance, float fovY, float viewportHeight) {
+        if (distance <= radius) {
+            currentLevel = maxLevel;
+            return currentLevel;
+        }
+
+        float projectedRadius = radius / (distance * tanf(fovY * 0.5f)) * (viewportHeight * 0.5f);
+        float level0EdgePixels = projectedRadius * 1.107f;
+        float wantedLevel = log2f(level0EdgePixels / targetEdgePixels);
+
+        int wanted = (int)ceilf(wantedLevel);
+        if (wanted < 0)
+            wanted = 0;
+        if (wanted > (int)maxLevel)
+            wanted = maxLevel;
+
+        if (wanted > (int)currentLevel)
+            currentLevel = wanted;
+        else if (wanted < (int)currentLevel && wantedLevel < (float)currentLevel - 1.0f - hysteresis)
+            currentLevel = wanted;
+        return currentLevel;
+    }
+};
+
+#endif
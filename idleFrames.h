@@ -0,0 +1,78 @@
+#ifndef IDLE_FRAMES_H
+#define IDLE_FRAMES_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <cstddef>
+#include <cstdint>
+
+// Lets a demo stop drawing while nothing on screen would change.
+//
+// Each frame the demo hashes everything its picture depends on (camera,
+// mode flags, anything else its uniforms come from) with hashFrameValue().
+// When the hash matches the last rendered frame, frameNeedsRender() returns
+// false and the demo calls waitForFrameChange() instead of drawing: the last
+// frame stays on screen, nothing is presented, and the thread sleeps in
+// glfwWaitEvents() until there is input. Window refreshes (uncovering,
+// resizing) always force a frame, since the window system may have thrown
+// the old contents away.
+//
+// Only for scenes that do not animate on their own: a demo with time-driven
+// motion changes every frame and never goes idle.
+
+const uint64_t FRAME_HASH_SEED = 14695981039346656037ull;
+
+// FNV-1a over raw bytes; values hashed must not contain padding
+inline uint64_t hashFrameBytes(uint64_t hash, const void* data, size_t bytes) {
+    const unsigned char* p = (const unsigned char*)data;
+    for (size_t i = 0; i < bytes; ++i) {
+        hash ^= p[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+template <typename T>
+inline uint64_t hashFrameValue(uint64_t hash, const T& value) {
+    return hashFrameBytes(hash, &value, sizeof(value));
+}
+
+struct IdleFrames {
+    uint64_t lastHash;
+    bool rendered;   // lastHash is valid
+    int waits;       // times the loop went to sleep
+};
+
+// Set by the window callbacks, one window per process
+inline bool& idleFramesRefreshRequested() {
+    static bool requested = false;
+    return requested;
+}
+
+inline void initIdleFrames(IdleFrames& idle, GLFWwindow* window) {
+    idle = IdleFrames();
+    glfwSetWindowRefreshCallback(window, [](GLFWwindow*) { idleFramesRefreshRequested() = true; });
+    glfwSetFramebufferSizeCallback(window, [](GLFWwindow*, int, int) { idleFramesRefreshRequested() = true; });
+}
+
+// True when the frame with this state hash has to be drawn and presented
+inline bool frameNeedsRender(IdleFrames& idle, uint64_t hash) {
+    bool refresh = idleFramesRefreshRequested();
+    idleFramesRefreshRequested() = false;
+    if (idle.rendered && hash == idle.lastHash && !refresh)
+        return false;
+    idle.lastHash = hash;
+    idle.rendered = true;
+    return true;
+}
+
+// Sleeps until an event arrives. The frame clock (the demo's lastFrame) is
+// restarted one 60 Hz frame back, so the input that woke the loop moves the
+// camera by one frame's worth instead of by the whole time spent asleep.
+inline void waitForFrameChange(IdleFrames& idle, float& lastFrame) {
+    ++idle.waits;
+    glfwWaitEvents();
+    lastFrame = (float)glfwGetTime() - 1.0f / 60.0f;
+}
+
+#endif
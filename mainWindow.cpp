@@ -4,6 +4,8 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #include <vector>
+#include "renderQueue.h"
+#include "glStateCache.h"
 
 
 // While creating the main window I used this website as a basis.
@@ -211,7 +213,7 @@ void setupQuadLogo(GLuint& VAO, GLuint& VBO) {
          0.7f,  -1.0f, 0.0f,  0.0f, 0.0f, // bottom left
          0.7f,  -0.7f, 0.0f,  0.0f, 1.0f  // top left 
     };
-    unsigned int indices[] = {
+    unsigned char indices[] = {
         0, 1, 3, // first triangle
         1, 2, 3  // second triangle
     };
@@ -248,7 +250,7 @@ void setupQuadWelcome(GLuint& VAO, GLuint& VBO) {
          -0.6f,  0.5f, 0.0f,  0.0f, 0.0f, // bottom left
          -0.6f,  1.0f, 0.0f,  0.0f, 1.0f  // top left 
     };
-    unsigned int indices[] = {
+    unsigned char indices[] = {
         0, 1, 3, // first triangle
         1, 2, 3  // second triangle
     };
@@ -285,7 +287,7 @@ void setupQuadInstructions(GLuint& VAO, GLuint& VBO) {
          -0.5f,  -0.3f, 0.0f,  0.0f, 0.0f, // bottom left
          -0.5f,  0.3f, 0.0f,  0.0f, 1.0f  // top left 
     };
-    unsigned int indices[] = {
+    unsigned char indices[] = {
         0, 1, 3, // first triangle
         1, 2, 3  // second triangle
     };
@@ -367,6 +369,8 @@ int main() {
         std::cerr << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    // The pictures and buttons re-bind the same state every frame
+    installGLStateCache();
 
     // Enable blending
     glEnable(GL_BLEND);
@@ -419,46 +423,46 @@ int main() {
     GLuint picVAO, picVBO;
     setupQuadLogo(picVAO, picVBO);
 
-    // Welcome Text Setup
-    GLuint welcomeShaderProgram = setupShaders();
+    // Welcome Text Setup (the pictures all share one program)
     GLuint welcomeTexture;
     setupTexture("images/Ruda_Welcome.png", welcomeTexture);
     GLuint welVAO, welVBO;
     setupQuadWelcome(welVAO, welVBO);
 
     // Instructions Text Setup
-    GLuint instrShaderProgram = setupShaders();
     GLuint instrTexture;
     setupTexture("images/Ruda_Instructions.png", instrTexture);
     GLuint instrVAO, instrVBO;
     setupQuadInstructions(instrVAO, instrVBO);
 
+    RenderQueue renderQueue;
     while (!glfwWindowShouldClose(window)) {
         glClearColor(0.678f, 0.847f, 1.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
 
-        // Draw Picture
-        glUseProgram(pictureShaderProgram);
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glBindVertexArray(picVAO);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-        // Draw Welcome Mesaage
-        glUseProgram(welcomeShaderProgram);
-        glBindTexture(GL_TEXTURE_2D, welcomeTexture);
-        glBindVertexArray(welVAO);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-        // Draw Instructions message
-        glUseProgram(instrShaderProgram);
-        glBindTexture(GL_TEXTURE_2D, instrTexture);
-        glBindVertexArray(instrVAO);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-        // Draw Rectangles and Buttons
-        glUseProgram(shaderProgram);
-        glBindVertexArray(VAO);
-        glDrawArrays(GL_TRIANGLES, 0, numButtons * 6);
+        // Everything goes through the render queue, which orders the draws
+        // (see renderQueue.h). The pictures have alpha and keep the layering
+        // they were drawn with: depth 0.9 is drawn first.
+        clearRenderQueue(renderQueue);
+
+        // Picture
+        submitRenderItem(renderQueue, makeRenderItem(makeRenderKey(0, RENDER_ALPHA_BLEND, pictureShaderProgram, texture, picVAO, 0.9f),
+                                                     pictureShaderProgram, texture, picVAO, RENDER_ALPHA_BLEND,
+                                                     GL_TRIANGLES, 6, GL_UNSIGNED_BYTE));
+        // Welcome Mesaage
+        submitRenderItem(renderQueue, makeRenderItem(makeRenderKey(0, RENDER_ALPHA_BLEND, pictureShaderProgram, welcomeTexture, welVAO, 0.8f),
+                                                     pictureShaderProgram, welcomeTexture, welVAO, RENDER_ALPHA_BLEND,
+                                                     GL_TRIANGLES, 6, GL_UNSIGNED_BYTE));
+        // Instructions message
+        submitRenderItem(renderQueue, makeRenderItem(makeRenderKey(0, RENDER_ALPHA_BLEND, pictureShaderProgram, instrTexture, instrVAO, 0.7f),
+                                                     pictureShaderProgram, instrTexture, instrVAO, RENDER_ALPHA_BLEND,
+                                                     GL_TRIANGLES, 6, GL_UNSIGNED_BYTE));
+        // Rectangles and Buttons, solid colors
+        submitRenderItem(renderQueue, makeRenderItem(makeRenderKey(0, RENDER_OPAQUE, shaderProgram, 0, VAO, 0.0f),
+                                                     shaderProgram, 0, VAO, RENDER_OPAQUE, GL_TRIANGLES, numButtons * 6));
+
+        sortRenderQueue(renderQueue);
+        executeRenderQueue(renderQueue);
 
         glfwSwapBuffers(window);
         glfwPollEvents();
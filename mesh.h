@@ -0,0 +1,420 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <glad/glad.h>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+
+// Small mesh layer shared by the demos and the mesh tools.
+//
+// MeshData is the CPU side (what shapes.h builds and what the exporter writes),
+// GpuMesh is the uploaded VAO/VBO/EBO plus what is needed to draw it.
+
+// One vertex attribute, stored as-is in the .rwm layout section
+struct MeshAttrib {
+    uint32_t location;    // layout (location = N) in the shader
+    uint32_t components;  // 1..4
+    uint32_t type;        // GL_FLOAT, GL_HALF_FLOAT, ...
+    uint32_t normalized;  // GL_TRUE / GL_FALSE
+    uint32_t offset;      // byte offset inside the vertex
+};
+
+// One level of detail, a range of the shared index buffer
+struct MeshLOD {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t vertexCount;  // highest vertex used + 1
+    uint32_t reserved;
+};
+
+// A run of triangles whose indices are relative to baseVertex. Meshes with more
+// vertices than a 16-bit index can address are split into these so they can
+// still use GL_UNSIGNED_SHORT.
+struct MeshBatch {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t baseVertex;
+    uint32_t vertexCount;
+};
+
+// A cluster of at most MESHLET_MAX_VERTICES vertices and
+// MESHLET_MAX_TRIANGLES triangles, stored as a contiguous range of the index
+// buffer, with the bounds used to cull it as a whole (see meshlet.h)
+struct Meshlet {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    int32_t baseVertex;     // of the batch the meshlet lives in, 0 for unsplit meshes
+    uint32_t vertexCount;   // unique vertices referenced
+    float center[3];        // bounding sphere, model space
+    float radius;
+    float coneAxis[3];      // average facing of the triangles
+    float coneCutoff;       // see meshletBackfacing(), 1 when the cone can never cull
+};
+
+// How stored positions and normals turn back into model space. Quantized
+// positions decode as stored * positionScale + positionBias in the vertex
+// shader; uncompressed meshes use scale 1 and bias 0.
+const uint32_t MESH_NORMAL_XYZ = 0;
+const uint32_t MESH_NORMAL_OCTAHEDRAL = 1;
+
+struct MeshDecode {
+    float positionScale[3];
+    float positionBias[3];
+    uint32_t normalEncoding;  // MESH_NORMAL_XYZ or MESH_NORMAL_OCTAHEDRAL
+    uint32_t reserved;
+};
+
+inline MeshDecode identityMeshDecode() {
+    MeshDecode decode = { { 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 0.0f }, MESH_NORMAL_XYZ, 0 };
+    return decode;
+}
+
+struct MeshBounds {
+    float min[3];
+    float max[3];
+    float center[3];
+    float radius;
+};
+
+struct MeshData {
+    std::vector<float> vertices;        // interleaved, stride / sizeof(float) floats per vertex
+    std::vector<unsigned int> indices;  // empty for a plain triangle list
+    std::vector<MeshAttrib> layout;
+    unsigned int stride;                // bytes per vertex
+    std::vector<MeshLOD> lods;          // empty when the mesh has a single level
+    std::vector<MeshBatch> batches;     // empty when indices address the whole vertex buffer
+    std::vector<Meshlet> meshlets;      // built by buildMeshlets, in index buffer order
+
+    // Set by compressVertices. The float positions are gone after that, so
+    // the bounds are worked out before packing and kept here.
+    bool quantized = false;
+    MeshDecode decode = identityMeshDecode();
+    MeshBounds bounds = {};
+};
+
+struct GpuMesh {
+    GLuint VAO, VBO, EBO;
+    GLsizei vertexCount;
+    GLsizei vertexStride;  // bytes, after any packing
+    GLsizei indexCount;
+    GLenum indexType;      // 0 when the mesh is drawn with glDrawArrays
+    std::vector<MeshLOD> lods;
+    std::vector<MeshBatch> batches;
+    std::vector<Meshlet> meshlets;
+    MeshBounds bounds;
+    MeshDecode decode;
+};
+
+inline unsigned int meshIndexSize(GLenum indexType) {
+    switch (indexType) {
+        case GL_UNSIGNED_BYTE:  return 1;
+        case GL_UNSIGNED_SHORT: return 2;
+        case GL_UNSIGNED_INT:   return 4;
+        default:                return 0;
+    }
+}
+
+// Largest vertex count one batch may reference with 16-bit indices. 0xFFFF
+// is kept free so primitive restart can be turned on later.
+const size_t MESH_MAX_SHORT_BATCH_VERTICES = 65535;
+
+// Smallest index type that can address vertexCount vertices, leaving the
+// type's largest value free for primitive restart
+inline GLenum narrowestIndexType(size_t vertexCount) {
+    if (vertexCount <= 255)
+        return GL_UNSIGNED_BYTE;
+    if (vertexCount <= MESH_MAX_SHORT_BATCH_VERTICES)
+        return GL_UNSIGNED_SHORT;
+    return GL_UNSIGNED_INT;
+}
+
+inline const char* indexTypeName(GLenum indexType) {
+    switch (indexType) {
+        case GL_UNSIGNED_BYTE:  return "GL_UNSIGNED_BYTE";
+        case GL_UNSIGNED_SHORT: return "GL_UNSIGNED_SHORT";
+        case GL_UNSIGNED_INT:   return "GL_UNSIGNED_INT";
+        default:                return "none";
+    }
+}
+
+// Copies 32-bit indices into a buffer of the given (narrower) type
+inline std::vector<unsigned char> packIndices(const std::vector<unsigned int>& indices, GLenum indexType) {
+    std::vector<unsigned char> bytes(indices.size() * meshIndexSize(indexType));
+    if (indexType == GL_UNSIGNED_BYTE) {
+        for (size_t i = 0; i < indices.size(); ++i)
+            bytes[i] = (unsigned char)indices[i];
+    } else if (indexType == GL_UNSIGNED_SHORT) {
+        uint16_t* out = (uint16_t*)bytes.data();
+        for (size_t i = 0; i < indices.size(); ++i)
+            out[i] = (uint16_t)indices[i];
+    } else if (!indices.empty()) {
+        memcpy(bytes.data(), indices.data(), bytes.size());
+    }
+    return bytes;
+}
+
+inline size_t meshVertexCount(const MeshData& mesh) {
+    return mesh.vertices.size() * sizeof(float) / mesh.stride;
+}
+
+// Vertices one draw of this mesh can reference, which is what decides the
+// index type: the largest batch, or the whole buffer when it is not split.
+inline size_t meshMaxDrawVertices(const MeshData& mesh) {
+    if (mesh.batches.empty())
+        return meshVertexCount(mesh);
+    size_t largest = 0;
+    for (size_t i = 0; i < mesh.batches.size(); ++i)
+        if (mesh.batches[i].vertexCount > largest)
+            largest = mesh.batches[i].vertexCount;
+    return largest;
+}
+
+// LOD ranges index the shared vertex buffer directly, so meshes with a LOD
+// table are never split and fall back to 32-bit indices when they are huge.
+inline bool meshNeedsIndexSplit(const MeshData& mesh) {
+    return !mesh.indices.empty() && mesh.batches.empty() && mesh.lods.empty()
+        && meshVertexCount(mesh) > MESH_MAX_SHORT_BATCH_VERTICES;
+}
+
+// Splits a large indexed mesh into batches of at most
+// MESH_MAX_SHORT_BATCH_VERTICES vertices. Triangles are walked in order and a
+// new batch starts when the next triangle would overflow the current one.
+// Vertices used by several batches are duplicated, each batch gets its own
+// contiguous vertex range and indices relative to it.
+inline MeshData splitMeshIntoShortBatches(const MeshData& mesh) {
+    const size_t strideFloats = mesh.stride / sizeof(float);
+    const size_t vertexCount = meshVertexCount(mesh);
+
+    MeshData split;
+    split.layout = mesh.layout;
+    split.stride = mesh.stride;
+    split.quantized = mesh.quantized;
+    split.decode = mesh.decode;
+    split.bounds = mesh.bounds;
+    split.vertices.reserve(mesh.vertices.size() + mesh.vertices.size() / 16);
+    split.indices.reserve(mesh.indices.size());
+
+    // remap[v] is v's index inside the current batch, valid when stamp[v] == batch number
+    std::vector<uint32_t> remap(vertexCount);
+    std::vector<uint32_t> stamp(vertexCount, 0);
+    uint32_t batchNumber = 1;
+
+    MeshBatch batch = { 0, 0, 0, 0 };
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        unsigned int newVertices = 0;
+        for (int k = 0; k < 3; ++k) {
+            unsigned int v = mesh.indices[i + k];
+            if (stamp[v] != batchNumber && (k < 1 || v != mesh.indices[i]) && (k < 2 || v != mesh.indices[i + 1]))
+                ++newVertices;
+        }
+        if (batch.vertexCount + newVertices > MESH_MAX_SHORT_BATCH_VERTICES) {
+            split.batches.push_back(batch);
+            batch.firstIndex = split.indices.size();
+            batch.indexCount = 0;
+            batch.baseVertex = split.vertices.size() / strideFloats;
+            batch.vertexCount = 0;
+            ++batchNumber;
+        }
+        for (int k = 0; k < 3; ++k) {
+            unsigned int v = mesh.indices[i + k];
+            if (stamp[v] != batchNumber) {
+                stamp[v] = batchNumber;
+                remap[v] = batch.vertexCount++;
+                split.vertices.insert(split.vertices.end(), mesh.vertices.begin() + v * strideFloats,
+                                      mesh.vertices.begin() + (v + 1) * strideFloats);
+            }
+            split.indices.push_back(remap[v]);
+        }
+        batch.indexCount += 3;
+    }
+    if (batch.indexCount)
+        split.batches.push_back(batch);
+    return split;
+}
+
+// One line per mesh: which index type it got and how much index data each
+// draw reads compared to the 32-bit indices the demos used before.
+inline void reportIndexSavings(const char* name, size_t indexCount, GLenum indexType, size_t batchCount = 0) {
+    if (indexCount == 0)
+        return;
+    size_t before = indexCount * sizeof(unsigned int);
+    size_t after = indexCount * meshIndexSize(indexType);
+    std::cout << name << ": " << indexCount << " indices as " << indexTypeName(indexType);
+    if (batchCount > 1)
+        std::cout << " in " << batchCount << " batches";
+    std::cout << ", " << after << " bytes instead of " << before
+              << " (" << (before - after) * 100 / before << "% less index bandwidth)" << std::endl;
+}
+
+// Assumes the position is three floats at the start of each vertex, which is
+// true for every shape in this repo.
+inline MeshBounds computeMeshBounds(const float* vertices, size_t vertexCount, unsigned int strideFloats) {
+    MeshBounds bounds = {};
+    if (vertexCount == 0)
+        return bounds;
+
+    for (int k = 0; k < 3; ++k) {
+        bounds.min[k] = vertices[k];
+        bounds.max[k] = vertices[k];
+    }
+    for (size_t i = 1; i < vertexCount; ++i) {
+        const float* p = vertices + i * strideFloats;
+        for (int k = 0; k < 3; ++k) {
+            if (p[k] < bounds.min[k]) bounds.min[k] = p[k];
+            if (p[k] > bounds.max[k]) bounds.max[k] = p[k];
+        }
+    }
+    for (int k = 0; k < 3; ++k)
+        bounds.center[k] = 0.5f * (bounds.min[k] + bounds.max[k]);
+
+    float radiusSq = 0.0f;
+    for (size_t i = 0; i < vertexCount; ++i) {
+        const float* p = vertices + i * strideFloats;
+        float dx = p[0] - bounds.center[0];
+        float dy = p[1] - bounds.center[1];
+        float dz = p[2] - bounds.center[2];
+        float d = dx * dx + dy * dy + dz * dz;
+        if (d > radiusSq)
+            radiusSq = d;
+    }
+    bounds.radius = sqrtf(radiusSq);
+    return bounds;
+}
+
+inline MeshBounds meshBounds(const MeshData& mesh) {
+    if (mesh.quantized)
+        return mesh.bounds;
+    return computeMeshBounds(mesh.vertices.data(), meshVertexCount(mesh), mesh.stride / sizeof(float));
+}
+
+// Expects the VAO and GL_ARRAY_BUFFER to be bound
+inline void setupMeshAttribs(const MeshAttrib* layout, size_t attribCount, unsigned int stride) {
+    for (size_t i = 0; i < attribCount; ++i) {
+        const MeshAttrib& a = layout[i];
+        glVertexAttribPointer(a.location, a.components, a.type, a.normalized ? GL_TRUE : GL_FALSE, stride, (void*)(uintptr_t)a.offset);
+        glEnableVertexAttribArray(a.location);
+    }
+}
+
+// Creates the VAO/VBO/EBO for already laid out vertex and index data. Pass
+// indexData = NULL for a non-indexed triangle list.
+inline GpuMesh uploadMesh(const void* vertexData, size_t vertexBytes, unsigned int stride,
+                          const MeshAttrib* layout, size_t attribCount,
+                          const void* indexData, size_t indexCount, GLenum indexType,
+                          const MeshBounds& bounds, const MeshLOD* lods = NULL, size_t lodCount = 0,
+                          const MeshBatch* batches = NULL, size_t batchCount = 0) {
+    GpuMesh mesh = {};
+    mesh.vertexCount = vertexBytes / stride;
+    mesh.vertexStride = stride;
+    mesh.indexCount = indexData ? indexCount : 0;
+    mesh.indexType = indexData ? indexType : 0;
+    mesh.bounds = bounds;
+    mesh.decode = identityMeshDecode();
+    if (lods)
+        mesh.lods.assign(lods, lods + lodCount);
+    if (batches)
+        mesh.batches.assign(batches, batches + batchCount);
+
+    glGenVertexArrays(1, &mesh.VAO);
+    glGenBuffers(1, &mesh.VBO);
+    glBindVertexArray(mesh.VAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertexData, GL_STATIC_DRAW);
+
+    if (indexData) {
+        glGenBuffers(1, &mesh.EBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * meshIndexSize(indexType), indexData, GL_STATIC_DRAW);
+    }
+
+    setupMeshAttribs(layout, attribCount, stride);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return mesh;
+}
+
+// Uploads with the narrowest index type that fits, splitting meshes with more
+// than 65,535 vertices into 16-bit batches first. Pass a name to have the
+// index savings printed.
+inline GpuMesh uploadMesh(const MeshData& data, const char* name = NULL) {
+    if (meshNeedsIndexSplit(data))
+        return uploadMesh(splitMeshIntoShortBatches(data), name);
+
+    MeshBounds bounds = meshBounds(data);
+    GLenum indexType = narrowestIndexType(meshMaxDrawVertices(data));
+    std::vector<unsigned char> indexBytes = packIndices(data.indices, indexType);
+    if (name)
+        reportIndexSavings(name, data.indices.size(), indexType, data.batches.size());
+
+    GpuMesh mesh = uploadMesh(data.vertices.data(), meshVertexCount(data) * data.stride, data.stride,
+                              data.layout.data(), data.layout.size(),
+                              data.indices.empty() ? NULL : indexBytes.data(), data.indices.size(), indexType,
+                              bounds, data.lods.data(), data.lods.size(), data.batches.data(), data.batches.size());
+    mesh.decode = data.decode;
+    mesh.meshlets = data.meshlets;
+    return mesh;
+}
+
+// Sets the decode uniforms the demo vertex shaders use. Locations that the
+// program does not have are -1 and silently ignored by GL.
+inline void setMeshDecodeUniforms(GLuint program, const GpuMesh& mesh) {
+    glUniform3fv(glGetUniformLocation(program, "positionScale"), 1, mesh.decode.positionScale);
+    glUniform3fv(glGetUniformLocation(program, "positionBias"), 1, mesh.decode.positionBias);
+    glUniform1i(glGetUniformLocation(program, "octahedralNormals"), mesh.decode.normalEncoding == MESH_NORMAL_OCTAHEDRAL);
+}
+
+// Draws the whole mesh, or one LOD when the mesh has a LOD table. With
+// instanceCount > 1 the same geometry is drawn that many times and the vertex
+// shader tells the copies apart by gl_InstanceID.
+inline void drawMesh(const GpuMesh& mesh, GLenum mode = GL_TRIANGLES, GLsizei instanceCount = 1) {
+    glBindVertexArray(mesh.VAO);
+    if (!mesh.batches.empty()) {
+        unsigned int indexSize = meshIndexSize(mesh.indexType);
+        for (size_t i = 0; i < mesh.batches.size(); ++i) {
+            const MeshBatch& b = mesh.batches[i];
+            void* offset = (void*)(uintptr_t)(b.firstIndex * indexSize);
+            if (instanceCount == 1)
+                glDrawRangeElementsBaseVertex(mode, 0, b.vertexCount - 1, b.indexCount, mesh.indexType, offset, b.baseVertex);
+            else
+                glDrawElementsInstancedBaseVertex(mode, b.indexCount, mesh.indexType, offset, instanceCount, b.baseVertex);
+        }
+    } else if (mesh.indexType)
+        glDrawElementsInstanced(mode, mesh.indexCount, mesh.indexType, 0, instanceCount);
+    else
+        glDrawArraysInstanced(mode, 0, mesh.vertexCount, instanceCount);
+}
+
+inline void drawMeshLOD(const GpuMesh& mesh, unsigned int level, GLenum mode = GL_TRIANGLES, GLsizei instanceCount = 1) {
+    if (mesh.lods.empty() || !mesh.indexType) {
+        drawMesh(mesh, mode, instanceCount);
+        return;
+    }
+    const MeshLOD& lod = mesh.lods[level < mesh.lods.size() ? level : mesh.lods.size() - 1];
+    void* offset = (void*)(uintptr_t)(lod.firstIndex * meshIndexSize(mesh.indexType));
+    glBindVertexArray(mesh.VAO);
+    if (instanceCount == 1)
+        glDrawRangeElements(mode, 0, lod.vertexCount - 1, lod.indexCount, mesh.indexType, offset);
+    else
+        glDrawElementsInstanced(mode, lod.indexCount, mesh.indexType, offset, instanceCount);
+}
+
+// GPU memory held by the vertex and index buffers
+inline size_t meshGeometryBytes(const GpuMesh& mesh) {
+    return (size_t)mesh.vertexCount * mesh.vertexStride + (size_t)mesh.indexCount * meshIndexSize(mesh.indexType);
+}
+
+inline void destroyMesh(GpuMesh& mesh) {
+    glDeleteVertexArrays(1, &mesh.VAO);
+    glDeleteBuffers(1, &mesh.VBO);
+    if (mesh.EBO)
+        glDeleteBuffers(1, &mesh.EBO);
+    mesh.VAO = mesh.VBO = mesh.EBO = 0;
+}
+
+#endif
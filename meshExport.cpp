@@ -0,0 +1,41 @@
+#include <glad/glad.h>
+#include <iostream>
+#include <string>
+#include <sys/stat.h>
+#include "shapes.h"
+#include "meshFile.h"
+
+// Writes the built-in demo shapes to meshes/*.rwm so the demos can mmap them
+// instead of building them at startup. Meshes go through prepareMesh (weld,
+// vertex cache/overdraw/fetch passes, meshlets, packed vertex format) on the
+// way out.
+//
+// Usage: ./meshExport [output directory]
+
+bool exportMesh(const std::string& dir, const char* name, MeshData mesh) {
+    std::string path = dir + "/" + name + ".rwm";
+    prepareMesh(mesh, path.c_str());
+    if (!writeMeshFile(path.c_str(), mesh))
+        return false;
+
+    struct stat st;
+    stat(path.c_str(), &st);
+    std::cout << path << ": " << meshVertexCount(mesh) << " vertices, "
+              << mesh.indices.size() << " indices, " << mesh.lods.size() << " LODs, "
+              << st.st_size << " bytes" << std::endl;
+    reportIndexSavings(path.c_str(), mesh.indices.size(), narrowestIndexType(meshMaxDrawVertices(mesh)));
+    return true;
+}
+
+int main(int argc, char** argv) {
+    std::string dir = argc > 1 ? argv[1] : "meshes";
+    mkdir(dir.c_str(), 0755);
+
+    bool ok = true;
+    ok = exportMesh(dir, "cube", createCubeMesh()) && ok;
+    ok = exportMesh(dir, "triPyramid", createTriPyramidMesh()) && ok;
+    ok = exportMesh(dir, "diamond", createDiamondMesh()) && ok;
+    ok = exportMesh(dir, "sphere", createSphereMesh(1.0f, 36, 18)) && ok;
+    ok = exportMesh(dir, "icosphere", createIcosphereMesh(1.0f, 5)) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,418 @@
+#ifndef MESH_FILE_H
+#define MESH_FILE_H
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "mesh.h"
+#include "meshOptimize.h"
+#include "meshWeld.h"
+#include "vertexCompress.h"
+#include "meshlet.h"
+
+// .rwm binary mesh container
+//
+// The file is laid out so that it can be used straight from an mmap:
+//
+//   MeshFileHeader           64 bytes
+//   MeshFileSection[n]       directory, 32 bytes per section
+//   section payloads         each one starts on a MESH_FILE_ALIGNMENT boundary
+//
+// Sections hold raw GPU-ready data (the vertex section is exactly what goes
+// into the VBO, the index section exactly what goes into the EBO), so loading
+// is mmap, validate offsets, glBufferData from the mapping. All values are
+// little endian; the loader refuses files from a newer version.
+
+const uint32_t MESH_FILE_MAGIC = 0x4D575252; // "RRWM"
+const uint32_t MESH_FILE_VERSION = 4;     // 2: narrow index types and the batch table, 3: packed vertices, 4: meshlets
+const uint32_t MESH_FILE_ALIGNMENT = 64;
+
+enum MeshFileSectionType {
+    MESH_SECTION_LAYOUT   = 1,  // MeshAttrib[]
+    MESH_SECTION_VERTICES = 2,  // vertexCount * vertexStride bytes
+    MESH_SECTION_INDICES  = 3,  // indexCount * index size bytes
+    MESH_SECTION_BOUNDS   = 4,  // MeshBounds
+    MESH_SECTION_LODS     = 5,  // MeshLOD[]
+    MESH_SECTION_BATCHES  = 6,  // MeshBatch[]
+    MESH_SECTION_DECODE   = 7,  // MeshDecode, only for packed vertex formats
+    MESH_SECTION_MESHLETS = 8   // Meshlet[]
+};
+
+struct MeshFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t sectionCount;
+    uint32_t vertexStride;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t indexType;     // GL_UNSIGNED_BYTE/SHORT/INT, 0 for a non-indexed mesh
+    uint32_t reserved[9];
+};
+
+struct MeshFileSection {
+    uint32_t type;
+    uint32_t count;         // number of elements (attribs, LODs, ...)
+    uint64_t offset;        // from the start of the file
+    uint64_t size;          // in bytes
+    uint64_t reserved;
+};
+
+static_assert(sizeof(MeshFileHeader) == 64, "MeshFileHeader must stay 64 bytes");
+static_assert(sizeof(MeshFileSection) == 32, "MeshFileSection must stay 32 bytes");
+static_assert(sizeof(MeshAttrib) == 20, "MeshAttrib layout is part of the file format");
+static_assert(sizeof(MeshLOD) == 16, "MeshLOD layout is part of the file format");
+static_assert(sizeof(MeshBatch) == 16, "MeshBatch layout is part of the file format");
+static_assert(sizeof(MeshBounds) == 40, "MeshBounds layout is part of the file format");
+static_assert(sizeof(MeshDecode) == 32, "MeshDecode layout is part of the file format");
+static_assert(sizeof(Meshlet) == 48, "Meshlet layout is part of the file format");
+
+// A mapped .rwm file. The pointers point into the mapping and are only valid
+// until closeMeshFile().
+struct MeshFile {
+    void* mapping;
+    size_t mappingSize;
+    const MeshFileHeader* header;
+    const MeshAttrib* layout;
+    uint32_t attribCount;
+    const void* vertices;
+    size_t vertexBytes;
+    const void* indices;
+    size_t indexBytes;
+    const MeshBounds* bounds;
+    const MeshLOD* lods;
+    uint32_t lodCount;
+    const MeshBatch* batches;
+    uint32_t batchCount;
+    const MeshDecode* decode;   // NULL for float vertices
+    const Meshlet* meshlets;
+    uint32_t meshletCount;
+};
+
+inline size_t alignMeshFileOffset(size_t offset) {
+    return (offset + MESH_FILE_ALIGNMENT - 1) & ~(size_t)(MESH_FILE_ALIGNMENT - 1);
+}
+
+// Writes a mesh whose vertex and index data are already in their final GPU
+// layout. Returns false and prints why if the file could not be written.
+inline bool writeMeshFile(const char* path, const MeshAttrib* layout, uint32_t attribCount, uint32_t vertexStride,
+                          const void* vertices, uint32_t vertexCount,
+                          const void* indices, uint32_t indexCount, uint32_t indexType,
+                          const MeshBounds& bounds, const MeshLOD* lods, uint32_t lodCount,
+                          const MeshBatch* batches = NULL, uint32_t batchCount = 0,
+                          const MeshDecode* decode = NULL, const Meshlet* meshlets = NULL, uint32_t meshletCount = 0) {
+    struct Payload { uint32_t type; uint32_t count; const void* data; size_t size; };
+    std::vector<Payload> payloads;
+    Payload layoutPayload = { MESH_SECTION_LAYOUT, attribCount, layout, attribCount * sizeof(MeshAttrib) };
+    Payload vertexPayload = { MESH_SECTION_VERTICES, vertexCount, vertices, (size_t)vertexCount * vertexStride };
+    Payload boundsPayload = { MESH_SECTION_BOUNDS, 1, &bounds, sizeof(MeshBounds) };
+    payloads.push_back(layoutPayload);
+    payloads.push_back(vertexPayload);
+    if (indices && indexCount) {
+        Payload indexPayload = { MESH_SECTION_INDICES, indexCount, indices, (size_t)indexCount * meshIndexSize(indexType) };
+        payloads.push_back(indexPayload);
+    }
+    payloads.push_back(boundsPayload);
+    if (lods && lodCount) {
+        Payload lodPayload = { MESH_SECTION_LODS, lodCount, lods, lodCount * sizeof(MeshLOD) };
+        payloads.push_back(lodPayload);
+    }
+    if (batches && batchCount) {
+        Payload batchPayload = { MESH_SECTION_BATCHES, batchCount, batches, batchCount * sizeof(MeshBatch) };
+        payloads.push_back(batchPayload);
+    }
+    if (decode) {
+        Payload decodePayload = { MESH_SECTION_DECODE, 1, decode, sizeof(MeshDecode) };
+        payloads.push_back(decodePayload);
+    }
+    if (meshlets && meshletCount) {
+        Payload meshletPayload = { MESH_SECTION_MESHLETS, meshletCount, meshlets, meshletCount * sizeof(Meshlet) };
+        payloads.push_back(meshletPayload);
+    }
+
+    MeshFileHeader header = {};
+    header.magic = MESH_FILE_MAGIC;
+    header.version = MESH_FILE_VERSION;
+    header.sectionCount = payloads.size();
+    header.vertexStride = vertexStride;
+    header.vertexCount = vertexCount;
+    header.indexCount = (indices && indexCount) ? indexCount : 0;
+    header.indexType = (indices && indexCount) ? indexType : 0;
+
+    std::vector<MeshFileSection> sections(payloads.size());
+    size_t offset = alignMeshFileOffset(sizeof(MeshFileHeader) + sections.size() * sizeof(MeshFileSection));
+    for (size_t i = 0; i < payloads.size(); ++i) {
+        MeshFileSection section = {};
+        section.type = payloads[i].type;
+        section.count = payloads[i].count;
+        section.offset = offset;
+        section.size = payloads[i].size;
+        sections[i] = section;
+        offset = alignMeshFileOffset(offset + payloads[i].size);
+    }
+
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        std::cerr << "ERROR::MESHFILE::CANNOT_OPEN_FOR_WRITING " << path << std::endl;
+        return false;
+    }
+
+    static const char padding[MESH_FILE_ALIGNMENT] = {};
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && fwrite(sections.data(), sizeof(MeshFileSection), sections.size(), file) == sections.size();
+    size_t written = sizeof(header) + sections.size() * sizeof(MeshFileSection);
+    for (size_t i = 0; ok && i < payloads.size(); ++i) {
+        size_t pad = sections[i].offset - written;
+        ok = fwrite(padding, 1, pad, file) == pad;
+        ok = ok && fwrite(payloads[i].data, 1, payloads[i].size, file) == payloads[i].size;
+        written = sections[i].offset + payloads[i].size;
+    }
+    // Pad the tail too so the file size is a multiple of the alignment
+    size_t tail = alignMeshFileOffset(written) - written;
+    ok = ok && fwrite(padding, 1, tail, file) == tail;
+
+    if (fclose(file) != 0 || !ok) {
+        std::cerr << "ERROR::MESHFILE::WRITE_FAILED " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Stores the indices in the narrowest type that fits, splitting the mesh into
+// 16-bit batches first when it has too many vertices, exactly like uploadMesh.
+inline bool writeMeshFile(const char* path, const MeshData& mesh) {
+    if (meshNeedsIndexSplit(mesh))
+        return writeMeshFile(path, splitMeshIntoShortBatches(mesh));
+
+    uint32_t vertexCount = meshVertexCount(mesh);
+    MeshBounds bounds = meshBounds(mesh);
+    GLenum indexType = narrowestIndexType(meshMaxDrawVertices(mesh));
+    std::vector<unsigned char> indexBytes = packIndices(mesh.indices, indexType);
+    return writeMeshFile(path, mesh.layout.data(), mesh.layout.size(), mesh.stride,
+                         mesh.vertices.data(), vertexCount,
+                         mesh.indices.empty() ? NULL : indexBytes.data(), mesh.indices.size(), indexType,
+                         bounds, mesh.lods.data(), mesh.lods.size(), mesh.batches.data(), mesh.batches.size(),
+                         mesh.quantized ? &mesh.decode : NULL, mesh.meshlets.data(), mesh.meshlets.size());
+}
+
+// Largest of count indices of a packed index buffer, starting at first
+inline uint32_t maxPackedIndex(const void* indices, GLenum indexType, size_t first, size_t count) {
+    uint32_t largest = 0;
+    for (size_t i = first; i < first + count; ++i) {
+        uint32_t index = indexType == GL_UNSIGNED_BYTE ? ((const uint8_t*)indices)[i]
+                       : indexType == GL_UNSIGNED_SHORT ? ((const uint16_t*)indices)[i] : ((const uint32_t*)indices)[i];
+        largest = index > largest ? index : largest;
+    }
+    return largest;
+}
+
+// Checks that every LOD, batch and meshlet range lies inside the index (or,
+// without indices, vertex) array and that no index reaches past the
+// vertices, so a corrupt file cannot make a draw read out of bounds
+inline bool meshFileRangesValid(const MeshFile& file) {
+    const MeshFileHeader& h = *file.header;
+    uint64_t elements = h.indexType ? h.indexCount : h.vertexCount;
+    for (uint32_t i = 0; i < file.lodCount; ++i) {
+        const MeshLOD& lod = file.lods[i];
+        if ((uint64_t)lod.firstIndex + lod.indexCount > elements || lod.vertexCount > h.vertexCount)
+            return false;
+    }
+    for (uint32_t i = 0; i < file.batchCount; ++i) {
+        const MeshBatch& batch = file.batches[i];
+        if ((uint64_t)batch.firstIndex + batch.indexCount > elements
+            || (uint64_t)batch.baseVertex + batch.vertexCount > h.vertexCount)
+            return false;
+        if (h.indexType && batch.indexCount
+            && (uint64_t)batch.baseVertex + maxPackedIndex(file.indices, h.indexType, batch.firstIndex, batch.indexCount) >= h.vertexCount)
+            return false;
+    }
+    for (uint32_t i = 0; i < file.meshletCount; ++i) {
+        const Meshlet& meshlet = file.meshlets[i];
+        if ((uint64_t)meshlet.firstIndex + meshlet.indexCount > elements || meshlet.baseVertex < 0
+            || (uint32_t)meshlet.baseVertex > h.vertexCount)
+            return false;
+        if (h.indexType && meshlet.indexCount
+            && (uint64_t)meshlet.baseVertex + maxPackedIndex(file.indices, h.indexType, meshlet.firstIndex, meshlet.indexCount) >= h.vertexCount)
+            return false;
+    }
+    // Batched indices were checked against their batches above
+    if (h.indexType && !file.batchCount && h.indexCount
+        && maxPackedIndex(file.indices, h.indexType, 0, h.indexCount) >= h.vertexCount)
+        return false;
+    return true;
+}
+
+inline void closeMeshFile(MeshFile& file) {
+    if (file.mapping)
+        munmap(file.mapping, file.mappingSize);
+    memset(&file, 0, sizeof(file));
+}
+
+// Maps a .rwm file read-only and fills in pointers to its sections. Nothing is
+// copied; the section directory, the draw ranges and the indices are
+// bounds-checked.
+inline bool openMeshFile(const char* path, MeshFile& file) {
+    memset(&file, 0, sizeof(file));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(MeshFileHeader)) {
+        std::cerr << "ERROR::MESHFILE::TRUNCATED " << path << std::endl;
+        close(fd);
+        return false;
+    }
+
+    file.mappingSize = st.st_size;
+    file.mapping = mmap(NULL, file.mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (file.mapping == MAP_FAILED) {
+        file.mapping = NULL;
+        std::cerr << "ERROR::MESHFILE::MMAP_FAILED " << path << std::endl;
+        return false;
+    }
+    // Everything is read front to back exactly once, during the upload
+    madvise(file.mapping, file.mappingSize, MADV_SEQUENTIAL);
+
+    const unsigned char* base = (const unsigned char*)file.mapping;
+    file.header = (const MeshFileHeader*)base;
+    // Older versions only lack the batch table, decode or meshlet sections,
+    // everything else reads the same
+    if (file.header->magic != MESH_FILE_MAGIC || file.header->version < 1 || file.header->version > MESH_FILE_VERSION) {
+        std::cerr << "ERROR::MESHFILE::BAD_MAGIC_OR_VERSION " << path << std::endl;
+        closeMeshFile(file);
+        return false;
+    }
+
+    size_t directoryEnd = sizeof(MeshFileHeader) + (size_t)file.header->sectionCount * sizeof(MeshFileSection);
+    if (directoryEnd > file.mappingSize) {
+        std::cerr << "ERROR::MESHFILE::TRUNCATED " << path << std::endl;
+        closeMeshFile(file);
+        return false;
+    }
+
+    const MeshFileSection* sections = (const MeshFileSection*)(base + sizeof(MeshFileHeader));
+    for (uint32_t i = 0; i < file.header->sectionCount; ++i) {
+        const MeshFileSection& s = sections[i];
+        if (s.offset % MESH_FILE_ALIGNMENT != 0 || s.offset > file.mappingSize || s.size > file.mappingSize - s.offset) {
+            std::cerr << "ERROR::MESHFILE::BAD_SECTION " << path << std::endl;
+            closeMeshFile(file);
+            return false;
+        }
+        const void* data = base + s.offset;
+        switch (s.type) {
+            case MESH_SECTION_LAYOUT:
+                file.layout = (const MeshAttrib*)data;
+                file.attribCount = s.size / sizeof(MeshAttrib);
+                break;
+            case MESH_SECTION_VERTICES:
+                file.vertices = data;
+                file.vertexBytes = s.size;
+                break;
+            case MESH_SECTION_INDICES:
+                file.indices = data;
+                file.indexBytes = s.size;
+                break;
+            case MESH_SECTION_BOUNDS:
+                if (s.size >= sizeof(MeshBounds))
+                    file.bounds = (const MeshBounds*)data;
+                break;
+            case MESH_SECTION_LODS:
+                file.lods = (const MeshLOD*)data;
+                file.lodCount = s.size / sizeof(MeshLOD);
+                break;
+            case MESH_SECTION_BATCHES:
+                file.batches = (const MeshBatch*)data;
+                file.batchCount = s.size / sizeof(MeshBatch);
+                break;
+            case MESH_SECTION_DECODE:
+                if (s.size >= sizeof(MeshDecode))
+                    file.decode = (const MeshDecode*)data;
+                break;
+            case MESH_SECTION_MESHLETS:
+                file.meshlets = (const Meshlet*)data;
+                file.meshletCount = s.size / sizeof(Meshlet);
+                break;
+            default:
+                // Unknown sections are skipped so newer writers stay readable
+                break;
+        }
+    }
+
+    const MeshFileHeader& h = *file.header;
+    bool consistent = file.layout && file.vertices && h.vertexStride
+        && file.vertexBytes == (size_t)h.vertexCount * h.vertexStride
+        && (h.indexType == 0 || (file.indices && meshIndexSize(h.indexType)
+                                 && file.indexBytes == (size_t)h.indexCount * meshIndexSize(h.indexType)));
+    if (!consistent) {
+        std::cerr << "ERROR::MESHFILE::INCONSISTENT_HEADER " << path << std::endl;
+        closeMeshFile(file);
+        return false;
+    }
+    if (!meshFileRangesValid(file)) {
+        std::cerr << "ERROR::MESHFILE::RANGE_OUT_OF_BOUNDS " << path << std::endl;
+        closeMeshFile(file);
+        return false;
+    }
+    return true;
+}
+
+// mmap + glBufferData straight from the mapping. The mapping is released as
+// soon as GL has its copy.
+inline bool loadMeshFile(const char* path, GpuMesh& mesh) {
+    MeshFile file;
+    if (!openMeshFile(path, file))
+        return false;
+
+    MeshBounds bounds = {};
+    if (file.bounds)
+        bounds = *file.bounds;
+    mesh = uploadMesh(file.vertices, file.vertexBytes, file.header->vertexStride,
+                      file.layout, file.attribCount,
+                      file.header->indexType ? file.indices : NULL, file.header->indexCount, file.header->indexType,
+                      bounds, file.lods, file.lodCount, file.batches, file.batchCount);
+    if (file.decode)
+        mesh.decode = *file.decode;
+    if (file.meshlets)
+        mesh.meshlets.assign(file.meshlets, file.meshlets + file.meshletCount);
+
+    closeMeshFile(file);
+    return true;
+}
+
+// Everything a built-in or imported mesh goes through before upload: weld,
+// reorder, split into 16-bit batches when too big, cluster into meshlets and
+// pack the vertices. meshExport runs the same steps before writing a file.
+inline void prepareMesh(MeshData& mesh, const char* name = NULL, const VertexFormat& format = defaultVertexFormat()) {
+    weldMesh(mesh, name);
+    optimizeMesh(mesh, name);
+    if (meshNeedsIndexSplit(mesh))
+        mesh = splitMeshIntoShortBatches(mesh);
+    buildMeshlets(mesh, name);
+    compressVertices(mesh, format, name);
+}
+
+// Loads `path` if it exists and is valid, otherwise builds the fallback with
+// buildFallback() (returning MeshData), prepares and uploads it. The fallback
+// is only built when it is needed. Exported files went through the same
+// steps in meshExport.
+template <typename BuildFn>
+inline GpuMesh loadMeshOr(const char* path, BuildFn buildFallback, const VertexFormat& format = defaultVertexFormat()) {
+    GpuMesh mesh;
+    if (loadMeshFile(path, mesh)) {
+        std::cout << "Loaded " << path << " (" << indexTypeName(mesh.indexType) << " indices)" << std::endl;
+        return mesh;
+    }
+    MeshData fallback = buildFallback();
+    prepareMesh(fallback, path, format);
+    return uploadMesh(fallback, path);
+}
+
+#endif
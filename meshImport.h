@@ -0,0 +1,753 @@
+#ifndef MESH_IMPORT_H
+#define MESH_IMPORT_H
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "mesh.h"
+#include "meshWeld.h"
+
+// Wavefront OBJ and binary PLY importer for large models.
+//
+// The file is mmapped and parsed in parallel:
+//   OBJ  the text is cut into one chunk per thread, each boundary moved
+//        forward to the next newline. Every chunk parses its own v/vt/vn/f
+//        lines; afterwards the per-chunk counts are prefix-summed so that
+//        relative (negative) face indices resolve across chunk borders.
+//        Corners are welded on their (position, uv, normal) index tuples.
+//   PLY  vertex records have a fixed size, so the vertex element is split
+//        into equal ranges per thread. Faces are variable-length lists and
+//        are read in one sequential pass.
+//
+// Polygons are fan-triangulated. The output is a MeshData with positions at
+// location 0 and, when the file has them, normals at 1 and UVs at 2, so it
+// goes through the same optimize/pack/upload steps as the built-in shapes.
+// Build with -pthread.
+
+struct MeshImportStats {
+    size_t bytes;
+    double seconds;
+    double megabytesPerSecond;
+    unsigned int threads;
+    size_t vertices;
+    size_t triangles;
+};
+
+inline unsigned int meshImportThreadCount() {
+    unsigned int n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+// Runs fn(i) for i in [0, count) on count threads (inline when count is 1)
+template <typename Fn>
+inline void parallelFor(unsigned int count, Fn fn) {
+    if (count <= 1) {
+        fn(0u);
+        return;
+    }
+    std::vector<std::thread> threads;
+    for (unsigned int i = 0; i < count; ++i)
+        threads.push_back(std::thread(fn, i));
+    for (size_t i = 0; i < threads.size(); ++i)
+        threads[i].join();
+}
+
+// Decimal float parser for mesh files: sign, digits, fraction, exponent, no
+// locale and no NUL terminator needed. Anything it does not recognise (inf,
+// nan, hex floats) is handed to strtof. Returns the position after the number.
+inline const char* parseMeshFloat(const char* p, const char* end, float& out) {
+    static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                     1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+    while (p < end && (*p == ' ' || *p == '\t'))
+        ++p;
+    const char* start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    int digits = 0;
+    while (p < end && (unsigned)(*p - '0') < 10) {
+        if (mantissa < 1000000000000000000ull)
+            mantissa = mantissa * 10 + (*p - '0');
+        else
+            ++exponent;
+        ++p;
+        ++digits;
+    }
+    if (p < end && *p == '.') {
+        ++p;
+        while (p < end && (unsigned)(*p - '0') < 10) {
+            if (mantissa < 1000000000000000000ull) {
+                mantissa = mantissa * 10 + (*p - '0');
+                --exponent;
+            }
+            ++p;
+            ++digits;
+        }
+    }
+    if (digits == 0) {
+        // Not a plain decimal number, let the C library have a go
+        char token[64];
+        size_t length = 0;
+        while (start + length < end && length < sizeof(token) - 1 && start[length] > ' ')
+            ++length;
+        memcpy(token, start, length);
+        token[length] = '\0';
+        char* stop = token;
+        out = strtof(token, &stop);
+        return start + (stop - token);
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char* e = p + 1;
+        bool negativeExponent = false;
+        if (e < end && (*e == '-' || *e == '+'))
+            negativeExponent = *e++ == '-';
+        if (e < end && (unsigned)(*e - '0') < 10) {
+            int value = 0;
+            while (e < end && (unsigned)(*e - '0') < 10) {
+                if (value < 10000)
+                    value = value * 10 + (*e - '0');
+                ++e;
+            }
+            exponent += negativeExponent ? -value : value;
+            p = e;
+        }
+    }
+
+    double value = (double)mantissa;
+    if (exponent < 0)
+        value = exponent >= -22 ? value / powers[-exponent] : value * pow(10.0, exponent);
+    else if (exponent > 0)
+        value = exponent <= 22 ? value * powers[exponent] : value * pow(10.0, exponent);
+    out = (float)(negative ? -value : value);
+    return p;
+}
+
+inline const char* parseMeshInt(const char* p, const char* end, int& out) {
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+    int value = 0;
+    while (p < end && (unsigned)(*p - '0') < 10)
+        value = value * 10 + (*p++ - '0');
+    out = negative ? -value : value;
+    return p;
+}
+
+// --- OBJ ---------------------------------------------------------------------
+
+const uint8_t OBJ_CORNER_HAS_UV = 1;
+const uint8_t OBJ_CORNER_HAS_NORMAL = 2;
+
+// Indices are 0-based. Negative OBJ indices are resolved against the chunk's
+// own counts and flagged, the chunk's global base is added once it is known.
+struct ObjCorner {
+    int32_t position, uv, normal;
+    uint8_t flags;
+    uint8_t relative;   // bit 0 position, bit 1 uv, bit 2 normal
+};
+
+struct ObjChunk {
+    std::vector<float> positions;
+    std::vector<float> uvs;
+    std::vector<float> normals;
+    std::vector<ObjCorner> corners;   // 3 per triangle
+    size_t invalidIndices;
+};
+
+inline const char* skipObjLine(const char* p, const char* end) {
+    const char* newline = (const char*)memchr(p, '\n', end - p);
+    return newline ? newline + 1 : end;
+}
+
+// Parses one "a", "a/b", "a//c" or "a/b/c" face corner
+inline const char* parseObjCorner(const char* p, const char* end, const ObjChunk& chunk, ObjCorner& corner) {
+    int value;
+    corner.flags = 0;
+    corner.relative = 0;
+    corner.uv = corner.normal = 0;
+
+    p = parseMeshInt(p, end, value);
+    if (value < 0) {
+        corner.position = (int32_t)(chunk.positions.size() / 3) + value;
+        corner.relative |= 1;
+    } else {
+        corner.position = value - 1;
+    }
+    if (p < end && *p == '/') {
+        ++p;
+        if (p < end && *p != '/') {
+            p = parseMeshInt(p, end, value);
+            corner.flags |= OBJ_CORNER_HAS_UV;
+            if (value < 0) {
+                corner.uv = (int32_t)(chunk.uvs.size() / 2) + value;
+                corner.relative |= 2;
+            } else {
+                corner.uv = value - 1;
+            }
+        }
+        if (p < end && *p == '/') {
+            ++p;
+            p = parseMeshInt(p, end, value);
+            corner.flags |= OBJ_CORNER_HAS_NORMAL;
+            if (value < 0) {
+                corner.normal = (int32_t)(chunk.normals.size() / 3) + value;
+                corner.relative |= 4;
+            } else {
+                corner.normal = value - 1;
+            }
+        }
+    }
+    return p;
+}
+
+inline void parseObjChunk(const char* p, const char* end, ObjChunk& chunk) {
+    std::vector<ObjCorner> polygon;
+    chunk.invalidIndices = 0;
+    while (p < end) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+            ++p;
+        if (p + 1 >= end)
+            break;
+
+        if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+            float x, y, z;
+            p = parseMeshFloat(p + 1, end, x);
+            p = parseMeshFloat(p, end, y);
+            p = parseMeshFloat(p, end, z);
+            chunk.positions.push_back(x);
+            chunk.positions.push_back(y);
+            chunk.positions.push_back(z);
+        } else if (p[0] == 'v' && p[1] == 'n') {
+            float x, y, z;
+            p = parseMeshFloat(p + 2, end, x);
+            p = parseMeshFloat(p, end, y);
+            p = parseMeshFloat(p, end, z);
+            chunk.normals.push_back(x);
+            chunk.normals.push_back(y);
+            chunk.normals.push_back(z);
+        } else if (p[0] == 'v' && p[1] == 't') {
+            float u, v;
+            p = parseMeshFloat(p + 2, end, u);
+            p = parseMeshFloat(p, end, v);
+            chunk.uvs.push_back(u);
+            chunk.uvs.push_back(v);
+        } else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+            polygon.clear();
+            ++p;
+            for (;;) {
+                while (p < end && (*p == ' ' || *p == '\t'))
+                    ++p;
+                if (p >= end || *p == '\n' || *p == '\r' || *p == '#')
+                    break;
+                if (*p != '-' && *p != '+' && (unsigned)(*p - '0') >= 10) {
+                    ++chunk.invalidIndices;
+                    break;
+                }
+                ObjCorner corner;
+                p = parseObjCorner(p, end, chunk, corner);
+                polygon.push_back(corner);
+            }
+            for (size_t i = 2; i < polygon.size(); ++i) {
+                chunk.corners.push_back(polygon[0]);
+                chunk.corners.push_back(polygon[i - 1]);
+                chunk.corners.push_back(polygon[i]);
+            }
+        }
+        // Everything else (comments, o, g, s, usemtl, mtllib) is skipped
+        p = skipObjLine(p, end);
+    }
+}
+
+inline bool importObj(const char* data, size_t size, MeshData& mesh, unsigned int threadCount) {
+    // One chunk per thread, each starting right after a newline
+    std::vector<const char*> bounds(threadCount + 1);
+    bounds[0] = data;
+    bounds[threadCount] = data + size;
+    for (unsigned int i = 1; i < threadCount; ++i) {
+        const char* p = data + size * i / threadCount;
+        if (p < bounds[i - 1])
+            p = bounds[i - 1];
+        bounds[i] = p == data ? p : skipObjLine(p - 1, data + size);
+    }
+
+    std::vector<ObjChunk> chunks(threadCount);
+    parallelFor(threadCount, [&](unsigned int i) {
+        parseObjChunk(bounds[i], bounds[i + 1], chunks[i]);
+    });
+
+    // Prefix sums give every chunk its global offsets
+    std::vector<size_t> positionBase(threadCount + 1, 0), uvBase(threadCount + 1, 0);
+    std::vector<size_t> normalBase(threadCount + 1, 0), cornerBase(threadCount + 1, 0);
+    bool anyUV = false, anyNormal = false;
+    size_t invalid = 0;
+    for (unsigned int i = 0; i < threadCount; ++i) {
+        positionBase[i + 1] = positionBase[i] + chunks[i].positions.size() / 3;
+        uvBase[i + 1] = uvBase[i] + chunks[i].uvs.size() / 2;
+        normalBase[i + 1] = normalBase[i] + chunks[i].normals.size() / 3;
+        cornerBase[i + 1] = cornerBase[i] + chunks[i].corners.size();
+        invalid += chunks[i].invalidIndices;
+        for (size_t c = 0; c < chunks[i].corners.size() && !(anyUV && anyNormal); ++c) {
+            anyUV = anyUV || (chunks[i].corners[c].flags & OBJ_CORNER_HAS_UV);
+            anyNormal = anyNormal || (chunks[i].corners[c].flags & OBJ_CORNER_HAS_NORMAL);
+        }
+    }
+    const size_t positionCount = positionBase[threadCount];
+    const size_t uvCount = uvBase[threadCount];
+    const size_t normalCount = normalBase[threadCount];
+    const size_t cornerCount = cornerBase[threadCount];
+    if (positionCount == 0 || cornerCount == 0) {
+        std::cerr << "ERROR::MESHIMPORT::NO_GEOMETRY" << std::endl;
+        return false;
+    }
+    anyUV = anyUV && uvCount;
+    anyNormal = anyNormal && normalCount;
+
+    std::vector<float> positions(positionCount * 3), uvs(uvCount * 2), normals(normalCount * 3);
+    // Corner keys: (position, uv, normal) with -1 for a missing attribute
+    std::vector<int32_t> keys(cornerCount * 3);
+    std::vector<size_t> badCorners(threadCount, 0);
+    parallelFor(threadCount, [&](unsigned int i) {
+        const ObjChunk& chunk = chunks[i];
+        std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + positionBase[i] * 3);
+        std::copy(chunk.uvs.begin(), chunk.uvs.end(), uvs.begin() + uvBase[i] * 2);
+        std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + normalBase[i] * 3);
+        for (size_t c = 0; c < chunk.corners.size(); ++c) {
+            const ObjCorner& corner = chunk.corners[c];
+            int64_t p = corner.position + ((corner.relative & 1) ? (int64_t)positionBase[i] : 0);
+            int64_t t = (corner.flags & OBJ_CORNER_HAS_UV) ? corner.uv + ((corner.relative & 2) ? (int64_t)uvBase[i] : 0) : -1;
+            int64_t n = (corner.flags & OBJ_CORNER_HAS_NORMAL) ? corner.normal + ((corner.relative & 4) ? (int64_t)normalBase[i] : 0) : -1;
+            if (p < 0 || p >= (int64_t)positionCount) {
+                p = 0;
+                ++badCorners[i];
+            }
+            if (t >= (int64_t)uvCount || t < -1)
+                t = -1;
+            if (n >= (int64_t)normalCount || n < -1)
+                n = -1;
+            int32_t* key = &keys[(cornerBase[i] + c) * 3];
+            key[0] = (int32_t)p;
+            key[1] = anyUV ? (int32_t)t : -1;
+            key[2] = anyNormal ? (int32_t)n : -1;
+        }
+    });
+    for (unsigned int i = 0; i < threadCount; ++i)
+        invalid += badCorners[i];
+    if (invalid)
+        std::cerr << "ERROR::MESHIMPORT::INVALID_FACE_INDICES " << invalid << " corners" << std::endl;
+    chunks.clear();
+
+    mesh = MeshData();
+    mesh.layout.push_back(MeshAttrib{ 0, 3, GL_FLOAT, GL_FALSE, 0 });
+    unsigned int stride = 3 * sizeof(float);
+    if (anyNormal) {
+        mesh.layout.push_back(MeshAttrib{ 1, 3, GL_FLOAT, GL_FALSE, stride });
+        stride += 3 * sizeof(float);
+    }
+    if (anyUV) {
+        mesh.layout.push_back(MeshAttrib{ 2, 2, GL_FLOAT, GL_FALSE, stride });
+        stride += 2 * sizeof(float);
+    }
+    mesh.stride = stride;
+
+    if (!anyUV && !anyNormal) {
+        // Position-only faces index the position list directly
+        mesh.vertices.swap(positions);
+        mesh.indices.resize(cornerCount);
+        for (size_t c = 0; c < cornerCount; ++c)
+            mesh.indices[c] = keys[c * 3];
+        return true;
+    }
+
+    // Every distinct (position, uv, normal) tuple becomes one vertex
+    std::vector<uint32_t> remap;
+    uint32_t unique = weldVertices((uint32_t*)keys.data(), cornerCount, 3, remap);
+    mesh.indices.assign(remap.begin(), remap.end());
+
+    const unsigned int strideFloats = stride / sizeof(float);
+    mesh.vertices.assign((size_t)unique * strideFloats, 0.0f);
+    parallelFor(threadCount, [&](unsigned int i) {
+        size_t first = (size_t)unique * i / threadCount, last = (size_t)unique * (i + 1) / threadCount;
+        for (size_t v = first; v < last; ++v) {
+            const int32_t* key = &keys[v * 3];
+            float* out = &mesh.vertices[v * strideFloats];
+            memcpy(out, &positions[(size_t)key[0] * 3], 3 * sizeof(float));
+            out += 3;
+            if (anyNormal) {
+                if (key[2] >= 0)
+                    memcpy(out, &normals[(size_t)key[2] * 3], 3 * sizeof(float));
+                out += 3;
+            }
+            if (anyUV && key[1] >= 0)
+                memcpy(out, &uvs[(size_t)key[1] * 2], 2 * sizeof(float));
+        }
+    });
+    return true;
+}
+
+// --- PLY ---------------------------------------------------------------------
+
+enum PlyType { PLY_NONE, PLY_INT8, PLY_UINT8, PLY_INT16, PLY_UINT16, PLY_INT32, PLY_UINT32, PLY_FLOAT32, PLY_FLOAT64 };
+
+struct PlyProperty {
+    std::string name;
+    PlyType type;
+    PlyType countType;  // PLY_NONE unless this is a list
+    size_t offset;      // inside a fixed-size record
+};
+
+struct PlyElement {
+    std::string name;
+    size_t count;
+    std::vector<PlyProperty> properties;
+    size_t recordSize;  // 0 when the element has list properties
+};
+
+inline PlyType plyTypeFromName(const std::string& name) {
+    if (name == "char" || name == "int8") return PLY_INT8;
+    if (name == "uchar" || name == "uint8") return PLY_UINT8;
+    if (name == "short" || name == "int16") return PLY_INT16;
+    if (name == "ushort" || name == "uint16") return PLY_UINT16;
+    if (name == "int" || name == "int32") return PLY_INT32;
+    if (name == "uint" || name == "uint32") return PLY_UINT32;
+    if (name == "float" || name == "float32") return PLY_FLOAT32;
+    if (name == "double" || name == "float64") return PLY_FLOAT64;
+    return PLY_NONE;
+}
+
+inline size_t plyTypeSize(PlyType type) {
+    switch (type) {
+        case PLY_INT8: case PLY_UINT8: return 1;
+        case PLY_INT16: case PLY_UINT16: return 2;
+        case PLY_INT32: case PLY_UINT32: case PLY_FLOAT32: return 4;
+        case PLY_FLOAT64: return 8;
+        default: return 0;
+    }
+}
+
+inline double readPlyValue(const unsigned char* p, PlyType type, bool swap) {
+    unsigned char bytes[8];
+    size_t size = plyTypeSize(type);
+    for (size_t i = 0; i < size; ++i)
+        bytes[i] = swap ? p[size - 1 - i] : p[i];
+    switch (type) {
+        case PLY_INT8: return (int8_t)bytes[0];
+        case PLY_UINT8: return bytes[0];
+        case PLY_INT16: { int16_t v; memcpy(&v, bytes, 2); return v; }
+        case PLY_UINT16: { uint16_t v; memcpy(&v, bytes, 2); return v; }
+        case PLY_INT32: { int32_t v; memcpy(&v, bytes, 4); return v; }
+        case PLY_UINT32: { uint32_t v; memcpy(&v, bytes, 4); return v; }
+        case PLY_FLOAT32: { float v; memcpy(&v, bytes, 4); return v; }
+        case PLY_FLOAT64: { double v; memcpy(&v, bytes, 8); return v; }
+        default: return 0.0;
+    }
+}
+
+inline const PlyProperty* findPlyProperty(const PlyElement& element, const char* a, const char* b = NULL, const char* c = NULL) {
+    for (size_t i = 0; i < element.properties.size(); ++i) {
+        const std::string& n = element.properties[i].name;
+        if (n == a || (b && n == b) || (c && n == c))
+            return &element.properties[i];
+    }
+    return NULL;
+}
+
+inline bool importPly(const char* data, size_t size, MeshData& mesh, unsigned int threadCount) {
+    const char* headerEnd = NULL;
+    for (const char* p = data; p + 10 <= data + size; ++p) {
+        if (memcmp(p, "end_header", 10) == 0) {
+            headerEnd = p;
+            break;
+        }
+    }
+    if (size < 4 || memcmp(data, "ply", 3) != 0 || !headerEnd) {
+        std::cerr << "ERROR::MESHIMPORT::BAD_PLY_HEADER" << std::endl;
+        return false;
+    }
+
+    bool swap = false;
+    bool binary = false;
+    std::vector<PlyElement> elements;
+    const char* line = data;
+    while (line < headerEnd) {
+        const char* lineEnd = (const char*)memchr(line, '\n', headerEnd - line);
+        if (!lineEnd)
+            lineEnd = headerEnd;
+        std::vector<std::string> words;
+        const char* p = line;
+        while (p < lineEnd) {
+            while (p < lineEnd && (*p == ' ' || *p == '\t' || *p == '\r'))
+                ++p;
+            const char* w = p;
+            while (p < lineEnd && *p != ' ' && *p != '\t' && *p != '\r')
+                ++p;
+            if (p > w)
+                words.push_back(std::string(w, p));
+        }
+        line = lineEnd + 1;
+        if (words.empty())
+            continue;
+
+        if (words[0] == "format" && words.size() > 1) {
+            binary = words[1] == "binary_little_endian" || words[1] == "binary_big_endian";
+            swap = words[1] == "binary_big_endian";
+        } else if (words[0] == "element" && words.size() > 2) {
+            PlyElement element;
+            element.name = words[1];
+            element.count = strtoull(words[2].c_str(), NULL, 10);
+            element.recordSize = 0;
+            elements.push_back(element);
+        } else if (words[0] == "property" && !elements.empty()) {
+            PlyProperty property;
+            if (words.size() > 4 && words[1] == "list") {
+                property.countType = plyTypeFromName(words[2]);
+                property.type = plyTypeFromName(words[3]);
+                property.name = words[4];
+            } else if (words.size() > 2) {
+                property.countType = PLY_NONE;
+                property.type = plyTypeFromName(words[1]);
+                property.name = words[2];
+            } else {
+                continue;
+            }
+            if (property.type == PLY_NONE) {
+                std::cerr << "ERROR::MESHIMPORT::UNKNOWN_PLY_TYPE " << property.name << std::endl;
+                return false;
+            }
+            elements.back().properties.push_back(property);
+        }
+    }
+    if (!binary) {
+        std::cerr << "ERROR::MESHIMPORT::ONLY_BINARY_PLY_IS_SUPPORTED" << std::endl;
+        return false;
+    }
+    // Fixed record layouts for elements without lists
+    for (size_t e = 0; e < elements.size(); ++e) {
+        size_t offset = 0;
+        bool fixed = true;
+        for (size_t i = 0; i < elements[e].properties.size(); ++i) {
+            PlyProperty& property = elements[e].properties[i];
+            property.offset = offset;
+            if (property.countType != PLY_NONE)
+                fixed = false;
+            offset += plyTypeSize(property.type);
+        }
+        elements[e].recordSize = fixed ? offset : 0;
+    }
+
+    const unsigned char* p = (const unsigned char*)skipObjLine(headerEnd, data + size);
+    const unsigned char* end = (const unsigned char*)data + size;
+    mesh = MeshData();
+    bool haveVertices = false;
+
+    for (size_t e = 0; e < elements.size(); ++e) {
+        const PlyElement& element = elements[e];
+        if (element.name == "vertex" && element.recordSize) {
+            if ((size_t)(end - p) / element.recordSize < element.count) {
+                std::cerr << "ERROR::MESHIMPORT::TRUNCATED_PLY" << std::endl;
+                return false;
+            }
+            const PlyProperty* x = findPlyProperty(element, "x");
+            const PlyProperty* y = findPlyProperty(element, "y");
+            const PlyProperty* z = findPlyProperty(element, "z");
+            const PlyProperty* nx = findPlyProperty(element, "nx");
+            const PlyProperty* ny = findPlyProperty(element, "ny");
+            const PlyProperty* nz = findPlyProperty(element, "nz");
+            const PlyProperty* u = findPlyProperty(element, "u", "s", "texture_u");
+            const PlyProperty* v = findPlyProperty(element, "v", "t", "texture_v");
+            if (!x || !y || !z) {
+                std::cerr << "ERROR::MESHIMPORT::PLY_WITHOUT_POSITIONS" << std::endl;
+                return false;
+            }
+            bool hasNormals = nx && ny && nz;
+            bool hasUVs = u && v;
+
+            unsigned int stride = 3 * sizeof(float);
+            mesh.layout.push_back(MeshAttrib{ 0, 3, GL_FLOAT, GL_FALSE, 0 });
+            if (hasNormals) {
+                mesh.layout.push_back(MeshAttrib{ 1, 3, GL_FLOAT, GL_FALSE, stride });
+                stride += 3 * sizeof(float);
+            }
+            if (hasUVs) {
+                mesh.layout.push_back(MeshAttrib{ 2, 2, GL_FLOAT, GL_FALSE, stride });
+                stride += 2 * sizeof(float);
+            }
+            mesh.stride = stride;
+            const unsigned int strideFloats = stride / sizeof(float);
+            const PlyProperty* sources[8] = { x, y, z, nx, ny, nz, u, v };
+            int sourceCount = 0;
+            const PlyProperty* used[8];
+            for (int i = 0; i < 8; ++i) {
+                if (i >= 3 && i < 6 && !hasNormals) continue;
+                if (i >= 6 && !hasUVs) continue;
+                used[sourceCount++] = sources[i];
+            }
+
+            mesh.vertices.resize(element.count * strideFloats);
+            const unsigned char* records = p;
+            parallelFor(threadCount, [&](unsigned int t) {
+                size_t first = element.count * t / threadCount, last = element.count * (t + 1) / threadCount;
+                for (size_t i = first; i < last; ++i) {
+                    const unsigned char* record = records + i * element.recordSize;
+                    float* out = &mesh.vertices[i * strideFloats];
+                    for (int k = 0; k < sourceCount; ++k)
+                        out[k] = (float)readPlyValue(record + used[k]->offset, used[k]->type, swap);
+                }
+            });
+            p += element.count * element.recordSize;
+            haveVertices = true;
+        } else if (element.name == "face") {
+            const PlyProperty* list = findPlyProperty(element, "vertex_indices", "vertex_index");
+            if (!list || list->countType == PLY_NONE) {
+                std::cerr << "ERROR::MESHIMPORT::PLY_FACES_WITHOUT_INDEX_LIST" << std::endl;
+                return false;
+            }
+            size_t vertexCount = haveVertices ? meshVertexCount(mesh) : 0;
+            size_t invalid = 0;
+            mesh.indices.reserve(element.count * 3);
+            std::vector<uint32_t> polygon;
+            for (size_t f = 0; f < element.count; ++f) {
+                for (size_t k = 0; k < element.properties.size(); ++k) {
+                    const PlyProperty& property = element.properties[k];
+                    size_t count = 1;
+                    if (property.countType != PLY_NONE) {
+                        if (p + plyTypeSize(property.countType) > end) {
+                            std::cerr << "ERROR::MESHIMPORT::TRUNCATED_PLY" << std::endl;
+                            return false;
+                        }
+                        count = (size_t)readPlyValue(p, property.countType, swap);
+                        p += plyTypeSize(property.countType);
+                    }
+                    size_t bytes = count * plyTypeSize(property.type);
+                    if ((size_t)(end - p) < bytes) {
+                        std::cerr << "ERROR::MESHIMPORT::TRUNCATED_PLY" << std::endl;
+                        return false;
+                    }
+                    if (&property == list) {
+                        polygon.resize(count);
+                        for (size_t i = 0; i < count; ++i) {
+                            double index = readPlyValue(p + i * plyTypeSize(property.type), property.type, swap);
+                            if (index < 0 || index >= vertexCount) {
+                                ++invalid;
+                                index = 0;
+                            }
+                            polygon[i] = (uint32_t)index;
+                        }
+                        for (size_t i = 2; i < count; ++i) {
+                            mesh.indices.push_back(polygon[0]);
+                            mesh.indices.push_back(polygon[i - 1]);
+                            mesh.indices.push_back(polygon[i]);
+                        }
+                    }
+                    p += bytes;
+                }
+            }
+            if (invalid)
+                std::cerr << "ERROR::MESHIMPORT::INVALID_FACE_INDICES " << invalid << " corners" << std::endl;
+        } else if (element.recordSize) {
+            // Some other fixed-size element (edges, materials, ...)
+            if ((size_t)(end - p) / element.recordSize < element.count) {
+                std::cerr << "ERROR::MESHIMPORT::TRUNCATED_PLY" << std::endl;
+                return false;
+            }
+            p += element.count * element.recordSize;
+        } else {
+            // A list element we do not know how to size; nothing after it is reachable
+            break;
+        }
+    }
+    if (!haveVertices || mesh.indices.empty()) {
+        std::cerr << "ERROR::MESHIMPORT::NO_GEOMETRY" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// --- Entry point ----------------------------------------------------------
+
+// Imports an .obj or binary .ply file into `mesh`. Prints the parse rate and
+// returns false with an ERROR::MESHIMPORT message on failure.
+inline bool importMesh(const char* path, MeshData& mesh, MeshImportStats* stats = NULL, unsigned int threadCount = 0) {
+    if (threadCount == 0)
+        threadCount = meshImportThreadCount();
+
+    std::string name(path);
+    std::string extension = name.substr(name.find_last_of('.') + 1);
+    for (size_t i = 0; i < extension.size(); ++i)
+        extension[i] = tolower(extension[i]);
+    if (extension != "obj" && extension != "ply") {
+        std::cerr << "ERROR::MESHIMPORT::UNKNOWN_EXTENSION " << path << std::endl;
+        return false;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "ERROR::MESHIMPORT::CANNOT_OPEN " << path << std::endl;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        std::cerr << "ERROR::MESHIMPORT::EMPTY_FILE " << path << std::endl;
+        close(fd);
+        return false;
+    }
+    size_t size = st.st_size;
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "ERROR::MESHIMPORT::MMAP_FAILED " << path << std::endl;
+        return false;
+    }
+    // Each thread streams through its own chunk once
+    madvise(mapping, size, MADV_SEQUENTIAL);
+    madvise(mapping, size, MADV_WILLNEED);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool ok = extension == "obj" ? importObj((const char*)mapping, size, mesh, threadCount)
+                                 : importPly((const char*)mapping, size, mesh, threadCount);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    munmap(mapping, size);
+    if (!ok) {
+        std::cerr << "ERROR::MESHIMPORT::FAILED " << path << std::endl;
+        return false;
+    }
+
+    MeshImportStats result;
+    result.bytes = size;
+    result.seconds = seconds;
+    result.megabytesPerSecond = seconds > 0.0 ? size / (1024.0 * 1024.0) / seconds : 0.0;
+    result.threads = threadCount;
+    result.vertices = meshVertexCount(mesh);
+    result.triangles = mesh.indices.size() / 3;
+    if (stats)
+        *stats = result;
+
+    // Formatted apart so std::cout keeps its own precision
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(1)
+         << "Imported " << path << ": " << size / (1024.0 * 1024.0) << " MB in " << seconds * 1000.0 << " ms ("
+         << result.megabytesPerSecond << " MB/s on " << threadCount << " threads), "
+         << result.vertices << " vertices, " << result.triangles << " triangles";
+    std::cout << line.str() << std::endl;
+    return true;
+}
+
+#endif
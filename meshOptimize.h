@@ -0,0 +1,382 @@
+#ifndef MESH_OPTIMIZE_H
+#define MESH_OPTIMIZE_H
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include "mesh.h"
+
+// Index and vertex reordering for indexed triangle meshes. Runs once, at load
+// or export time:
+//
+//   1. optimizeVertexCache   - Forsyth's linear-speed vertex cache optimisation
+//   2. optimizeOverdraw      - splits the result into clusters and orders them
+//                              so outward facing clusters are drawn first
+//   3. optimizeVertexFetch   - renumbers vertices in first-use order so the
+//                              vertex fetch walks the VBO front to back
+//
+// Under llvmpipe every post-transform cache miss is a vertex shader run on
+// the CPU, so (1) pays off directly; (2) trades a little of it back to cut
+// fragment work.
+
+// Vertex cache model used for the ACMR/ATVR numbers. A 16 entry FIFO is the
+// usual conservative stand-in for real post-transform caches.
+const unsigned int MESH_ANALYZE_CACHE_SIZE = 16;
+// Cache size the Forsyth scoring assumes (an LRU, as in the original paper)
+const int MESH_FORSYTH_CACHE_SIZE = 32;
+
+struct VertexCacheStats {
+    unsigned int misses;
+    unsigned int triangles;
+    unsigned int vertices;  // distinct vertices referenced
+    float acmr;             // misses per triangle, 0.5 is the ideal for a regular grid
+    float atvr;             // misses per vertex, 1.0 is ideal
+};
+
+// Simulates a FIFO vertex cache over indices[first, first + count)
+inline VertexCacheStats analyzeVertexCache(const unsigned int* indices, size_t count, size_t vertexCount,
+                                           unsigned int cacheSize = MESH_ANALYZE_CACHE_SIZE) {
+    VertexCacheStats stats = {};
+    // A vertex is in the FIFO while fifoTime - insertedAt[v] < cacheSize
+    std::vector<unsigned int> insertedAt(vertexCount, 0);
+    std::vector<bool> seen(vertexCount, false);
+    unsigned int fifoTime = cacheSize + 1;
+
+    for (size_t i = 0; i < count; ++i) {
+        unsigned int v = indices[i];
+        if (fifoTime - insertedAt[v] > cacheSize) {
+            insertedAt[v] = fifoTime++;
+            ++stats.misses;
+        }
+        if (!seen[v]) {
+            seen[v] = true;
+            ++stats.vertices;
+        }
+    }
+    stats.triangles = count / 3;
+    stats.acmr = stats.triangles ? (float)stats.misses / stats.triangles : 0.0f;
+    stats.atvr = stats.vertices ? (float)stats.misses / stats.vertices : 0.0f;
+    return stats;
+}
+
+// Forsyth scoring: vertices near the front of the cache and vertices with few
+// triangles left score high, so the next triangle keeps hitting the cache and
+// islands get finished instead of leaving stragglers behind.
+inline float forsythVertexScore(int cachePosition, unsigned int remainingTriangles) {
+    if (remainingTriangles == 0)
+        return -1.0f;
+
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) {
+            // Used by the triangle just emitted, fixed score so it is not over-favoured
+            score = 0.75f;
+        } else {
+            float scaled = 1.0f - (float)(cachePosition - 3) / (MESH_FORSYTH_CACHE_SIZE - 3);
+            score = powf(scaled, 1.5f);
+        }
+    }
+    score += 2.0f / sqrtf((float)remainingTriangles);
+    return score;
+}
+
+// Reorders the triangles in indices[first, first + count) in place
+inline void optimizeVertexCache(unsigned int* indices, size_t count, size_t vertexCount) {
+    size_t triangleCount = count / 3;
+    if (triangleCount < 2)
+        return;
+
+    // Vertex -> triangle adjacency in one flat array
+    std::vector<unsigned int> remaining(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i)
+        ++remaining[indices[i]];
+    std::vector<unsigned int> adjacencyStart(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v)
+        adjacencyStart[v + 1] = adjacencyStart[v] + remaining[v];
+    std::vector<unsigned int> adjacency(triangleCount * 3);
+    std::vector<unsigned int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+    for (size_t t = 0; t < triangleCount; ++t)
+        for (int k = 0; k < 3; ++k)
+            adjacency[fill[indices[t * 3 + k]]++] = t;
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        vertexScore[v] = forsythVertexScore(-1, remaining[v]);
+
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    for (size_t t = 0; t < triangleCount; ++t)
+        triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+
+    std::vector<unsigned int> output;
+    output.reserve(triangleCount * 3);
+    std::vector<unsigned int> cache, nextCache;
+    cache.reserve(MESH_FORSYTH_CACHE_SIZE + 3);
+    nextCache.reserve(MESH_FORSYTH_CACHE_SIZE + 3);
+
+    size_t inputCursor = 0;   // fallback when nothing in the cache has triangles left
+    long best = (long)(std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin());
+
+    while (best >= 0) {
+        const unsigned int* tri = indices + best * 3;
+        output.insert(output.end(), tri, tri + 3);
+        emitted[best] = true;
+
+        // Drop the triangle from its vertices' live lists
+        for (int k = 0; k < 3; ++k) {
+            unsigned int v = tri[k];
+            unsigned int* begin = &adjacency[adjacencyStart[v]];
+            unsigned int* end = begin + remaining[v];
+            unsigned int* it = std::find(begin, end, (unsigned int)best);
+            if (it != end) {
+                *it = *(end - 1);
+                --remaining[v];
+            }
+        }
+
+        // LRU update: the triangle's vertices go to the front
+        nextCache.assign(tri, tri + 3);
+        for (size_t i = 0; i < cache.size(); ++i)
+            if (cache[i] != tri[0] && cache[i] != tri[1] && cache[i] != tri[2])
+                nextCache.push_back(cache[i]);
+
+        // Re-score everything that was or is in the cache
+        for (size_t i = 0; i < nextCache.size(); ++i) {
+            unsigned int v = nextCache[i];
+            cachePosition[v] = i < (size_t)MESH_FORSYTH_CACHE_SIZE ? (int)i : -1;
+            vertexScore[v] = forsythVertexScore(cachePosition[v], remaining[v]);
+        }
+        if (nextCache.size() > (size_t)MESH_FORSYTH_CACHE_SIZE)
+            nextCache.resize(MESH_FORSYTH_CACHE_SIZE);
+        cache.swap(nextCache);
+
+        best = -1;
+        float bestScore = -1.0f;
+        for (size_t i = 0; i < cache.size(); ++i) {
+            unsigned int v = cache[i];
+            for (unsigned int a = 0; a < remaining[v]; ++a) {
+                unsigned int t = adjacency[adjacencyStart[v] + a];
+                float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+                triangleScore[t] = score;
+                if (score > bestScore) {
+                    bestScore = score;
+                    best = t;
+                }
+            }
+        }
+
+        if (best < 0) {
+            while (inputCursor < triangleCount && emitted[inputCursor])
+                ++inputCursor;
+            if (inputCursor < triangleCount)
+                best = inputCursor;
+        }
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+// Overdraw pass (Sander, Nehab and Barczak, "Fast Triangle Reordering for
+// Vertex Locality and Reduced Overdraw"). The cache optimised order is cut
+// into clusters: hard cuts where the cache restarts anyway (a triangle with
+// three misses), soft cuts where the running ACMR is within `threshold` of
+// the cluster's own. Clusters are then sorted so the ones facing away from the
+// mesh centre are drawn first, which makes early depth rejection kick in for
+// the rest. threshold = 1.05 keeps ACMR within about 5% of the cache order.
+inline void optimizeOverdraw(unsigned int* indices, size_t count, const float* vertices, size_t vertexCount,
+                             unsigned int strideFloats, float threshold = 1.05f) {
+    size_t triangleCount = count / 3;
+    if (triangleCount < 2)
+        return;
+
+    // Hard boundaries
+    std::vector<size_t> clusters;
+    {
+        std::vector<unsigned int> insertedAt(vertexCount, 0);
+        unsigned int fifoTime = MESH_ANALYZE_CACHE_SIZE + 1;
+        for (size_t t = 0; t < triangleCount; ++t) {
+            unsigned int misses = 0;
+            for (int k = 0; k < 3; ++k) {
+                unsigned int v = indices[t * 3 + k];
+                if (fifoTime - insertedAt[v] > MESH_ANALYZE_CACHE_SIZE) {
+                    insertedAt[v] = fifoTime++;
+                    ++misses;
+                }
+            }
+            if (t == 0 || misses == 3)
+                clusters.push_back(t);
+        }
+    }
+
+    // Soft boundaries inside each hard cluster
+    std::vector<size_t> softClusters;
+    for (size_t c = 0; c < clusters.size(); ++c) {
+        size_t start = clusters[c];
+        size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+        VertexCacheStats clusterStats = analyzeVertexCache(indices + start * 3, (end - start) * 3, vertexCount);
+        float limit = clusterStats.acmr * threshold;
+
+        std::vector<unsigned int> insertedAt(vertexCount, 0);
+        unsigned int fifoTime = MESH_ANALYZE_CACHE_SIZE + 1;
+        unsigned int misses = 0;
+        size_t clusterStart = start;
+        softClusters.push_back(start);
+        for (size_t t = start; t < end; ++t) {
+            for (int k = 0; k < 3; ++k) {
+                unsigned int v = indices[t * 3 + k];
+                if (fifoTime - insertedAt[v] > MESH_ANALYZE_CACHE_SIZE) {
+                    insertedAt[v] = fifoTime++;
+                    ++misses;
+                }
+            }
+            // Cut after this triangle if the cluster so far is already cache efficient
+            if (t + 1 < end && t - clusterStart >= 8 && (float)misses / (t - clusterStart + 1) <= limit) {
+                clusterStart = t + 1;
+                softClusters.push_back(clusterStart);
+                fifoTime += MESH_ANALYZE_CACHE_SIZE + 1;
+                misses = 0;
+            }
+        }
+    }
+    if (softClusters.size() < 2)
+        return;
+
+    // Mesh centroid, then per-cluster area weighted centroid and normal
+    float meshCentre[3] = { 0.0f, 0.0f, 0.0f };
+    for (size_t v = 0; v < vertexCount; ++v)
+        for (int k = 0; k < 3; ++k)
+            meshCentre[k] += vertices[v * strideFloats + k];
+    for (int k = 0; k < 3; ++k)
+        meshCentre[k] /= vertexCount ? vertexCount : 1;
+
+    struct Cluster { size_t start, end; float sortKey; };
+    std::vector<Cluster> sorted(softClusters.size());
+    for (size_t c = 0; c < softClusters.size(); ++c) {
+        Cluster& cluster = sorted[c];
+        cluster.start = softClusters[c];
+        cluster.end = c + 1 < softClusters.size() ? softClusters[c + 1] : triangleCount;
+
+        float centroid[3] = { 0.0f, 0.0f, 0.0f };
+        float normal[3] = { 0.0f, 0.0f, 0.0f };
+        float area = 0.0f;
+        for (size_t t = cluster.start; t < cluster.end; ++t) {
+            const float* a = vertices + indices[t * 3] * strideFloats;
+            const float* b = vertices + indices[t * 3 + 1] * strideFloats;
+            const float* p = vertices + indices[t * 3 + 2] * strideFloats;
+            float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            float e2[3] = { p[0] - a[0], p[1] - a[1], p[2] - a[2] };
+            float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            float triArea = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (int k = 0; k < 3; ++k) {
+                centroid[k] += (a[k] + b[k] + p[k]) * triArea / 3.0f;
+                normal[k] += n[k];
+            }
+            area += triArea;
+        }
+        float normalLength = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        cluster.sortKey = 0.0f;
+        if (area > 0.0f && normalLength > 0.0f) {
+            for (int k = 0; k < 3; ++k)
+                cluster.sortKey += (centroid[k] / area - meshCentre[k]) * normal[k] / normalLength;
+        }
+    }
+
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+    std::vector<unsigned int> output;
+    output.reserve(triangleCount * 3);
+    for (size_t c = 0; c < sorted.size(); ++c)
+        output.insert(output.end(), indices + sorted[c].start * 3, indices + sorted[c].end * 3);
+    std::copy(output.begin(), output.end(), indices);
+}
+
+// Renumbers vertices in the order the index buffer first touches them and
+// drops unreferenced ones. Index ranges are walked in order, so when every
+// LOD uses a superset of the previous one's vertices (as the icosphere does)
+// each LOD still only touches a prefix of the vertex buffer.
+inline void optimizeVertexFetch(MeshData& mesh) {
+    const size_t strideFloats = mesh.stride / sizeof(float);
+    const size_t vertexCount = meshVertexCount(mesh);
+    const unsigned int unmapped = 0xFFFFFFFFu;
+
+    std::vector<unsigned int> remap(vertexCount, unmapped);
+    std::vector<float> vertices;
+    vertices.reserve(mesh.vertices.size());
+    unsigned int next = 0;
+    for (size_t i = 0; i < mesh.indices.size(); ++i) {
+        unsigned int v = mesh.indices[i];
+        if (remap[v] == unmapped) {
+            remap[v] = next++;
+            vertices.insert(vertices.end(), mesh.vertices.begin() + v * strideFloats, mesh.vertices.begin() + (v + 1) * strideFloats);
+        }
+        mesh.indices[i] = remap[v];
+    }
+    mesh.vertices.swap(vertices);
+
+    for (size_t l = 0; l < mesh.lods.size(); ++l) {
+        MeshLOD& lod = mesh.lods[l];
+        unsigned int highest = 0;
+        for (unsigned int i = lod.firstIndex; i < lod.firstIndex + lod.indexCount; ++i)
+            highest = std::max(highest, mesh.indices[i]);
+        lod.vertexCount = highest + 1;
+    }
+}
+
+struct MeshOptimizeReport {
+    VertexCacheStats before;
+    VertexCacheStats after;
+};
+
+inline VertexCacheStats analyzeMeshVertexCache(const MeshData& mesh) {
+    // Stats of the finest LOD for LOD chains, the whole mesh otherwise
+    size_t first = 0, count = mesh.indices.size();
+    if (!mesh.lods.empty()) {
+        first = mesh.lods.back().firstIndex;
+        count = mesh.lods.back().indexCount;
+    }
+    return analyzeVertexCache(mesh.indices.data() + first, count, meshVertexCount(mesh));
+}
+
+// Runs all three passes. Each LOD range is optimised on its own. Non-indexed
+// meshes and meshes that were already split into batches are left alone, and
+// quantized meshes skip the overdraw pass since it needs float positions.
+inline MeshOptimizeReport optimizeMesh(MeshData& mesh, const char* name = NULL) {
+    MeshOptimizeReport report = {};
+    if (mesh.indices.empty() || !mesh.batches.empty())
+        return report;
+
+    report.before = analyzeMeshVertexCache(mesh);
+
+    const size_t vertexCount = meshVertexCount(mesh);
+    std::vector<MeshLOD> ranges = mesh.lods;
+    if (ranges.empty()) {
+        MeshLOD whole = { 0, (uint32_t)mesh.indices.size(), (uint32_t)vertexCount, 0 };
+        ranges.push_back(whole);
+    }
+    for (size_t r = 0; r < ranges.size(); ++r) {
+        unsigned int* indices = mesh.indices.data() + ranges[r].firstIndex;
+        optimizeVertexCache(indices, ranges[r].indexCount, vertexCount);
+        if (!mesh.quantized)
+            optimizeOverdraw(indices, ranges[r].indexCount, mesh.vertices.data(), vertexCount, mesh.stride / sizeof(float));
+    }
+    optimizeVertexFetch(mesh);
+
+    report.after = analyzeMeshVertexCache(mesh);
+    if (name) {
+        // Formatted apart so std::cout keeps its own precision
+        std::ostringstream line;
+        line << std::fixed << std::setprecision(3)
+             << name << ": ACMR " << report.before.acmr << " -> " << report.after.acmr
+             << ", ATVR " << report.before.atvr << " -> " << report.after.atvr
+             << " (" << report.after.triangles << " triangles)";
+        std::cout << line.str() << std::endl;
+    }
+    return report;
+}
+
+#endif
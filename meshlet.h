@@ -0,0 +1,333 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MESHLET_SSE 1
+#endif
+#include "mesh.h"
+
+// Meshlets: the index buffer cut into small clusters that can be culled as a
+// whole every frame.
+//
+// Building walks the triangles in index buffer order (which optimizeMesh has
+// already made spatially coherent) and starts a new meshlet whenever the next
+// triangle would go over MESHLET_MAX_VERTICES unique vertices or
+// MESHLET_MAX_TRIANGLES triangles. Meshlets are therefore just contiguous
+// index ranges and need no extra index data. Each LOD and each 16-bit batch
+// is clustered on its own.
+//
+// Culling tests four meshlets at a time against the six frustum planes and
+// the normal cone (SSE, with a scalar fallback), then merges neighbouring
+// survivors into as few ranges as possible for one glMultiDrawElementsBaseVertex.
+// Everything happens in model space: pass the model-view-projection matrix
+// and the camera position transformed by the inverse model matrix. Models
+// must not be scaled non-uniformly.
+
+const unsigned int MESHLET_MAX_VERTICES = 64;
+const unsigned int MESHLET_MAX_TRIANGLES = 124;
+
+// Cone test from the meshlet's bounding sphere: every triangle faces away from
+// any eye inside the region where this holds
+inline bool meshletBackfacing(const Meshlet& m, const float eye[3]) {
+    float d[3] = { m.center[0] - eye[0], m.center[1] - eye[1], m.center[2] - eye[2] };
+    float distance = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+    return d[0] * m.coneAxis[0] + d[1] * m.coneAxis[1] + d[2] * m.coneAxis[2] >= m.coneCutoff * distance + m.radius;
+}
+
+// Fills in the sphere and cone of meshlet `m` from its triangles. Positions are
+// float3 at the start of each vertex.
+inline void computeMeshletBounds(Meshlet& m, const unsigned int* indices, const float* vertices, unsigned int strideFloats) {
+    const float* base = vertices + (size_t)m.baseVertex * strideFloats;
+    float lo[3] = { 1e30f, 1e30f, 1e30f }, hi[3] = { -1e30f, -1e30f, -1e30f };
+    for (uint32_t i = 0; i < m.indexCount; ++i) {
+        const float* p = base + (size_t)indices[m.firstIndex + i] * strideFloats;
+        for (int k = 0; k < 3; ++k) {
+            lo[k] = std::min(lo[k], p[k]);
+            hi[k] = std::max(hi[k], p[k]);
+        }
+    }
+    float radius2 = 0.0f;
+    for (int k = 0; k < 3; ++k)
+        m.center[k] = (lo[k] + hi[k]) * 0.5f;
+    for (uint32_t i = 0; i < m.indexCount; ++i) {
+        const float* p = base + (size_t)indices[m.firstIndex + i] * strideFloats;
+        float dx = p[0] - m.center[0], dy = p[1] - m.center[1], dz = p[2] - m.center[2];
+        radius2 = std::max(radius2, dx * dx + dy * dy + dz * dz);
+    }
+    m.radius = sqrtf(radius2);
+
+    // Cone axis is the average unit triangle normal; the cutoff comes from the
+    // widest angle between that axis and any triangle
+    std::vector<float> normals;
+    normals.reserve(m.indexCount);
+    float axis[3] = { 0.0f, 0.0f, 0.0f };
+    for (uint32_t t = 0; t < m.indexCount; t += 3) {
+        const float* a = base + (size_t)indices[m.firstIndex + t] * strideFloats;
+        const float* b = base + (size_t)indices[m.firstIndex + t + 1] * strideFloats;
+        const float* c = base + (size_t)indices[m.firstIndex + t + 2] * strideFloats;
+        float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+        float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+        float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+        float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length == 0.0f)
+            continue;
+        for (int k = 0; k < 3; ++k) {
+            normals.push_back(n[k] / length);
+            axis[k] += n[k] / length;
+        }
+    }
+    float axisLength = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    m.coneCutoff = 1.0f;
+    m.coneAxis[0] = m.coneAxis[1] = m.coneAxis[2] = 0.0f;
+    if (axisLength == 0.0f)
+        return;
+    float minDot = 1.0f;
+    for (int k = 0; k < 3; ++k)
+        m.coneAxis[k] = axis[k] / axisLength;
+    for (size_t i = 0; i < normals.size(); i += 3)
+        minDot = std::min(minDot, normals[i] * m.coneAxis[0] + normals[i + 1] * m.coneAxis[1] + normals[i + 2] * m.coneAxis[2]);
+    // A cone wider than a hemisphere always has a front-facing triangle
+    if (minDot > 0.0f)
+        m.coneCutoff = sqrtf(1.0f - minDot * minDot);
+}
+
+// Clusters one index range whose indices are relative to baseVertex.
+// stamp[v] == meshlet number when v is already in the current meshlet; it
+// holds one entry per vertex and is shared by all ranges of a mesh, which
+// works because meshlet numbers only ever grow.
+inline void buildMeshletsForRange(MeshData& mesh, uint32_t firstIndex, uint32_t indexCount, int32_t baseVertex,
+                                  std::vector<uint32_t>& stamp) {
+    const unsigned int strideFloats = mesh.stride / sizeof(float);
+    uint32_t number = (uint32_t)mesh.meshlets.size() + 1;
+
+    Meshlet m = {};
+    m.firstIndex = firstIndex;
+    m.baseVertex = baseVertex;
+    for (uint32_t i = firstIndex; i + 2 < firstIndex + indexCount; i += 3) {
+        unsigned int newVertices = 0;
+        for (int k = 0; k < 3; ++k) {
+            unsigned int v = mesh.indices[i + k];
+            if (stamp[baseVertex + v] != number && (k < 1 || v != mesh.indices[i]) && (k < 2 || v != mesh.indices[i + 1]))
+                ++newVertices;
+        }
+        if (m.vertexCount + newVertices > MESHLET_MAX_VERTICES || m.indexCount / 3 == MESHLET_MAX_TRIANGLES) {
+            computeMeshletBounds(m, mesh.indices.data(), mesh.vertices.data(), strideFloats);
+            mesh.meshlets.push_back(m);
+            m.firstIndex = i;
+            m.indexCount = 0;
+            m.vertexCount = 0;
+            ++number;
+        }
+        for (int k = 0; k < 3; ++k) {
+            unsigned int v = mesh.indices[i + k];
+            if (stamp[baseVertex + v] != number) {
+                stamp[baseVertex + v] = number;
+                ++m.vertexCount;
+            }
+        }
+        m.indexCount += 3;
+    }
+    if (m.indexCount) {
+        computeMeshletBounds(m, mesh.indices.data(), mesh.vertices.data(), strideFloats);
+        mesh.meshlets.push_back(m);
+    }
+}
+
+// Builds mesh.meshlets. Needs float positions, so run it after optimizeMesh
+// and any batch split but before compressVertices.
+inline void buildMeshlets(MeshData& mesh, const char* name = NULL) {
+    mesh.meshlets.clear();
+    if (mesh.indices.empty() || mesh.quantized)
+        return;
+    std::vector<uint32_t> stamp(meshVertexCount(mesh), 0);
+    if (!mesh.batches.empty()) {
+        for (size_t b = 0; b < mesh.batches.size(); ++b)
+            buildMeshletsForRange(mesh, mesh.batches[b].firstIndex, mesh.batches[b].indexCount, mesh.batches[b].baseVertex, stamp);
+    } else if (!mesh.lods.empty()) {
+        for (size_t l = 0; l < mesh.lods.size(); ++l)
+            buildMeshletsForRange(mesh, mesh.lods[l].firstIndex, mesh.lods[l].indexCount, 0, stamp);
+    } else {
+        buildMeshletsForRange(mesh, 0, mesh.indices.size(), 0, stamp);
+    }
+    if (name) {
+        std::cout << name << ": " << mesh.meshlets.size() << " meshlets, "
+                  << mesh.indices.size() / 3 / std::max<size_t>(mesh.meshlets.size(), 1) << " triangles each on average" << std::endl;
+    }
+}
+
+// Meshlets whose index range lies inside [firstIndex, firstIndex + indexCount)
+inline void meshletRange(const std::vector<Meshlet>& meshlets, uint32_t firstIndex, uint32_t indexCount,
+                         size_t& first, size_t& count) {
+    struct ByIndex {
+        bool operator()(const Meshlet& m, uint32_t index) const { return m.firstIndex < index; }
+    };
+    first = std::lower_bound(meshlets.begin(), meshlets.end(), firstIndex, ByIndex()) - meshlets.begin();
+    size_t last = std::lower_bound(meshlets.begin(), meshlets.end(), firstIndex + indexCount, ByIndex()) - meshlets.begin();
+    count = last - first;
+}
+
+struct MeshletCullStats {
+    size_t meshlets;
+    size_t visibleMeshlets;
+    size_t frustumCulled;       // meshlets
+    size_t backfaceCulled;      // meshlets
+    size_t triangles;
+    size_t visibleTriangles;
+    size_t draws;               // ranges after merging neighbours
+};
+
+inline float meshletCulledTriangleRatio(const MeshletCullStats& stats) {
+    return stats.triangles ? 1.0f - (float)stats.visibleTriangles / stats.triangles : 0.0f;
+}
+
+// Per-mesh culling state: the meshlet bounds in SoA form, padded to a multiple
+// of four, and the draw lists the last cull produced.
+struct MeshletCuller {
+    std::vector<float> centerX, centerY, centerZ, radius;
+    std::vector<float> axisX, axisY, axisZ, cutoff;
+    std::vector<GLsizei> counts;
+    std::vector<const void*> offsets;
+    std::vector<GLint> baseVertices;
+    MeshletCullStats stats;
+};
+
+inline void initMeshletCuller(MeshletCuller& culler, const GpuMesh& mesh) {
+    size_t padded = (mesh.meshlets.size() + 3) & ~(size_t)3;
+    std::vector<float>* columns[] = { &culler.centerX, &culler.centerY, &culler.centerZ, &culler.radius,
+                                      &culler.axisX, &culler.axisY, &culler.axisZ, &culler.cutoff };
+    for (int c = 0; c < 8; ++c)
+        columns[c]->assign(padded, 0.0f);
+    for (size_t i = 0; i < mesh.meshlets.size(); ++i) {
+        const Meshlet& m = mesh.meshlets[i];
+        culler.centerX[i] = m.center[0];
+        culler.centerY[i] = m.center[1];
+        culler.centerZ[i] = m.center[2];
+        culler.radius[i] = m.radius;
+        culler.axisX[i] = m.coneAxis[0];
+        culler.axisY[i] = m.coneAxis[1];
+        culler.axisZ[i] = m.coneAxis[2];
+        culler.cutoff[i] = m.coneCutoff;
+    }
+    culler.stats = MeshletCullStats();
+}
+
+// Frustum planes (a, b, c, d with ax + by + cz + d >= 0 inside) from a
+// column-major clip matrix, normalised so d is a distance
+inline void extractFrustumPlanes(const float* m, float planes[6][4]) {
+    for (int p = 0; p < 6; ++p) {
+        int row = p / 2;
+        float sign = (p % 2) ? -1.0f : 1.0f;
+        for (int k = 0; k < 4; ++k)
+            planes[p][k] = m[k * 4 + 3] + sign * m[k * 4 + row];
+        float length = sqrtf(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+        for (int k = 0; k < 4; ++k)
+            planes[p][k] /= length;
+    }
+}
+
+// Culls meshlets [first, first + count) of `mesh` and leaves the surviving
+// index ranges in culler.counts/offsets/baseVertices
+inline void cullMeshlets(MeshletCuller& culler, const GpuMesh& mesh, size_t first, size_t count,
+                         const float* modelViewProjection, const float eye[3]) {
+    float planes[6][4];
+    extractFrustumPlanes(modelViewProjection, planes);
+    culler.counts.clear();
+    culler.offsets.clear();
+    culler.baseVertices.clear();
+    MeshletCullStats stats = {};
+    stats.meshlets = count;
+    const unsigned int indexSize = meshIndexSize(mesh.indexType);
+    uint32_t lastEnd = 0;
+    int32_t lastBase = 0;
+
+    // Start at a multiple of four so the SoA loads stay aligned to groups
+    size_t groupStart = first & ~(size_t)3;
+    for (size_t g = groupStart; g < first + count; g += 4) {
+        int inside, facing;
+#ifdef MESHLET_SSE
+        __m128 cx = _mm_loadu_ps(&culler.centerX[g]);
+        __m128 cy = _mm_loadu_ps(&culler.centerY[g]);
+        __m128 cz = _mm_loadu_ps(&culler.centerZ[g]);
+        __m128 r = _mm_loadu_ps(&culler.radius[g]);
+        __m128 negR = _mm_sub_ps(_mm_setzero_ps(), r);
+        __m128 in = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p) {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(planes[p][0])), _mm_mul_ps(cy, _mm_set1_ps(planes[p][1]))),
+                                  _mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(planes[p][2])), _mm_set1_ps(planes[p][3])));
+            in = _mm_and_ps(in, _mm_cmpge_ps(d, negR));
+        }
+        __m128 dx = _mm_sub_ps(cx, _mm_set1_ps(eye[0]));
+        __m128 dy = _mm_sub_ps(cy, _mm_set1_ps(eye[1]));
+        __m128 dz = _mm_sub_ps(cz, _mm_set1_ps(eye[2]));
+        __m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+        __m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, _mm_loadu_ps(&culler.axisX[g])), _mm_mul_ps(dy, _mm_loadu_ps(&culler.axisY[g]))),
+                                  _mm_mul_ps(dz, _mm_loadu_ps(&culler.axisZ[g])));
+        __m128 limit = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&culler.cutoff[g]), distance), r);
+        inside = _mm_movemask_ps(in);
+        facing = ~_mm_movemask_ps(_mm_cmpge_ps(along, limit)) & 15;
+#else
+        inside = facing = 0;
+        for (int k = 0; k < 4; ++k) {
+            size_t i = g + k;
+            bool in = true;
+            for (int p = 0; p < 6; ++p)
+                in = in && culler.centerX[i] * planes[p][0] + culler.centerY[i] * planes[p][1]
+                         + culler.centerZ[i] * planes[p][2] + planes[p][3] >= -culler.radius[i];
+            float dx = culler.centerX[i] - eye[0], dy = culler.centerY[i] - eye[1], dz = culler.centerZ[i] - eye[2];
+            float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+            bool back = dx * culler.axisX[i] + dy * culler.axisY[i] + dz * culler.axisZ[i]
+                        >= culler.cutoff[i] * distance + culler.radius[i];
+            inside |= in << k;
+            facing |= !back << k;
+        }
+#endif
+        for (int k = 0; k < 4; ++k) {
+            size_t i = g + k;
+            if (i < first || i >= first + count)
+                continue;
+            const Meshlet& m = mesh.meshlets[i];
+            stats.triangles += m.indexCount / 3;
+            if (!(inside >> k & 1)) {
+                ++stats.frustumCulled;
+                continue;
+            }
+            if (!(facing >> k & 1)) {
+                ++stats.backfaceCulled;
+                continue;
+            }
+            ++stats.visibleMeshlets;
+            stats.visibleTriangles += m.indexCount / 3;
+            // Neighbouring survivors in the same batch extend the previous range
+            if (!culler.counts.empty() && m.firstIndex == lastEnd && m.baseVertex == lastBase) {
+                culler.counts.back() += m.indexCount;
+            } else {
+                culler.counts.push_back(m.indexCount);
+                culler.offsets.push_back((const void*)(uintptr_t)(m.firstIndex * indexSize));
+                culler.baseVertices.push_back(m.baseVertex);
+            }
+            lastEnd = m.firstIndex + m.indexCount;
+            lastBase = m.baseVertex;
+        }
+    }
+    stats.draws = culler.counts.size();
+    culler.stats = stats;
+}
+
+// Draws what the last cullMeshlets call left visible
+inline void drawCulledMeshlets(const MeshletCuller& culler, const GpuMesh& mesh, GLenum mode = GL_TRIANGLES) {
+    if (culler.counts.empty())
+        return;
+    glBindVertexArray(mesh.VAO);
+    glMultiDrawElementsBaseVertex(mode, culler.counts.data(), mesh.indexType,
+                                  (const void* const*)culler.offsets.data(), culler.counts.size(),
+                                  (GLint*)culler.baseVertices.data());
+}
+
+#endif
@@ -0,0 +1,259 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include "meshImport.h"
+#include "meshFile.h"
+#include "frameStats.h"
+#include "objectConstants.h"
+
+// Loads an OBJ or binary PLY model given on the command line and spins it in
+// front of the camera, for testing vertex throughput with real data.
+//
+// Usage: ./modelDemo path/to/model.obj
+
+const char* vertexShaderSource = R"glsl(
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+
+uniform mat4 mvp;           // per-object constants, see objectConstants.h
+uniform mat4 model;
+uniform mat3 normalMatrix;
+uniform vec3 positionScale;  // packed vertex decode, see vertexCompress.h
+uniform vec3 positionBias;
+uniform bool octahedralNormals;
+
+out vec3 FragPos;
+out vec3 Normal;
+
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+void main()
+{
+    vec3 normal = octahedralNormals ? decodeOctahedral(aNormal.xy) : aNormal;
+    vec4 position = vec4(aPos * positionScale + positionBias, 1.0);
+    FragPos = vec3(model * position);
+    Normal = normalMatrix * normal;
+    gl_Position = mvp * position;
+}
+)glsl";
+
+const char* fragmentShaderSource = R"glsl(
+#version 330 core
+out vec4 FragColor;
+
+in vec3 FragPos;
+in vec3 Normal;
+
+uniform vec3 lightPos;
+uniform bool hasNormals;
+
+void main()
+{
+    // Models without normals get flat face normals from the screen-space derivatives
+    vec3 norm = hasNormals ? normalize(Normal) : normalize(cross(dFdx(FragPos), dFdy(FragPos)));
+    vec3 lightDir = normalize(lightPos - FragPos);
+    float diff = abs(dot(norm, lightDir));
+    vec3 color = vec3(0.8, 0.8, 0.85);
+    FragColor = vec4((0.25 + 0.75 * diff) * color, 1.0);
+}
+)glsl";
+
+const unsigned int SCR_WIDTH = 800;
+const unsigned int SCR_HEIGHT = 600;
+
+bool useMeshletCulling = true; // C toggles per-meshlet frustum and backface culling
+bool cullKeyWasPressed = false;
+
+// Camera, placed from the model bounds once it is loaded
+glm::vec3 cameraPos   = glm::vec3(0.0f, 0.0f, 3.0f);
+glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
+glm::vec3 cameraUp    = glm::vec3(0.0f, 1.0f, 0.0f);
+float cameraSpeedScale = 1.0f;
+float fov = 45.0f;
+
+// Timing
+float deltaTime = 0.0f;
+float lastFrame = 0.0f;
+
+void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
+    glViewport(0, 0, width, height);
+}
+
+void processInput(GLFWwindow *window) {
+    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, true);
+
+    float cameraSpeed = 2.5f * cameraSpeedScale * deltaTime;
+    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+        cameraPos += cameraSpeed * cameraFront;
+    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+        cameraPos -= cameraSpeed * cameraFront;
+    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+        cameraPos -= glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
+    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+        cameraPos += glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
+
+    bool cullKeyPressed = glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS;
+    if (cullKeyPressed && !cullKeyWasPressed) {
+        useMeshletCulling = !useMeshletCulling;
+        std::cout << (useMeshletCulling ? "Meshlet culling on" : "Meshlet culling off") << std::endl;
+    }
+    cullKeyWasPressed = cullKeyPressed;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cout << "Usage: " << argv[0] << " model.obj|model.ply" << std::endl;
+        return -1;
+    }
+
+    // Parse before opening the window so the import timing is not disturbed
+    MeshData data;
+    MeshImportStats importStats;
+    if (!importMesh(argv[1], data, &importStats))
+        return -1;
+    bool hasNormals = data.layout.size() > 1 && data.layout[1].location == 1;
+
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Model Demo", NULL, NULL);
+    if (window == NULL) {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return -1;
+    }
+    installGLStateCache();
+
+    // Same path as the built-in shapes
+    prepareMesh(data, argv[1]);
+    GpuMesh mesh = uploadMesh(data, argv[1]);
+    size_t triangles = data.indices.size() / 3;
+    data = MeshData();
+    MeshletCuller culler;
+    initMeshletCuller(culler, mesh);
+
+    unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
+    glCompileShader(vertexShader);
+    int success;
+    char infoLog[512];
+    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+    }
+
+    unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
+    glCompileShader(fragmentShader);
+    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+    }
+
+    unsigned int shaderProgram = glCreateProgram();
+    glAttachShader(shaderProgram, vertexShader);
+    glAttachShader(shaderProgram, fragmentShader);
+    glLinkProgram(shaderProgram);
+    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+    if (!success) {
+        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+    }
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    // Frame the model: look at its bounding sphere from 2.5 radii away
+    glm::vec3 center(mesh.bounds.center[0], mesh.bounds.center[1], mesh.bounds.center[2]);
+    float radius = mesh.bounds.radius > 0.0f ? mesh.bounds.radius : 1.0f;
+    cameraPos = center + glm::vec3(0.0f, 0.0f, 2.5f * radius);
+    cameraSpeedScale = radius;
+
+    glEnable(GL_DEPTH_TEST);
+
+    FrameStats frameStats;
+    initFrameStats(frameStats, "Model Demo");
+    std::ostringstream importInfo;
+    importInfo << triangles << " triangles, imported at " << std::fixed << std::setprecision(0)
+               << importStats.megabytesPerSecond << " MB/s";
+
+    while (!glfwWindowShouldClose(window)) {
+        float currentFrame = glfwGetTime();
+        deltaTime = currentFrame - lastFrame;
+        lastFrame = currentFrame;
+
+        processInput(window);
+
+        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glUseProgram(shaderProgram);
+        setMeshDecodeUniforms(shaderProgram, mesh);
+
+        // Spin the model about its own center
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), center);
+        model = glm::rotate(model, currentFrame * 0.5f, glm::vec3(0.0f, 1.0f, 0.0f));
+        model = glm::translate(model, -center);
+        glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
+        glm::mat4 projection = glm::perspective(glm::radians(fov), (float)SCR_WIDTH / (float)SCR_HEIGHT,
+                                                0.01f * radius, 100.0f * radius);
+        glm::mat4 viewProjection = projection * view;
+        ObjectConstants constants = computeObjectConstants(glm::value_ptr(viewProjection), glm::value_ptr(model));
+        setObjectConstantUniforms(shaderProgram, constants);
+        glUniform3fv(glGetUniformLocation(shaderProgram, "lightPos"), 1, &cameraPos[0]);
+        glUniform1i(glGetUniformLocation(shaderProgram, "hasNormals"), hasNormals);
+
+        bool culled = useMeshletCulling && !mesh.meshlets.empty();
+        if (culled) {
+            glm::vec3 eye = glm::vec3(glm::inverse(model) * glm::vec4(cameraPos, 1.0f));
+            cullMeshlets(culler, mesh, 0, mesh.meshlets.size(), constants.mvp, &eye[0]);
+        }
+
+        beginGpuTimer(frameStats);
+        if (culled)
+            drawCulledMeshlets(culler, mesh);
+        else
+            drawMesh(mesh);
+        endGpuTimer(frameStats);
+
+        std::ostringstream hud;
+        hud << importInfo.str();
+        if (culled)
+            hud << ", " << (int)(meshletCulledTriangleRatio(culler.stats) * 100.0f + 0.5f) << "% triangles culled, "
+                << culler.stats.draws << " ranges";
+        frameStats.hud = hud.str();
+        updateFrameStats(frameStats, window, deltaTime);
+
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+    }
+
+    destroyFrameStats(frameStats);
+    destroyMesh(mesh);
+    glDeleteProgram(shaderProgram);
+
+    glfwTerminate();
+    return 0;
+}
@@ -0,0 +1,94 @@
+#ifndef OBJECT_CONSTANTS_H
+#define OBJECT_CONSTANTS_H
+
+#include <glad/glad.h>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define OBJECT_CONSTANTS_SSE 1
+#endif
+
+// Per-object shader constants worked out once on the CPU instead of once per
+// vertex. The demos used to send model, view and projection separately and
+// multiply them together for every vertex, and advCubeDemo inverted the
+// model matrix per vertex to get its normal matrix. Here each object gets its
+// projection * view * model and the inverse transpose of its model matrix's
+// upper 3x3 ahead of the draw; the vertex shader only applies them.
+//
+// computeObjectConstants takes a whole array of model matrices so a scene with
+// many objects prepares them in one pass. Matrices are column-major, as GL
+// and glm store them.
+
+struct ObjectConstants {
+    float mvp[16];          // projection * view * model
+    float model[16];
+    float normalMatrix[9];  // mat3(transpose(inverse(model)))
+};
+
+// out = a * b, all column-major 4x4. out must not alias a or b.
+inline void multiplyMatrices4(const float* a, const float* b, float* out) {
+#ifdef OBJECT_CONSTANTS_SSE
+    __m128 a0 = _mm_loadu_ps(a), a1 = _mm_loadu_ps(a + 4), a2 = _mm_loadu_ps(a + 8), a3 = _mm_loadu_ps(a + 12);
+    for (int j = 0; j < 4; ++j) {
+        // Column j of the product is a's columns weighted by column j of b
+        __m128 column = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(b[j * 4 + 0])), _mm_mul_ps(a1, _mm_set1_ps(b[j * 4 + 1]))),
+                                   _mm_add_ps(_mm_mul_ps(a2, _mm_set1_ps(b[j * 4 + 2])), _mm_mul_ps(a3, _mm_set1_ps(b[j * 4 + 3]))));
+        _mm_storeu_ps(out + j * 4, column);
+    }
+#else
+    for (int j = 0; j < 4; ++j)
+        for (int i = 0; i < 4; ++i)
+            out[j * 4 + i] = a[i] * b[j * 4] + a[4 + i] * b[j * 4 + 1] + a[8 + i] * b[j * 4 + 2] + a[12 + i] * b[j * 4 + 3];
+#endif
+}
+
+// Inverse transpose of the upper 3x3 of a column-major 4x4. With columns a, b,
+// c its columns are b x c, c x a and a x b over the determinant. A singular
+// matrix gives the identity.
+inline void normalMatrixFromModel(const float* m, float* out) {
+    const float* a = m;
+    const float* b = m + 4;
+    const float* c = m + 8;
+    float r[9] = {
+        b[1] * c[2] - b[2] * c[1], b[2] * c[0] - b[0] * c[2], b[0] * c[1] - b[1] * c[0],
+        c[1] * a[2] - c[2] * a[1], c[2] * a[0] - c[0] * a[2], c[0] * a[1] - c[1] * a[0],
+        a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0],
+    };
+    float det = a[0] * r[0] + a[1] * r[1] + a[2] * r[2];
+    if (fabsf(det) < 1e-30f) {
+        const float identity[9] = { 1, 0, 0, 0, 1, 0, 0, 0, 1 };
+        memcpy(out, identity, sizeof(identity));
+        return;
+    }
+    float invDet = 1.0f / det;
+    for (int i = 0; i < 9; ++i)
+        out[i] = r[i] * invDet;
+}
+
+// Fills out[i] from models + 16 * i for `count` objects
+inline void computeObjectConstants(const float* viewProjection, const float* models, size_t count, ObjectConstants* out) {
+    for (size_t i = 0; i < count; ++i) {
+        const float* model = models + 16 * i;
+        memcpy(out[i].model, model, sizeof(out[i].model));
+        multiplyMatrices4(viewProjection, model, out[i].mvp);
+        normalMatrixFromModel(model, out[i].normalMatrix);
+    }
+}
+
+inline ObjectConstants computeObjectConstants(const float* viewProjection, const float* model) {
+    ObjectConstants constants;
+    computeObjectConstants(viewProjection, model, 1, &constants);
+    return constants;
+}
+
+// Sets the mvp, model and normalMatrix uniforms of the bound program (any the
+// program does not use are ignored)
+inline void setObjectConstantUniforms(GLuint program, const ObjectConstants& constants) {
+    glUniformMatrix4fv(glGetUniformLocation(program, "mvp"), 1, GL_FALSE, constants.mvp);
+    glUniformMatrix4fv(glGetUniformLocation(program, "model"), 1, GL_FALSE, constants.model);
+    glUniformMatrix3fv(glGetUniformLocation(program, "normalMatrix"), 1, GL_FALSE, constants.normalMatrix);
+}
+
+#endif
@@ -0,0 +1,425 @@
+#ifndef OCCLUSION_CULL_H
+#define OCCLUSION_CULL_H
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "shaderUtil.h"
+#include "geometryArena.h"
+
+// Two-phase hierarchical-Z occlusion culling for instanced geometry arena
+// scenes, run entirely on the GPU (needs GL 4.3: compute shaders, storage
+// buffers and multi-draw indirect).
+//
+// Every frame:
+//   1. Early cull: a compute shader picks the objects that were visible last
+//      frame and are inside the frustum, copies their instance records into
+//      the drawn buffer and counts them into the early indirect commands.
+//   2. Early draw: one glMultiDrawElementsIndirect over those commands.
+//   3. Hi-Z: the depth buffer is reduced into a max-depth mip pyramid.
+//   4. Late cull: every object's box is projected to the screen and compared
+//      against the pyramid level where it covers at most 2x2 texels. The
+//      result becomes next frame's visibility, and objects that are visible
+//      but were not drawn early go into the late commands.
+//   5. Late draw: whatever was newly revealed.
+//
+// Objects drawn in the early pass are in the depth buffer the pyramid is built
+// from, so they cannot hide themselves. The scene renders into the culler's
+// own framebuffer (the default one's depth cannot be sampled); blit it to the
+// window at the end of the frame.
+//
+// Instance records are read as 32-bit words and must start with the object
+// center (xyz) and its scale. Objects are grouped by mesh; each group gives
+// the mesh's bounding radius around its origin at scale 1, and boundsPadding
+// is added to every box for motion the vertex shader adds.
+
+const int OCCLUSION_MAX_GROUPS = 8;
+const int OCCLUSION_EARLY = 0;
+const int OCCLUSION_LATE = 1;
+
+const char* const occlusionCullShaderSource = R"glsl(
+#version 430 core
+layout (local_size_x = 64) in;
+
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout (std430, binding = 0) readonly buffer Objects { uint objects[]; };
+layout (std430, binding = 1) writeonly buffer Drawn { uint drawn[]; };
+layout (std430, binding = 2) buffer Visibility { uint visibility[]; };
+layout (std430, binding = 3) buffer Commands { DrawCommand commands[]; };
+layout (std430, binding = 4) buffer Stats { uint stats[]; };  // in frustum, occluded, early, late
+
+uniform uint objectCount;
+uniform uint recordWords;
+uniform int groupCount;
+uniform uint groupEnd[8];  // one past each group's last object
+uniform float groupRadius[8];
+uniform vec3 boundsPadding;
+uniform mat4 viewProjection;
+uniform bool latePass;
+uniform sampler2D hiZ;
+uniform vec2 screenSize;
+uniform int hiZLevels;
+
+// True when the farthest depth the pyramid holds under the box's screen
+// rectangle is still nearer than the box
+bool hiZOccluded(vec3 ndcMin, vec3 ndcMax)
+{
+    vec2 pixelMin = clamp((ndcMin.xy * 0.5 + 0.5) * screenSize, vec2(0.0), screenSize - 1.0);
+    vec2 pixelMax = clamp((ndcMax.xy * 0.5 + 0.5) * screenSize, vec2(0.0), screenSize - 1.0);
+    float size = max(pixelMax.x - pixelMin.x, pixelMax.y - pixelMin.y);
+    int level = clamp(int(ceil(log2(max(size, 1.0)))), 0, hiZLevels - 1);
+    ivec2 t0 = ivec2(pixelMin) >> level;
+    ivec2 t1 = ivec2(pixelMax) >> level;
+    float farthest = 0.0;
+    for (int y = t0.y; y <= t1.y; ++y)
+        for (int x = t0.x; x <= t1.x; ++x)
+            farthest = max(farthest, texelFetch(hiZ, ivec2(x, y), level).r);
+    return ndcMin.z * 0.5 + 0.5 > farthest;
+}
+
+void emit(uint object, uint command)
+{
+    uint slot = commands[command].baseInstance + atomicAdd(commands[command].instanceCount, 1u);
+    for (uint w = 0u; w < recordWords; ++w)
+        drawn[slot * recordWords + w] = objects[object * recordWords + w];
+}
+
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= objectCount)
+        return;
+    uint base = i * recordWords;
+    vec3 center = uintBitsToFloat(uvec3(objects[base], objects[base + 1u], objects[base + 2u]));
+    float scale = uintBitsToFloat(objects[base + 3u]);
+    int group = 0;
+    while (group < groupCount - 1 && i >= groupEnd[group])
+        ++group;
+    vec3 extent = vec3(groupRadius[group] * scale) + boundsPadding;
+
+    // The box is outside if all eight corners are outside one clip plane
+    uint outside = 63u;
+    bool crossesEye = false;
+    vec3 ndcMin = vec3(1.0), ndcMax = vec3(-1.0);
+    for (int c = 0; c < 8; ++c) {
+        vec3 corner = center + extent * vec3((c & 1) != 0 ? 1.0 : -1.0, (c & 2) != 0 ? 1.0 : -1.0, (c & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = viewProjection * vec4(corner, 1.0);
+        uint o = uint(clip.x < -clip.w) | uint(clip.x > clip.w) << 1 | uint(clip.y < -clip.w) << 2
+               | uint(clip.y > clip.w) << 3 | uint(clip.z < -clip.w) << 4 | uint(clip.z > clip.w) << 5;
+        outside &= o;
+        if (clip.w <= 0.0) {
+            crossesEye = true;
+        } else {
+            vec3 ndc = clip.xyz / clip.w;
+            ndcMin = min(ndcMin, ndc);
+            ndcMax = max(ndcMax, ndc);
+        }
+    }
+    bool inFrustum = outside == 0u;
+
+    if (!latePass) {
+        if (inFrustum && visibility[i] != 0u) {
+            emit(i, uint(group));
+            atomicAdd(stats[2], 1u);
+        }
+        return;
+    }
+
+    bool visible = inFrustum;
+    if (inFrustum) {
+        atomicAdd(stats[0], 1u);
+        // A box reaching behind the eye has no screen rectangle, keep it
+        if (!crossesEye && hiZOccluded(ndcMin, ndcMax)) {
+            visible = false;
+            atomicAdd(stats[1], 1u);
+        }
+    }
+    if (visible && visibility[i] == 0u) {
+        emit(i, uint(groupCount + group));
+        atomicAdd(stats[3], 1u);
+    }
+    visibility[i] = visible ? 1u : 0u;
+}
+)glsl";
+
+// Max-depth reduction. With sourceLevel < 0 it copies the depth buffer into
+// level 0, writing 0 (no occlusion) past the screen edge; otherwise each texel
+// takes the farthest of the 2x2 below it.
+const char* const hiZPyramidShaderSource = R"glsl(
+#version 430 core
+layout (local_size_x = 8, local_size_y = 8) in;
+layout (r32f, binding = 0) writeonly uniform image2D destination;
+uniform sampler2D source;
+uniform int sourceLevel;
+uniform ivec2 sourceSize;
+void main()
+{
+    ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(p, imageSize(destination))))
+        return;
+    float depth = 0.0;
+    if (sourceLevel < 0) {
+        if (all(lessThan(p, sourceSize)))
+            depth = texelFetch(source, p, 0).r;
+    } else {
+        for (int y = 0; y < 2; ++y)
+            for (int x = 0; x < 2; ++x)
+                depth = max(depth, texelFetch(source, min(p * 2 + ivec2(x, y), sourceSize - 1), sourceLevel).r);
+    }
+    imageStore(destination, p, vec4(depth));
+}
+)glsl";
+
+struct OcclusionCullStats {
+    size_t objects;
+    size_t inFrustum;
+    size_t occluded;
+    size_t earlyDrawn;
+    size_t lateDrawn;
+    size_t triangles;
+};
+
+struct OcclusionCuller {
+    GLuint cullProgram, pyramidProgram;
+    // Render target the pyramid is built from
+    GLuint framebuffer, colorBuffer, depthTexture;
+    int width, height;
+    // Pyramid: power-of-two sized so every level halves exactly and texel
+    // (x, y) of level L covers pixels [x, x + 1) * 2^L
+    GLuint hiZ;
+    int hiZWidth, hiZHeight, hiZLevels;
+    // Per-object buffers
+    GLuint drawnBuffer;       // early records, then late records from objectCount on
+    GLuint visibilityBuffer;  // one uint per object, last frame's result
+    GLuint commandBuffer;     // groupCount early commands, then groupCount late ones
+    GLuint statsBuffer;
+    size_t objectCount;
+    unsigned int recordWords;
+    int groupCount;
+    GLuint groupEnd[OCCLUSION_MAX_GROUPS];
+    float groupRadius[OCCLUSION_MAX_GROUPS];
+    std::vector<DrawElementsIndirectCommand> commandTemplate;
+    OcclusionCullStats stats;
+};
+
+inline bool occlusionCullSupported() {
+    return GLAD_GL_ARB_compute_shader && GLAD_GL_ARB_shader_storage_buffer_object
+        && GLAD_GL_ARB_shader_image_load_store && GLAD_GL_ARB_texture_storage && arenaIndirectSupported();
+}
+
+// Returns false if the shaders did not build
+inline bool initOcclusionCuller(OcclusionCuller& c) {
+    c = OcclusionCuller();
+    c.cullProgram = createComputeProgram(occlusionCullShaderSource);
+    c.pyramidProgram = createComputeProgram(hiZPyramidShaderSource);
+    glGenFramebuffers(1, &c.framebuffer);
+    GLuint* buffers[] = { &c.drawnBuffer, &c.visibilityBuffer, &c.commandBuffer, &c.statsBuffer };
+    for (int i = 0; i < 4; ++i)
+        glGenBuffers(1, buffers[i]);
+    return c.cullProgram && c.pyramidProgram;
+}
+
+// (Re)creates the render target and pyramid when the framebuffer size changes
+inline void resizeOcclusionTargets(OcclusionCuller& c, int width, int height) {
+    if (width == c.width && height == c.height)
+        return;
+    glDeleteRenderbuffers(1, &c.colorBuffer);
+    glDeleteTextures(1, &c.depthTexture);
+    glDeleteTextures(1, &c.hiZ);
+    c.width = width;
+    c.height = height;
+
+    glGenRenderbuffers(1, &c.colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, c.colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glGenTextures(1, &c.depthTexture);
+    glBindTexture(GL_TEXTURE_2D, c.depthTexture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, c.framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, c.colorBuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, c.depthTexture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::FRAMEBUFFER::OCCLUSION::NOT_COMPLETE" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    c.hiZWidth = c.hiZHeight = 1;
+    while (c.hiZWidth < width)
+        c.hiZWidth *= 2;
+    while (c.hiZHeight < height)
+        c.hiZHeight *= 2;
+    c.hiZLevels = 1;
+    while ((std::max(c.hiZWidth, c.hiZHeight) >> c.hiZLevels) > 0)
+        ++c.hiZLevels;
+    glGenTextures(1, &c.hiZ);
+    glBindTexture(GL_TEXTURE_2D, c.hiZ);
+    glTexStorage2D(GL_TEXTURE_2D, c.hiZLevels, GL_R32F, c.hiZWidth, c.hiZHeight);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// Sets up the object groups: group g is objects [first[g], first[g] + count[g])
+// drawn with arena mesh meshes[g] at `lod`. Instance records are recordBytes
+// long. Forgets last frame's visibility, so the next frame draws everything in
+// the late pass.
+inline void setOcclusionObjects(OcclusionCuller& c, const GeometryArena& arena, size_t objectCount, size_t recordBytes,
+                                const int* meshes, const size_t* first, const size_t* count, const float* radius,
+                                int groupCount, unsigned int lod) {
+    c.objectCount = objectCount;
+    c.recordWords = (unsigned int)(recordBytes / 4);
+    c.groupCount = std::min(groupCount, OCCLUSION_MAX_GROUPS);
+    c.commandTemplate.resize(c.groupCount * 2);
+    for (int g = 0; g < c.groupCount; ++g) {
+        c.groupEnd[g] = (GLuint)(first[g] + count[g]);
+        c.groupRadius[g] = radius[g];
+        c.commandTemplate[g] = arenaDrawCommand(arena, meshes[g], lod, 0, (uint32_t)first[g]);
+        c.commandTemplate[c.groupCount + g] = arenaDrawCommand(arena, meshes[g], lod, 0, (uint32_t)(objectCount + first[g]));
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, c.drawnBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<size_t>(1, 2 * objectCount * recordBytes), NULL, GL_DYNAMIC_COPY);
+    std::vector<GLuint> zeros(std::max<size_t>(1, objectCount), 0);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, c.visibilityBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, zeros.size() * sizeof(GLuint), zeros.data(), GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, c.statsBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, 4 * sizeof(GLuint), NULL, GL_DYNAMIC_READ);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, c.commandBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, c.commandTemplate.size() * sizeof(DrawElementsIndirectCommand), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+// Resets this frame's commands and counters. Call before the early cull.
+inline void beginOcclusionFrame(OcclusionCuller& c) {
+    const GLuint zeros[4] = { 0, 0, 0, 0 };
+    // Last frame's cull shaders wrote both buffers
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, c.commandBuffer);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, c.commandTemplate.size() * sizeof(DrawElementsIndirectCommand),
+                    c.commandTemplate.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, c.statsBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zeros), zeros);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+// Runs the early or late cull over every object in objectBuffer.
+// viewProjection is column-major. Leaves the culler's program bound.
+inline void cullOcclusionPhase(OcclusionCuller& c, int phase, GLuint objectBuffer, const float* viewProjection,
+                               const float boundsPadding[3]) {
+    if (!c.objectCount)
+        return;
+    GLuint p = c.cullProgram;
+    glUseProgram(p);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, objectBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, c.drawnBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, c.visibilityBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, c.commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, c.statsBuffer);
+    glUniform1ui(glGetUniformLocation(p, "objectCount"), (GLuint)c.objectCount);
+    glUniform1ui(glGetUniformLocation(p, "recordWords"), c.recordWords);
+    glUniform1i(glGetUniformLocation(p, "groupCount"), c.groupCount);
+    glUniform1uiv(glGetUniformLocation(p, "groupEnd"), c.groupCount, c.groupEnd);
+    glUniform1fv(glGetUniformLocation(p, "groupRadius"), c.groupCount, c.groupRadius);
+    glUniform3fv(glGetUniformLocation(p, "boundsPadding"), 1, boundsPadding);
+    glUniformMatrix4fv(glGetUniformLocation(p, "viewProjection"), 1, GL_FALSE, viewProjection);
+    glUniform1i(glGetUniformLocation(p, "latePass"), phase == OCCLUSION_LATE);
+    glUniform2f(glGetUniformLocation(p, "screenSize"), (float)c.width, (float)c.height);
+    glUniform1i(glGetUniformLocation(p, "hiZLevels"), c.hiZLevels);
+    glUniform1i(glGetUniformLocation(p, "hiZ"), 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, c.hiZ);
+    glDispatchCompute((GLuint)((c.objectCount + 63) / 64), 1, 1);
+    // The commands and drawn records feed the next draw
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+// Draws one phase's commands. The arena VAO's instance attributes must point
+// at c.drawnBuffer from record 0.
+inline void drawOcclusionPhase(const OcclusionCuller& c, const GeometryArena& arena, int phase, GLenum mode = GL_TRIANGLES) {
+    if (!c.groupCount)
+        return;
+    glBindVertexArray(arena.VAO);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, c.commandBuffer);
+    glMultiDrawElementsIndirect(mode, arena.indexType,
+                                (const void*)(uintptr_t)(phase * c.groupCount * sizeof(DrawElementsIndirectCommand)),
+                                c.groupCount, 0);
+}
+
+// Reduces the depth the early pass left in c.framebuffer into the pyramid
+inline void buildHiZPyramid(OcclusionCuller& c) {
+    GLuint p = c.pyramidProgram;
+    glUseProgram(p);
+    glUniform1i(glGetUniformLocation(p, "source"), 0);
+    glActiveTexture(GL_TEXTURE0);
+    for (int level = 0; level < c.hiZLevels; ++level) {
+        int w = std::max(1, c.hiZWidth >> level), h = std::max(1, c.hiZHeight >> level);
+        if (level == 0) {
+            glBindTexture(GL_TEXTURE_2D, c.depthTexture);
+            glUniform2i(glGetUniformLocation(p, "sourceSize"), c.width, c.height);
+        } else {
+            glBindTexture(GL_TEXTURE_2D, c.hiZ);
+            glUniform2i(glGetUniformLocation(p, "sourceSize"), std::max(1, c.hiZWidth >> (level - 1)),
+                        std::max(1, c.hiZHeight >> (level - 1)));
+        }
+        glUniform1i(glGetUniformLocation(p, "sourceLevel"), level - 1);
+        glBindImageTexture(0, c.hiZ, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glDispatchCompute((w + 7) / 8, (h + 7) / 8, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// Copies the culler's color target to the window
+inline void blitOcclusionFramebuffer(const OcclusionCuller& c) {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, c.framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, c.width, c.height, 0, 0, c.width, c.height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+// Reads this frame's counters into c.stats. This waits for the GPU to finish
+// the frame, so call it now and then (once per stats report), not every frame.
+inline const OcclusionCullStats& readOcclusionStats(OcclusionCuller& c) {
+    GLuint counters[4] = { 0, 0, 0, 0 };
+    std::vector<DrawElementsIndirectCommand> commands(c.commandTemplate.size());
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, c.statsBuffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(counters), counters);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, c.commandBuffer);
+    if (!commands.empty())
+        glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+    c.stats.objects = c.objectCount;
+    c.stats.inFrustum = counters[0];
+    c.stats.occluded = counters[1];
+    c.stats.earlyDrawn = counters[2];
+    c.stats.lateDrawn = counters[3];
+    c.stats.triangles = 0;
+    for (size_t i = 0; i < commands.size(); ++i)
+        c.stats.triangles += (size_t)commands[i].count / 3 * commands[i].instanceCount;
+    return c.stats;
+}
+
+inline void destroyOcclusionCuller(OcclusionCuller& c) {
+    glDeleteProgram(c.cullProgram);
+    glDeleteProgram(c.pyramidProgram);
+    glDeleteFramebuffers(1, &c.framebuffer);
+    glDeleteRenderbuffers(1, &c.colorBuffer);
+    glDeleteTextures(1, &c.depthTexture);
+    glDeleteTextures(1, &c.hiZ);
+    GLuint buffers[] = { c.drawnBuffer, c.visibilityBuffer, c.commandBuffer, c.statsBuffer };
+    glDeleteBuffers(4, buffers);
+    c = OcclusionCuller();
+}
+
+#endif
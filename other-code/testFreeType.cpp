@@ -1,16 +1,25 @@
+#include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
 #include <map>
+#include <vector>
+#include <cstring>
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include "../shaderUtil.h"
+#include "../streamBuffer.h"
 
 const char* vertexShaderSource = R"glsl(
 #version 330 core
 layout (location = 0) in vec4 vertex; // {pos.x, pos.y, tex.x, tex.y}
 out vec2 TexCoords;
-uniform mat4 projection;
+layout (std140) uniform TextBlock {
+    mat4 projection;
+    vec4 textColor;
+};
 void main() {
     gl_Position = projection * vec4(vertex.xy, 0.0, 1.0);
     TexCoords = vertex.zw;
@@ -22,10 +31,13 @@ const char* fragmentShaderSource = R"glsl(
 in vec2 TexCoords;
 out vec4 color;
 uniform sampler2D text;
-uniform vec3 textColor;
+layout (std140) uniform TextBlock {
+    mat4 projection;
+    vec4 textColor;
+};
 void main() {    
     vec4 sampled = vec4(1.0, 1.0, 1.0, texture(text, TexCoords).r);
-    color = vec4(textColor, 1.0) * sampled;
+    color = vec4(textColor.rgb, 1.0) * sampled;
 }
 )glsl";
 
@@ -37,14 +49,38 @@ struct Character {
 };
 
 std::map<GLchar, Character> Characters;
-GLuint textVAO, textVBO;
+GLuint textVAO;
+
+// Glyph quads and the TextBlock uniforms are written straight into this
+// frame's part of the stream buffer (see streamBuffer.h) instead of being
+// pushed through glBufferSubData one glyph at a time
+StreamBuffer textStream;
+size_t uniformAlignment;
+
+struct TextBlock {
+    float projection[16];
+    float textColor[4];
+};
 
 void RenderText(GLuint shader, std::string text, GLfloat x, GLfloat y, GLfloat scale, glm::vec3 color) {
-    glUseProgram(shader);
-    glUniform3f(glGetUniformLocation(shader, "textColor"), color.x, color.y, color.z);
-    glActiveTexture(GL_TEXTURE0);
-    glBindVertexArray(textVAO);
+    StreamRange block = streamAllocate(textStream, sizeof(TextBlock), uniformAlignment);
+    StreamRange quads = streamAllocate(textStream, text.size() * 6 * 4 * sizeof(GLfloat), 4 * sizeof(GLfloat));
+    if (!block.data || !quads.data) {
+        std::cout << "ERROR::TEXT::STREAM_BUFFER_FULL" << std::endl;
+        return;
+    }
 
+    TextBlock* params = (TextBlock*)block.data;
+    glm::mat4 projection = glm::ortho(0.0f, 800.0f, 0.0f, 600.0f);
+    memcpy(params->projection, glm::value_ptr(projection), sizeof(params->projection));
+    params->textColor[0] = color.x;
+    params->textColor[1] = color.y;
+    params->textColor[2] = color.z;
+    params->textColor[3] = 1.0f;
+
+    // Every quad first, then one draw per glyph texture
+    GLfloat (*vertices)[4] = (GLfloat (*)[4])quads.data;
+    std::vector<GLuint> textures;
     for (auto c = text.begin(); c != text.end(); c++) {
         Character ch = Characters[*c];
 
@@ -53,7 +89,7 @@ void RenderText(GLuint shader, std::string text, GLfloat x, GLfloat y, GLfloat s
         GLfloat w = ch.Size.x * scale;
         GLfloat h = ch.Size.y * scale;
 
-        GLfloat vertices[6][4] = {
+        GLfloat quad[6][4] = {
             { xpos,     ypos + h,   0.0, 0.0 },            
             { xpos,     ypos,       0.0, 1.0 },
             { xpos + w, ypos,       1.0, 1.0 },
@@ -62,24 +98,42 @@ void RenderText(GLuint shader, std::string text, GLfloat x, GLfloat y, GLfloat s
             { xpos + w, ypos,       1.0, 1.0 },
             { xpos + w, ypos + h,   1.0, 0.0 }
         };
-
-        glBindTexture(GL_TEXTURE_2D, ch.TextureID);
-        glBindBuffer(GL_ARRAY_BUFFER, textVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+        memcpy(vertices, quad, sizeof(quad));
+        vertices += 6;
+        textures.push_back(ch.TextureID);
         x += (ch.Advance >> 6) * scale;
     }
+    flushStreamBuffer(textStream);
+
+    glUseProgram(shader);
+    glBindBufferRange(GL_UNIFORM_BUFFER, 0, textStream.buffer, block.offset, sizeof(TextBlock));
+    glActiveTexture(GL_TEXTURE0);
+    glBindVertexArray(textVAO);
+    GLint first = (GLint)(quads.offset / (4 * sizeof(GLfloat)));
+    for (size_t i = 0; i < textures.size(); ++i) {
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        glDrawArrays(GL_TRIANGLES, first + (GLint)i * 6, 6);
+    }
     glBindVertexArray(0);
     glBindTexture(GL_TEXTURE_2D, 0);
 }
 
+void processInput(GLFWwindow* window) {
+    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, true);
+}
+
 int main() {
     glfwInit();
     GLFWwindow* window = glfwCreateWindow(800, 600, "OpenGL Window", NULL, NULL);
     glfwMakeContextCurrent(window);
     glfwSwapInterval(1); // Enable vsync
 
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return -1;
+    }
+
     // Initialize FreeType
     FT_Library ft;
     if (FT_Init_FreeType(&ft)) {
@@ -132,30 +186,35 @@ int main() {
     FT_Done_Face(face);
     FT_Done_FreeType(ft);
 
-    // Configure VAO/VBO for texture quads
+    // Configure the VAO for texture quads, read from the stream buffer.
+    // 64 KB a frame is about 600 glyphs.
+    initStreamBuffer(textStream, 64 * 1024);
+    uniformAlignment = streamUniformAlignment();
     glGenVertexArrays(1, &textVAO);
-    glGenBuffers(1, &textVBO);
     glBindVertexArray(textVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, textVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, textStream.buffer);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), 0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 
-    GLuint textShader = LoadShaders(vertexShaderSource, fragmentShaderSource); // Assume LoadShaders is a function you've defined somewhere
+    GLuint textShader = createShaderProgram(vertexShaderSource, fragmentShaderSource);
+    glUniformBlockBinding(textShader, glGetUniformBlockIndex(textShader, "TextBlock"), 0);
 
     while (!glfwWindowShouldClose(window)) {
         processInput(window); // Function to handle input
         glClearColor(0.3f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
 
+        beginStreamFrame(textStream);
         RenderText(textShader, "This is sample text", 25.0f, 25.0f, 1.0f, glm::vec3(0.5, 0.8f, 0.2f));
+        endStreamFrame(textStream);
 
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
+    destroyStreamBuffer(textStream);
     glfwTerminate();
     return 0;
 }
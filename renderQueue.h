@@ -0,0 +1,188 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// A per-frame list of draws that is sorted before it is issued, so draws
+// sharing a program, texture and VAO end up next to each other and each
+// binding is only made when it actually changes.
+//
+// Every item carries a 64-bit key, compared as an unsigned integer:
+//
+//   opaque   | pass:4 | blend:2 | program:10 | texture:12 | vao:12 | depth:24       |
+//   blended  | pass:4 | blend:2 | far-to-near depth:24 | program:10 | texture:12 | vao:12 |
+//
+// Passes run in order, opaque items of a pass before its blended ones.
+// Opaque items are grouped by state and drawn front to back inside a group,
+// so early depth testing rejects what is hidden; blended items ignore state
+// and go back to front, which they need to composite correctly. The object
+// names are truncated to their fields: two names that collide only cost a
+// rebind, the item still draws with its own. The keys are sorted with a
+// radix sort, 8 bits per pass, skipping the digits every key shares.
+
+enum RenderBlend { RENDER_OPAQUE, RENDER_ALPHA_BLEND };
+
+struct RenderItem {
+    uint64_t key;
+    GLuint program, texture, vao;  // texture is bound to unit 0, 0 for none
+    RenderBlend blend;
+    GLenum mode;
+    GLsizei count;
+    GLenum indexType;   // 0 for glDrawArrays
+    GLintptr first;     // first vertex, or byte offset into the index buffer
+    // Optional: called with the item's state bound instead of the plain draw
+    // above, to set per-item uniforms and draw, e.g. a whole GpuMesh
+    void (*draw)(GLuint program, const void* data, size_t index);
+    const void* data;
+    size_t index;
+};
+
+struct RenderQueueStats {
+    size_t items;
+    size_t programBinds, textureBinds, vaoBinds, blendChanges;
+};
+
+struct RenderSortEntry {
+    uint64_t key;
+    uint32_t item;
+};
+
+struct RenderQueue {
+    std::vector<RenderItem> items;
+    std::vector<RenderSortEntry> order, scratch;
+    RenderQueueStats stats;
+};
+
+// depth is 0 at the camera and 1 at the far end of whatever range the
+// caller picks; values outside are clamped
+inline uint64_t makeRenderKey(unsigned int pass, RenderBlend blend, GLuint program, GLuint texture, GLuint vao, float depth) {
+    depth = depth < 0.0f ? 0.0f : (depth > 1.0f ? 1.0f : depth);
+    uint64_t d = (uint64_t)(depth * 16777215.0f);
+    uint64_t key = (uint64_t)(pass & 0xF) << 60 | (uint64_t)(blend & 0x3) << 58;
+    if (blend == RENDER_OPAQUE)
+        return key | (uint64_t)(program & 0x3FF) << 48 | (uint64_t)(texture & 0xFFF) << 36 | (uint64_t)(vao & 0xFFF) << 24 | d;
+    return key | (0xFFFFFF - d) << 34 | (uint64_t)(program & 0x3FF) << 24 | (uint64_t)(texture & 0xFFF) << 12 | (vao & 0xFFF);
+}
+
+// A plain glDrawArrays (indexType 0) or glDrawElements item
+inline RenderItem makeRenderItem(uint64_t key, GLuint program, GLuint texture, GLuint vao, RenderBlend blend, GLenum mode,
+                                 GLsizei count, GLenum indexType = 0, GLintptr first = 0) {
+    RenderItem item;
+    memset(&item, 0, sizeof(item));
+    item.key = key;
+    item.program = program;
+    item.texture = texture;
+    item.vao = vao;
+    item.blend = blend;
+    item.mode = mode;
+    item.count = count;
+    item.indexType = indexType;
+    item.first = first;
+    return item;
+}
+
+inline void clearRenderQueue(RenderQueue& q) {
+    q.items.clear();
+}
+
+inline void submitRenderItem(RenderQueue& q, const RenderItem& item) {
+    q.items.push_back(item);
+}
+
+// LSD radix sort of entries by key, using scratch as the second buffer
+inline void radixSortRenderEntries(std::vector<RenderSortEntry>& entries, std::vector<RenderSortEntry>& scratch) {
+    size_t n = entries.size();
+    scratch.resize(n);
+    // All eight histograms in one read
+    size_t counts[8][256];
+    memset(counts, 0, sizeof(counts));
+    for (size_t i = 0; i < n; ++i)
+        for (int digit = 0; digit < 8; ++digit)
+            ++counts[digit][(entries[i].key >> (digit * 8)) & 0xFF];
+
+    RenderSortEntry* from = entries.data();
+    RenderSortEntry* to = scratch.data();
+    for (int digit = 0; digit < 8; ++digit) {
+        size_t* count = counts[digit];
+        // A digit every key shares would only copy the array
+        if (n == 0 || count[(from[0].key >> (digit * 8)) & 0xFF] == n)
+            continue;
+        size_t offset = 0;
+        for (int b = 0; b < 256; ++b) {
+            size_t c = count[b];
+            count[b] = offset;
+            offset += c;
+        }
+        for (size_t i = 0; i < n; ++i)
+            to[count[(from[i].key >> (digit * 8)) & 0xFF]++] = from[i];
+        RenderSortEntry* swap = from;
+        from = to;
+        to = swap;
+    }
+    if (from != entries.data())
+        entries.swap(scratch);
+}
+
+inline void sortRenderQueue(RenderQueue& q) {
+    q.order.resize(q.items.size());
+    for (size_t i = 0; i < q.items.size(); ++i) {
+        q.order[i].key = q.items[i].key;
+        q.order[i].item = (uint32_t)i;
+    }
+    radixSortRenderEntries(q.order, q.scratch);
+}
+
+// Issues the sorted items, binding only what changed. The blend function for
+// RENDER_ALPHA_BLEND is GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA. Leaves the last
+// program, texture and VAO bound and blending as the last item needed.
+inline const RenderQueueStats& executeRenderQueue(RenderQueue& q) {
+    q.stats = RenderQueueStats();
+    q.stats.items = q.order.size();
+    GLuint program = 0, texture = 0, vao = 0;
+    int blend = -1;
+    bool first = true;
+    glActiveTexture(GL_TEXTURE0);
+    for (size_t i = 0; i < q.order.size(); ++i) {
+        const RenderItem& item = q.items[q.order[i].item];
+        if (first || item.program != program) {
+            glUseProgram(item.program);
+            program = item.program;
+            ++q.stats.programBinds;
+        }
+        if (first || item.texture != texture) {
+            glBindTexture(GL_TEXTURE_2D, item.texture);
+            texture = item.texture;
+            ++q.stats.textureBinds;
+        }
+        if (first || item.vao != vao) {
+            glBindVertexArray(item.vao);
+            vao = item.vao;
+            ++q.stats.vaoBinds;
+        }
+        if ((int)item.blend != blend) {
+            if (item.blend == RENDER_ALPHA_BLEND) {
+                glEnable(GL_BLEND);
+                glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            } else {
+                glDisable(GL_BLEND);
+            }
+            blend = item.blend;
+            ++q.stats.blendChanges;
+        }
+        first = false;
+
+        if (item.draw)
+            item.draw(item.program, item.data, item.index);
+        else if (item.indexType)
+            glDrawElements(item.mode, item.count, item.indexType, (const void*)item.first);
+        else
+            glDrawArrays(item.mode, (GLint)item.first, item.count);
+    }
+    return q.stats;
+}
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef SHADER_UTIL_H
+#define SHADER_UTIL_H
+
+#include <glad/glad.h>
+#include <iostream>
+
+// Compile/link helpers for the demos that build more than one program. Errors
+// are printed the same way the demos print them inline.
+
+inline const char* shaderStageName(GLenum type) {
+    switch (type) {
+        case GL_VERTEX_SHADER: return "VERTEX";
+        case GL_FRAGMENT_SHADER: return "FRAGMENT";
+        case GL_GEOMETRY_SHADER: return "GEOMETRY";
+        case GL_TESS_CONTROL_SHADER: return "TESS_CONTROL";
+        case GL_TESS_EVALUATION_SHADER: return "TESS_EVALUATION";
+        case GL_COMPUTE_SHADER: return "COMPUTE";
+        default: return "UNKNOWN";
+    }
+}
+
+// Returns 0 if the shader did not compile
+inline GLuint compileShader(GLenum type, const char* source) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    int success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        char infoLog[1024];
+        glGetShaderInfoLog(shader, sizeof(infoLog), NULL, infoLog);
+        std::cout << "ERROR::SHADER::" << shaderStageName(type) << "::COMPILATION_FAILED\n" << infoLog << std::endl;
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+// Links whichever stages are given (NULL stages are skipped). Returns 0 on
+// failure.
+inline GLuint createShaderProgram(const char* vertexSource, const char* fragmentSource,
+                                  const char* geometrySource = NULL,
+                                  const char* tessControlSource = NULL, const char* tessEvaluationSource = NULL) {
+    const GLenum types[] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_GEOMETRY_SHADER,
+                             GL_TESS_CONTROL_SHADER, GL_TESS_EVALUATION_SHADER };
+    const char* sources[] = { vertexSource, fragmentSource, geometrySource, tessControlSource, tessEvaluationSource };
+
+    GLuint program = glCreateProgram();
+    GLuint shaders[5] = { 0, 0, 0, 0, 0 };
+    bool ok = true;
+    for (int i = 0; i < 5; ++i) {
+        if (!sources[i])
+            continue;
+        shaders[i] = compileShader(types[i], sources[i]);
+        if (!shaders[i])
+            ok = false;
+        else
+            glAttachShader(program, shaders[i]);
+    }
+    if (ok) {
+        glLinkProgram(program);
+        int success;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) {
+            char infoLog[1024];
+            glGetProgramInfoLog(program, sizeof(infoLog), NULL, infoLog);
+            std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+            ok = false;
+        }
+    }
+    for (int i = 0; i < 5; ++i)
+        if (shaders[i])
+            glDeleteShader(shaders[i]);
+    if (!ok) {
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+// Compute program from a single shader. Returns 0 on failure.
+inline GLuint createComputeProgram(const char* computeSource) {
+    GLuint shader = compileShader(GL_COMPUTE_SHADER, computeSource);
+    if (!shader)
+        return 0;
+    GLuint program = glCreateProgram();
+    glAttachShader(program, shader);
+    glLinkProgram(program);
+    glDeleteShader(shader);
+    int success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        char infoLog[1024];
+        glGetProgramInfoLog(program, sizeof(infoLog), NULL, infoLog);
+        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+#endif
@@ -0,0 +1,345 @@
+#ifndef SHADOW_MAPS_H
+#define SHADOW_MAPS_H
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include "shaderUtil.h"
+
+// Cascaded shadow maps for one directional light that are only re-rendered
+// when something they show has changed.
+//
+// Casters are static or dynamic. Each cascade keeps two depth maps: a cache
+// holding the static casters, and the map the shaders sample, which is the
+// cache with this frame's dynamic casters drawn on top. The cache is redrawn
+// only when the light turns, when invalidateStaticShadows() says a static
+// caster inside it changed, or when the camera has moved far enough that the
+// cascade has to cover a new area. Cascades are squares a little larger
+// than the part of the view they serve, and they move in steps of that
+// margin, so walking around redraws a cascade now and then instead of every
+// frame. The composite (copy the cache, draw the dynamic casters) is skipped
+// when a cascade had no dynamic casters last frame or this one.
+//
+// Paste SHADOW_MAPS_GLSL into a fragment shader and multiply a light's
+// contribution by shadowFactor(); bindShadowMaps() sets its uniforms.
+
+const int SHADOW_MAX_CASCADES = 4;
+
+#define SHADOW_MAPS_GLSL \
+    "uniform sampler2DArrayShadow shadowMaps;\n" \
+    "uniform mat4 shadowMatrices[4];        // world to shadow map texture space\n" \
+    "uniform float shadowNormalOffset[4];   // world units, about two texels\n" \
+    "uniform int shadowCascades;\n" \
+    "// 1 lit, 0 in shadow. Uses the first (finest) cascade that covers fragPos.\n" \
+    "float shadowFactor(vec3 fragPos, vec3 normal)\n" \
+    "{\n" \
+    "    vec2 texel = 1.0 / vec2(textureSize(shadowMaps, 0).xy);\n" \
+    "    for (int i = 0; i < shadowCascades; ++i) {\n" \
+    "        vec3 p = (shadowMatrices[i] * vec4(fragPos + normal * shadowNormalOffset[i], 1.0)).xyz;\n" \
+    "        if (any(lessThan(p.xy, texel * 2.0)) || any(greaterThan(p.xy, 1.0 - texel * 2.0)))\n" \
+    "            continue;\n" \
+    "        if (p.z >= 1.0)\n" \
+    "            return 1.0;\n" \
+    "        float lit = 0.0;\n" \
+    "        for (int y = -1; y <= 1; y += 2)\n" \
+    "            for (int x = -1; x <= 1; x += 2)\n" \
+    "                lit += texture(shadowMaps, vec4(p.xy + vec2(x, y) * 0.5 * texel, float(i), p.z));\n" \
+    "        return lit * 0.25;\n" \
+    "    }\n" \
+    "    return 1.0;\n" \
+    "}\n"
+
+// Depth-only pass. The caster callback sets model and the packed position
+// decode (setMeshDecodeUniforms) before drawing.
+const char* const SHADOW_DEPTH_VS = R"glsl(
+#version 330 core
+layout (location = 0) in vec3 aPos;
+uniform mat4 lightViewProjection;
+uniform mat4 model;
+uniform vec3 positionScale;
+uniform vec3 positionBias;
+void main()
+{
+    gl_Position = lightViewProjection * model * vec4(aPos * positionScale + positionBias, 1.0);
+}
+)glsl";
+
+const char* const SHADOW_DEPTH_FS = R"glsl(
+#version 330 core
+void main()
+{
+}
+)glsl";
+
+// A caster's world-space bounding sphere, used to decide which cascades it
+// lands in
+struct ShadowCaster {
+    float center[3];
+    float radius;
+    bool dynamic;
+};
+
+struct ShadowCascade {
+    float lightViewProjection[16];
+    float center[3];      // light space, snapped to the step grid
+    float halfExtent;
+    float step;
+    bool staticValid;
+    bool hadDynamic;      // last frame drew dynamic casters over the cache
+};
+
+struct ShadowStats {
+    int staticPasses;     // cascades whose cache was redrawn
+    int compositePasses;  // cascades that copied the cache and drew dynamic casters
+    int skippedPasses;    // of the 2 per cascade, the ones not needed
+};
+
+struct ShadowMaps {
+    GLuint staticMaps, maps;  // GL_TEXTURE_2D_ARRAY depth, one layer per cascade
+    GLuint drawFramebuffer, readFramebuffer;
+    GLuint program;
+    int size, cascadeCount;
+    float shadowDistance;     // cascades cover the view out to here
+    float casterReach;        // how far behind a cascade casters can still throw shadow into it
+    float lightDir[3];        // direction the light travels, normalized
+    float right[3], up[3];    // light space axes
+    ShadowCascade cascades[SHADOW_MAX_CASCADES];
+    ShadowStats stats;
+};
+
+inline GLuint createShadowMapArray(int size, int layers) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F, size, size, layers, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    return texture;
+}
+
+inline void initShadowMaps(ShadowMaps& s, int size, int cascadeCount, float shadowDistance, float casterReach = 50.0f) {
+    s = ShadowMaps();
+    s.size = size;
+    s.cascadeCount = std::min(std::max(cascadeCount, 1), SHADOW_MAX_CASCADES);
+    s.shadowDistance = shadowDistance;
+    s.casterReach = casterReach;
+    s.staticMaps = createShadowMapArray(size, s.cascadeCount);
+    s.maps = createShadowMapArray(size, s.cascadeCount);
+    // Depth-only framebuffers; the layer is attached per pass
+    glGenFramebuffers(1, &s.drawFramebuffer);
+    glGenFramebuffers(1, &s.readFramebuffer);
+    GLuint framebuffers[] = { s.drawFramebuffer, s.readFramebuffer };
+    for (GLuint framebuffer : framebuffers) {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    s.program = createShaderProgram(SHADOW_DEPTH_VS, SHADOW_DEPTH_FS);
+}
+
+// Forgets every cached static map, e.g. after casters were added or removed
+inline void invalidateShadowMaps(ShadowMaps& s) {
+    for (int i = 0; i < s.cascadeCount; ++i)
+        s.cascades[i].staticValid = false;
+}
+
+inline void shadowLightSpace(const ShadowMaps& s, const float* p, float* out) {
+    out[0] = s.right[0] * p[0] + s.right[1] * p[1] + s.right[2] * p[2];
+    out[1] = s.up[0] * p[0] + s.up[1] * p[1] + s.up[2] * p[2];
+    out[2] = s.lightDir[0] * p[0] + s.lightDir[1] * p[1] + s.lightDir[2] * p[2];
+}
+
+// True when the sphere can cast into or be shadowed in cascade i: it
+// overlaps the cascade's square and is no further behind it than casterReach
+inline bool shadowCascadeTouches(const ShadowMaps& s, int i, const float* center, float radius) {
+    const ShadowCascade& c = s.cascades[i];
+    float p[3];
+    shadowLightSpace(s, center, p);
+    return fabsf(p[0] - c.center[0]) <= c.halfExtent + radius && fabsf(p[1] - c.center[1]) <= c.halfExtent + radius
+           && fabsf(p[2] - c.center[2]) <= c.halfExtent + s.casterReach + radius;
+}
+
+// Call when a static caster with this bounding sphere moved, appeared or
+// went away; only the cascades it touches are redrawn
+inline void invalidateStaticShadows(ShadowMaps& s, const float* center, float radius) {
+    for (int i = 0; i < s.cascadeCount; ++i)
+        if (shadowCascadeTouches(s, i, center, radius))
+            s.cascades[i].staticValid = false;
+}
+
+// Changes the light direction; the caches are only dropped when it really turned
+inline void setShadowLightDirection(ShadowMaps& s, const float* direction) {
+    float length = sqrtf(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+    float d[3] = { direction[0] / length, direction[1] / length, direction[2] / length };
+    if (fabsf(d[0] - s.lightDir[0]) + fabsf(d[1] - s.lightDir[1]) + fabsf(d[2] - s.lightDir[2]) < 1e-6f)
+        return;
+    for (int k = 0; k < 3; ++k)
+        s.lightDir[k] = d[k];
+    // right = normalize(cross(d, worldUp)), up = cross(right, d)
+    float worldUp[3] = { 0.0f, 1.0f, 0.0f };
+    if (fabsf(d[1]) > 0.99f) {
+        worldUp[1] = 0.0f;
+        worldUp[0] = 1.0f;
+    }
+    float r[3] = { d[1] * worldUp[2] - d[2] * worldUp[1], d[2] * worldUp[0] - d[0] * worldUp[2], d[0] * worldUp[1] - d[1] * worldUp[0] };
+    float rLength = sqrtf(r[0] * r[0] + r[1] * r[1] + r[2] * r[2]);
+    for (int k = 0; k < 3; ++k)
+        s.right[k] = r[k] / rLength;
+    s.up[0] = s.right[1] * d[2] - s.right[2] * d[1];
+    s.up[1] = s.right[2] * d[0] - s.right[0] * d[2];
+    s.up[2] = s.right[0] * d[1] - s.right[1] * d[0];
+    invalidateShadowMaps(s);
+}
+
+// Fits the cascades to the camera (position, unit front vector, vertical fov
+// in radians) and works out which of them need a new cache
+inline void fitShadowCascades(ShadowMaps& s, const float* cameraPos, const float* front, float fovY, float aspect,
+                              float nearPlane) {
+    float tanY = tanf(fovY * 0.5f), tanX = tanY * aspect;
+    // Slice radius only depends on the split depths, so it is the same every frame
+    float diagonal = sqrtf(tanX * tanX + tanY * tanY);
+    for (int i = 0; i < s.cascadeCount; ++i) {
+        // Practical split scheme: mostly logarithmic, partly uniform
+        float t0 = (float)i / s.cascadeCount, t1 = (float)(i + 1) / s.cascadeCount;
+        float n = 0.75f * nearPlane * powf(s.shadowDistance / nearPlane, t0) + 0.25f * (nearPlane + (s.shadowDistance - nearPlane) * t0);
+        float f = 0.75f * nearPlane * powf(s.shadowDistance / nearPlane, t1) + 0.25f * (nearPlane + (s.shadowDistance - nearPlane) * t1);
+        float mid = 0.5f * (n + f);
+        float radius = std::max(sqrtf((mid - n) * (mid - n) + n * n * diagonal * diagonal),
+                                sqrtf((f - mid) * (f - mid) + f * f * diagonal * diagonal));
+        float center[3];
+        for (int k = 0; k < 3; ++k)
+            center[k] = cameraPos[k] + front[k] * mid;
+
+        // A margin of a quarter radius, and steps of half a radius rounded to
+        // whole texels so the static map lines up after a move
+        float halfExtent = radius * 1.25f;
+        float texel = 2.0f * halfExtent / s.size;
+        float step = std::max(1.0f, floorf(0.5f * radius / texel)) * texel;
+        float p[3];
+        shadowLightSpace(s, center, p);
+        for (int k = 0; k < 3; ++k)
+            p[k] = floorf(p[k] / step + 0.5f) * step;
+
+        ShadowCascade& c = s.cascades[i];
+        if (p[0] != c.center[0] || p[1] != c.center[1] || p[2] != c.center[2] || halfExtent != c.halfExtent)
+            c.staticValid = false;
+        for (int k = 0; k < 3; ++k)
+            c.center[k] = p[k];
+        c.halfExtent = halfExtent;
+        c.step = step;
+
+        // Orthographic projection of light space, depth along lightDir
+        float depthHalf = halfExtent + s.casterReach;
+        float* m = c.lightViewProjection;
+        for (int k = 0; k < 3; ++k) {
+            m[k * 4 + 0] = s.right[k] / halfExtent;
+            m[k * 4 + 1] = s.up[k] / halfExtent;
+            m[k * 4 + 2] = s.lightDir[k] / depthHalf;
+            m[k * 4 + 3] = 0.0f;
+        }
+        m[12] = -p[0] / halfExtent;
+        m[13] = -p[1] / halfExtent;
+        m[14] = -p[2] / depthHalf;
+        m[15] = 1.0f;
+    }
+}
+
+inline void attachShadowLayer(GLuint framebuffer, GLenum target, GLuint texture, int layer) {
+    glBindFramebuffer(target, framebuffer);
+    glFramebufferTextureLayer(target, GL_DEPTH_ATTACHMENT, texture, 0, layer);
+}
+
+// Brings every cascade up to date. drawCaster(program, i) draws caster i
+// with the depth program bound (it sets model and the mesh decode uniforms).
+// Call fitShadowCascades first. Leaves framebuffer 0 bound; restore the
+// viewport afterwards.
+template <typename DrawCaster>
+inline void updateShadowMaps(ShadowMaps& s, const ShadowCaster* casters, size_t casterCount, DrawCaster drawCaster) {
+    s.stats = ShadowStats();
+    glUseProgram(s.program);
+    glViewport(0, 0, s.size, s.size);
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2.0f, 4.0f);
+    // Casters between the light and the near plane still cast, at depth 0
+    glEnable(GL_DEPTH_CLAMP);
+    for (int i = 0; i < s.cascadeCount; ++i) {
+        ShadowCascade& c = s.cascades[i];
+        glUniformMatrix4fv(glGetUniformLocation(s.program, "lightViewProjection"), 1, GL_FALSE, c.lightViewProjection);
+
+        bool staticRedrawn = !c.staticValid;
+        if (staticRedrawn) {
+            attachShadowLayer(s.drawFramebuffer, GL_FRAMEBUFFER, s.staticMaps, i);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            for (size_t j = 0; j < casterCount; ++j)
+                if (!casters[j].dynamic && shadowCascadeTouches(s, i, casters[j].center, casters[j].radius))
+                    drawCaster(s.program, j);
+            c.staticValid = true;
+            ++s.stats.staticPasses;
+        }
+
+        bool hasDynamic = false;
+        for (size_t j = 0; j < casterCount && !hasDynamic; ++j)
+            hasDynamic = casters[j].dynamic && shadowCascadeTouches(s, i, casters[j].center, casters[j].radius);
+        if (staticRedrawn || hasDynamic || c.hadDynamic) {
+            // The sampled map starts as a copy of the cache
+            attachShadowLayer(s.readFramebuffer, GL_READ_FRAMEBUFFER, s.staticMaps, i);
+            attachShadowLayer(s.drawFramebuffer, GL_DRAW_FRAMEBUFFER, s.maps, i);
+            glBlitFramebuffer(0, 0, s.size, s.size, 0, 0, s.size, s.size, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+            glBindFramebuffer(GL_FRAMEBUFFER, s.drawFramebuffer);
+            if (hasDynamic)
+                for (size_t j = 0; j < casterCount; ++j)
+                    if (casters[j].dynamic && shadowCascadeTouches(s, i, casters[j].center, casters[j].radius))
+                        drawCaster(s.program, j);
+            ++s.stats.compositePasses;
+        }
+        c.hadDynamic = hasDynamic;
+    }
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glDisable(GL_DEPTH_CLAMP);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    s.stats.skippedPasses = 2 * s.cascadeCount - s.stats.staticPasses - s.stats.compositePasses;
+}
+
+// Binds the maps to texture unit `unit` and sets the SHADOW_MAPS_GLSL
+// uniforms of the bound program
+inline void bindShadowMaps(const ShadowMaps& s, GLuint program, int unit) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, s.maps);
+    glActiveTexture(GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(program, "shadowMaps"), unit);
+    glUniform1i(glGetUniformLocation(program, "shadowCascades"), s.cascadeCount);
+    float matrices[SHADOW_MAX_CASCADES * 16];
+    float offsets[SHADOW_MAX_CASCADES];
+    for (int i = 0; i < s.cascadeCount; ++i) {
+        // Clip space [-1, 1] to texture space [0, 1]
+        const float* m = s.cascades[i].lightViewProjection;
+        float* out = matrices + i * 16;
+        for (int col = 0; col < 4; ++col)
+            for (int row = 0; row < 3; ++row)
+                out[col * 4 + row] = 0.5f * m[col * 4 + row] + 0.5f * m[col * 4 + 3];
+        for (int col = 0; col < 4; ++col)
+            out[col * 4 + 3] = m[col * 4 + 3];
+        offsets[i] = 4.0f * s.cascades[i].halfExtent / s.size;
+    }
+    glUniformMatrix4fv(glGetUniformLocation(program, "shadowMatrices"), s.cascadeCount, GL_FALSE, matrices);
+    glUniform1fv(glGetUniformLocation(program, "shadowNormalOffset"), s.cascadeCount, offsets);
+}
+
+inline void destroyShadowMaps(ShadowMaps& s) {
+    GLuint textures[] = { s.staticMaps, s.maps };
+    glDeleteTextures(2, textures);
+    GLuint framebuffers[] = { s.drawFramebuffer, s.readFramebuffer };
+    glDeleteFramebuffers(2, framebuffers);
+    glDeleteProgram(s.program);
+    s = ShadowMaps();
+}
+
+#endif
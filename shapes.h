@@ -0,0 +1,207 @@
+#ifndef SHAPES_H
+#define SHAPES_H
+
+#include <vector>
+#include <cmath>
+#include "mesh.h"
+#include "icosphere.h"
+
+// Geometry for every shape the demos draw. The demos and meshExport both build
+// their meshes from here so there is only one copy of each vertex list.
+
+inline std::vector<MeshAttrib> positionLayout() {
+    MeshAttrib position = { 0, 3, GL_FLOAT, GL_FALSE, 0 };
+    return std::vector<MeshAttrib>(1, position);
+}
+
+inline std::vector<MeshAttrib> positionNormalLayout() {
+    MeshAttrib position = { 0, 3, GL_FLOAT, GL_FALSE, 0 };
+    MeshAttrib normal   = { 1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float) };
+    std::vector<MeshAttrib> layout;
+    layout.push_back(position);
+    layout.push_back(normal);
+    return layout;
+}
+
+inline void createSphere(std::vector<float>& vertices, std::vector<unsigned int>& indices, float radius, unsigned int sectorCount, unsigned int stackCount) {
+    float x, y, z, xy;
+    float sectorStep = 2 * M_PI / sectorCount;
+    float stackStep = M_PI / stackCount;
+    float sectorAngle, stackAngle;
+
+    for (int i = 0; i <= stackCount; ++i) {
+        stackAngle = M_PI / 2 - i * stackStep;
+        xy = radius * cosf(stackAngle);
+        z = radius * sinf(stackAngle);
+
+        for (int j = 0; j <= sectorCount; ++j) {
+            sectorAngle = j * sectorStep;
+
+            x = xy * cosf(sectorAngle);
+            y = xy * sinf(sectorAngle);
+
+            vertices.push_back(x);
+            vertices.push_back(y);
+            vertices.push_back(z);
+        }
+    }
+
+    int k1, k2;
+    for (int i = 0; i < stackCount; ++i) {
+        k1 = i * (sectorCount + 1);
+        k2 = k1 + sectorCount + 1;
+
+        for (int j = 0; j < sectorCount; ++j, ++k1, ++k2) {
+            if (i != 0) {
+                indices.push_back(k1);
+                indices.push_back(k2);
+                indices.push_back(k1 + 1);
+            }
+
+            if (i != (stackCount - 1)) {
+                indices.push_back(k1 + 1);
+                indices.push_back(k2);
+                indices.push_back(k2 + 1);
+            }
+        }
+    }
+}
+
+inline MeshData createSphereMesh(float radius, unsigned int sectorCount, unsigned int stackCount) {
+    MeshData mesh;
+    createSphere(mesh.vertices, mesh.indices, radius, sectorCount, stackCount);
+    mesh.layout = positionLayout();
+    mesh.stride = 3 * sizeof(float);
+    return mesh;
+}
+
+// All icosphere levels in one mesh, with the levels in the LOD table
+inline MeshData createIcosphereMesh(float radius, unsigned int maxLevel) {
+    IcosphereLODs lods = createIcosphereLODs(radius, maxLevel);
+    MeshData mesh;
+    mesh.vertices.swap(lods.vertices);
+    mesh.indices.swap(lods.indices);
+    mesh.layout = positionLayout();
+    mesh.stride = 3 * sizeof(float);
+    for (size_t i = 0; i < lods.levels.size(); ++i) {
+        MeshLOD lod = { lods.levels[i].firstIndex, lods.levels[i].indexCount, lods.levels[i].vertexCount, 0 };
+        mesh.lods.push_back(lod);
+    }
+    return mesh;
+}
+
+// advCubeDemo's lit cube: 36 vertices, positions and normals, no index buffer.
+// weldMesh turns it into 24 vertices and 36 indices.
+inline MeshData createCubeMesh() {
+    const float vertices[] = {
+        // positions         // normals
+        -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
+         0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
+         0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
+         0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
+        -0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
+        -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
+
+        -0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,
+         0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,
+         0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,
+         0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,
+        -0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,
+        -0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,
+
+        -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,
+        -0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f,
+        -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,
+        -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,
+        -0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f,
+        -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,
+
+         0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,
+         0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,
+         0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,
+         0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,
+         0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,
+         0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,
+
+        -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,
+         0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,
+         0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,
+         0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,
+        -0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,
+        -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,
+
+        -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,
+         0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,
+         0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,
+         0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,
+        -0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,
+        -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f
+    };
+
+    MeshData mesh;
+    mesh.vertices.assign(vertices, vertices + sizeof(vertices) / sizeof(float));
+    mesh.layout = positionNormalLayout();
+    mesh.stride = 6 * sizeof(float);
+    return mesh;
+}
+
+inline MeshData createTriPyramidMesh() {
+    const float vertices[] = {
+        // positions
+        -0.5f, -0.5f, -0.5f,
+         0.5f, -0.5f, -0.5f,
+         0.0f,  0.5f,  0.0f,
+         0.0f, -0.5f,  0.5f
+    };
+    const unsigned int indices[] = {
+        0, 1, 2,
+        1, 3, 2,
+        3, 0, 2,
+        0, 3, 1
+    };
+
+    MeshData mesh;
+    mesh.vertices.assign(vertices, vertices + sizeof(vertices) / sizeof(float));
+    mesh.indices.assign(indices, indices + sizeof(indices) / sizeof(unsigned int));
+    mesh.layout = positionLayout();
+    mesh.stride = 3 * sizeof(float);
+    return mesh;
+}
+
+inline MeshData createDiamondMesh() {
+    const float vertices[] = {
+        // Top half vertices
+        0.0f, 1.0f, 0.0f,  // Top point
+        -0.5f, 0.0f, -0.5f,  // Base square
+        0.5f, 0.0f, -0.5f,
+        0.5f, 0.0f, 0.5f,
+        -0.5f, 0.0f, 0.5f,
+        // Bottom half vertices
+        0.0f, -1.0f, 0.0f,  // Bottom point
+        -0.5f, 0.0f, -0.5f,  // Base square (reused)
+        0.5f, 0.0f, -0.5f,
+        0.5f, 0.0f, 0.5f,
+        -0.5f, 0.0f, 0.5f
+    };
+    const unsigned int indices[] = {
+        // Top pyramid
+        0, 1, 2,
+        0, 2, 3,
+        0, 3, 4,
+        0, 4, 1,
+        // Bottom pyramid
+        5, 6, 7,
+        5, 7, 8,
+        5, 8, 9,
+        5, 9, 6
+    };
+
+    MeshData mesh;
+    mesh.vertices.assign(vertices, vertices + sizeof(vertices) / sizeof(float));
+    mesh.indices.assign(indices, indices + sizeof(indices) / sizeof(unsigned int));
+    mesh.layout = positionLayout();
+    mesh.stride = 3 * sizeof(float);
+    return mesh;
+}
+
+#endif
@@ -6,16 +6,63 @@
 #include <iostream>
 #include <vector>
 #include <cmath>
-
-const char* vertexShaderSource = R"glsl(
-#version 330 core
+#include <sstream>
+#include "shapes.h"
+#include "meshFile.h"
+#include "frameStats.h"
+#include "shaderUtil.h"
+#include "sphereImpostor.h"
+#include "wireframe.h"
+#include "objectConstants.h"
+#include "idleFrames.h"
+
+// Where instance gl_InstanceID sits when G spreads copies of the sphere over
+// a gridWidth x gridWidth grid in the XY plane. One instance sits at the origin.
+#define SPHERE_GRID_GLSL \
+    "uniform int gridWidth;\n" \
+    "uniform float gridSpacing;\n" \
+    "vec3 gridOffset()\n" \
+    "{\n" \
+    "    int middle = gridWidth / 2;\n" \
+    "    return vec3(float(gl_InstanceID % gridWidth - middle), float(gl_InstanceID / gridWidth - middle), 0.0) * gridSpacing;\n" \
+    "}\n"
+
+const char* vertexShaderSource = "#version 330 core\n" SPHERE_GRID_GLSL R"glsl(
 layout (location = 0) in vec3 aPos;
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform mat4 mvp;            // projection * view * model, see objectConstants.h
+uniform vec3 positionScale;  // packed vertex decode, see vertexCompress.h
+uniform vec3 positionBias;
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = mvp * vec4(aPos * positionScale + positionBias + gridOffset(), 1.0);
+}
+)glsl";
+
+// Buffer-less UV sphere: the same triangles createSphere() indexes, worked
+// out from gl_VertexID alone and drawn from an empty VAO. Vertex 6 * q + c is
+// corner c of quad q, and quad q sits at stack q / sectors, sector
+// q % sectors. The pole quads come out as one real and one zero-area
+// triangle, which the rasterizer drops.
+const char* proceduralVertexShaderSource = "#version 330 core\n" SPHERE_GRID_GLSL R"glsl(
+uniform mat4 mvp;
+uniform float radius;
+uniform int sectors;
+uniform int stacks;
+
+const float PI = 3.14159265358979;
+const ivec2 quadCorners[6] = ivec2[6](ivec2(0, 0), ivec2(1, 0), ivec2(0, 1),
+                                      ivec2(0, 1), ivec2(1, 0), ivec2(1, 1));
+void main()
+{
+    int quad = gl_VertexID / 6;
+    ivec2 corner = quadCorners[gl_VertexID % 6];
+    int stack = quad / sectors + corner.x;
+    int sector = (quad % sectors + corner.y) % sectors;  // wrap so the seam vertices match exactly
+
+    float stackAngle = PI / 2.0 - PI * float(stack) / float(stacks);
+    float sectorAngle = 2.0 * PI * float(sector) / float(sectors);
+    vec3 p = vec3(cos(stackAngle) * cos(sectorAngle), cos(stackAngle) * sin(sectorAngle), sin(stackAngle));
+    gl_Position = mvp * vec4(p * radius + gridOffset(), 1.0);
 }
 )glsl";
 
@@ -32,6 +79,73 @@ void main()
 }
 )glsl";
 
+// Tessellated sphere: a 20-triangle icosahedron is subdivided on the GPU and
+// every generated vertex is pushed out onto the sphere. Each edge gets a level
+// from its projected length, so detail follows the view while the buffers stay
+// the size of the base mesh. The level only depends on the two edge
+// endpoints, so neighbouring patches agree on shared edges and do not crack.
+const char* tessVertexShaderSource = "#version 400 core\n" SPHERE_GRID_GLSL R"glsl(
+layout (location = 0) in vec3 aPos;
+out vec3 controlPos;
+out vec3 controlCenter;
+void main()
+{
+    controlPos = aPos;
+    controlCenter = gridOffset();
+}
+)glsl";
+
+const char* tessControlShaderSource = R"glsl(
+#version 400 core
+layout (vertices = 3) out;
+in vec3 controlPos[];
+in vec3 controlCenter[];
+out vec3 evalPos[];
+out vec3 evalCenter[];
+uniform mat4 model;
+uniform mat4 view;
+uniform float radius;
+uniform float pixelsPerUnit;     // projection[1][1] * viewport height / 2
+uniform float targetEdgePixels;
+
+float edgeLevel(vec3 a, vec3 b)
+{
+    float depth = max(-0.5 * (a.z + b.z), 0.01);
+    return clamp(distance(a, b) * pixelsPerUnit / (depth * targetEdgePixels), 1.0, 64.0);
+}
+
+void main()
+{
+    evalPos[gl_InvocationID] = controlPos[gl_InvocationID];
+    evalCenter[gl_InvocationID] = controlCenter[gl_InvocationID];
+    if (gl_InvocationID == 0) {
+        mat4 modelView = view * model;
+        vec3 p0 = vec3(modelView * vec4(controlPos[0] * radius + controlCenter[0], 1.0));
+        vec3 p1 = vec3(modelView * vec4(controlPos[1] * radius + controlCenter[0], 1.0));
+        vec3 p2 = vec3(modelView * vec4(controlPos[2] * radius + controlCenter[0], 1.0));
+        // Outer level i is the edge opposite vertex i
+        gl_TessLevelOuter[0] = edgeLevel(p1, p2);
+        gl_TessLevelOuter[1] = edgeLevel(p2, p0);
+        gl_TessLevelOuter[2] = edgeLevel(p0, p1);
+        gl_TessLevelInner[0] = max(gl_TessLevelOuter[0], max(gl_TessLevelOuter[1], gl_TessLevelOuter[2]));
+    }
+}
+)glsl";
+
+const char* tessEvaluationShaderSource = R"glsl(
+#version 400 core
+layout (triangles, fractional_odd_spacing, ccw) in;
+in vec3 evalPos[];
+in vec3 evalCenter[];
+uniform mat4 mvp;
+uniform float radius;
+void main()
+{
+    vec3 p = gl_TessCoord.x * evalPos[0] + gl_TessCoord.y * evalPos[1] + gl_TessCoord.z * evalPos[2];
+    gl_Position = mvp * vec4(normalize(p) * radius + evalCenter[0], 1.0);
+}
+)glsl";
+
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 
@@ -47,6 +161,57 @@ float fov = 45.0f;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
+// Sphere LOD
+const unsigned int ICOSPHERE_MAX_LEVEL = 5;
+bool useIcosphere = true; // L toggles between the icosphere LOD chain and the fixed UV sphere
+bool lodKeyWasPressed = false;
+bool useOptimized = true; // O toggles between the optimized, packed meshes and the raw float ones in generation order
+bool optimizeKeyWasPressed = false;
+bool useMeshletCulling = true; // C toggles per-meshlet frustum and backface culling
+bool cullKeyWasPressed = false;
+
+// T cycles through the ways of getting a sphere on screen
+enum SpherePath {
+    SPHERE_PATH_MESH,          // prebuilt UV sphere / icosphere LOD chain
+    SPHERE_PATH_PROCEDURAL,    // UV sphere from gl_VertexID, no buffers at all
+    SPHERE_PATH_TESSELLATION,  // icosahedron refined by tessellation shaders
+    SPHERE_PATH_IMPOSTOR,      // one ray-cast quad per sphere, see sphereImpostor.h
+    SPHERE_PATH_COUNT
+};
+const char* spherePathNames[SPHERE_PATH_COUNT] = { "mesh", "procedural", "tessellation", "impostor" };
+SpherePath spherePath = SPHERE_PATH_MESH;
+bool pathKeyWasPressed = false;
+bool tessellationSupported = false;
+const float TESS_TARGET_EDGE_PIXELS = 8.0f;
+const int PROCEDURAL_SECTORS = 36;  // same density as the createSphere mesh
+const int PROCEDURAL_STACKS = 18;
+
+// G steps through grids of width^2 copies of the sphere. The last, million
+// sphere grid is only offered on the impostor path; the triangle paths would
+// need over a billion triangles a frame for it.
+const int SPHERE_GRID_SIZES = 3;
+const int SPHERE_GRID_WIDTHS[SPHERE_GRID_SIZES] = { 1, 51, 1025 };
+const int SPHERE_GRID_MESH_LIMIT = 1;  // largest grid index the triangle paths draw
+const float SPHERE_GRID_SPACING = 2.5f;
+int sphereGrid = 0;
+bool gridKeyWasPressed = false;
+
+// F switches between the single-pass wireframe (wireframe.h) and the old
+// second glPolygonMode(GL_LINE) draw
+bool singlePassWireframe = true;
+bool wireframeKeyWasPressed = false;
+
+// B renders each path back to back and prints the timings
+const int BENCHMARK_FRAMES = 200;
+bool benchmarkRequested = false;
+bool benchmarkKeyWasPressed = false;
+
+// X sweeps sphere screen sizes and prints whether impostors or icosphere
+// meshes (at the LOD the selector would pick) draw a screen full of spheres faster
+const int CROSSOVER_FRAMES = 20;
+bool crossoverRequested = false;
+bool crossoverKeyWasPressed = false;
+
 void processInput(GLFWwindow *window) {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
@@ -76,6 +241,65 @@ void processInput(GLFWwindow *window) {
     if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
         yaw += rotationSpeed;
 
+    bool lodKeyPressed = glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS;
+    if (lodKeyPressed && !lodKeyWasPressed) {
+        useIcosphere = !useIcosphere;
+        std::cout << (useIcosphere ? "Icosphere LOD" : "UV sphere") << std::endl;
+    }
+    lodKeyWasPressed = lodKeyPressed;
+
+    bool optimizeKeyPressed = glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS;
+    if (optimizeKeyPressed && !optimizeKeyWasPressed) {
+        useOptimized = !useOptimized;
+        std::cout << (useOptimized ? "Optimized index order, packed vertices" : "Raw index order, float vertices") << std::endl;
+    }
+    optimizeKeyWasPressed = optimizeKeyPressed;
+
+    bool cullKeyPressed = glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS;
+    if (cullKeyPressed && !cullKeyWasPressed) {
+        useMeshletCulling = !useMeshletCulling;
+        std::cout << (useMeshletCulling ? "Meshlet culling on" : "Meshlet culling off") << std::endl;
+    }
+    cullKeyWasPressed = cullKeyPressed;
+
+    bool pathKeyPressed = glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS;
+    if (pathKeyPressed && !pathKeyWasPressed) {
+        do {
+            spherePath = (SpherePath)((spherePath + 1) % SPHERE_PATH_COUNT);
+        } while (spherePath == SPHERE_PATH_TESSELLATION && !tessellationSupported);
+        std::cout << "Sphere path: " << spherePathNames[spherePath] << std::endl;
+        if (spherePath != SPHERE_PATH_IMPOSTOR && sphereGrid > SPHERE_GRID_MESH_LIMIT) {
+            sphereGrid = SPHERE_GRID_MESH_LIMIT;
+            std::cout << "Grid reduced to " << SPHERE_GRID_WIDTHS[sphereGrid] << "x" << SPHERE_GRID_WIDTHS[sphereGrid] << std::endl;
+        }
+    }
+    pathKeyWasPressed = pathKeyPressed;
+
+    bool gridKeyPressed = glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS;
+    if (gridKeyPressed && !gridKeyWasPressed) {
+        int grids = spherePath == SPHERE_PATH_IMPOSTOR ? SPHERE_GRID_SIZES : SPHERE_GRID_MESH_LIMIT + 1;
+        sphereGrid = (sphereGrid + 1) % grids;
+        std::cout << SPHERE_GRID_WIDTHS[sphereGrid] * SPHERE_GRID_WIDTHS[sphereGrid] << " spheres" << std::endl;
+    }
+    gridKeyWasPressed = gridKeyPressed;
+
+    bool wireframeKeyPressed = glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS;
+    if (wireframeKeyPressed && !wireframeKeyWasPressed) {
+        singlePassWireframe = !singlePassWireframe;
+        std::cout << (singlePassWireframe ? "Single-pass wireframe" : "Two-pass wireframe") << std::endl;
+    }
+    wireframeKeyWasPressed = wireframeKeyPressed;
+
+    bool benchmarkKeyPressed = glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS;
+    if (benchmarkKeyPressed && !benchmarkKeyWasPressed)
+        benchmarkRequested = true;
+    benchmarkKeyWasPressed = benchmarkKeyPressed;
+
+    bool crossoverKeyPressed = glfwGetKey(window, GLFW_KEY_X) == GLFW_PRESS;
+    if (crossoverKeyPressed && !crossoverKeyWasPressed)
+        crossoverRequested = true;
+    crossoverKeyWasPressed = crossoverKeyPressed;
+
     // Update cameraFront from yaw and pitch
     glm::vec3 front;
     front.x = cos(glm::radians(yaw)) * cos(glm::radians(pitch));
@@ -84,57 +308,148 @@ void processInput(GLFWwindow *window) {
     cameraFront = glm::normalize(front);
 }
 
-void createSphere(std::vector<float>& vertices, std::vector<unsigned int>& indices, float radius, unsigned int sectorCount, unsigned int stackCount) {
-    float x, y, z, xy;                              
-    float sectorStep = 2 * M_PI / sectorCount;
-    float stackStep = M_PI / stackCount;
-    float sectorAngle, stackAngle;
-
-    for (int i = 0; i <= stackCount; ++i) {
-        stackAngle = M_PI / 2 - i * stackStep;
-        xy = radius * cosf(stackAngle);
-        z = radius * sinf(stackAngle);
-
-        for (int j = 0; j <= sectorCount; ++j) {
-            sectorAngle = j * sectorStep;
+// Times each triangle goes through the pipeline per frame
+int spherePassCount(SpherePath path) {
+    return path == SPHERE_PATH_IMPOSTOR || singlePassWireframe ? 1 : 2;
+}
 
-            x = xy * cosf(sectorAngle);
-            y = xy * sinf(sectorAngle);
+void setMatrixUniforms(GLuint program, const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection) {
+    // The vertex stages only need the product; model and view stay for the
+    // tessellation control shader, which measures edges in view space
+    glm::mat4 viewProjection = projection * view;
+    ObjectConstants constants = computeObjectConstants(glm::value_ptr(viewProjection), glm::value_ptr(model));
+    glUniformMatrix4fv(glGetUniformLocation(program, "mvp"), 1, GL_FALSE, constants.mvp);
+    glUniformMatrix4fv(glGetUniformLocation(program, "model"), 1, GL_FALSE, glm::value_ptr(model));
+    glUniformMatrix4fv(glGetUniformLocation(program, "view"), 1, GL_FALSE, glm::value_ptr(view));
+    glUniform1i(glGetUniformLocation(program, "gridWidth"), SPHERE_GRID_WIDTHS[sphereGrid]);
+    glUniform1f(glGetUniformLocation(program, "gridSpacing"), SPHERE_GRID_SPACING);
+}
 
-            vertices.push_back(x);
-            vertices.push_back(y);
-            vertices.push_back(z);
-        }
+struct RenderBenchmark {
+    double cpuMs;         // per frame, including the wait for the GPU
+    double gpuMs;         // per frame, GL_TIME_ELAPSED
+    GLuint64 primitives;  // per frame, GL_PRIMITIVES_GENERATED
+};
+
+// Renders `frames` frames with `render` without presenting them and returns
+// per-frame averages
+template <typename RenderFn>
+RenderBenchmark benchmarkRender(RenderFn render, int frames) {
+    GLuint queries[2];
+    glGenQueries(2, queries);
+    glFinish();
+    double start = glfwGetTime();
+    glBeginQuery(GL_TIME_ELAPSED, queries[0]);
+    glBeginQuery(GL_PRIMITIVES_GENERATED, queries[1]);
+    for (int i = 0; i < frames; ++i) {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        render();
     }
+    glEndQuery(GL_PRIMITIVES_GENERATED);
+    glEndQuery(GL_TIME_ELAPSED);
+    glFinish();
+    double end = glfwGetTime();
+
+    GLuint64 ns = 0, primitives = 0;
+    glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &ns);
+    glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &primitives);
+    glDeleteQueries(2, queries);
+
+    RenderBenchmark result;
+    result.cpuMs = (end - start) * 1000.0 / frames;
+    result.gpuMs = ns / 1.0e6 / frames;
+    result.primitives = primitives / frames;
+    return result;
+}
 
-    int k1, k2;
-    for (int i = 0; i < stackCount; ++i) {
-        k1 = i * (sectorCount + 1);
-        k2 = k1 + sectorCount + 1;
-
-        for (int j = 0; j < sectorCount; ++j, ++k1, ++k2) {
-            if (i != 0) {
-                indices.push_back(k1);
-                indices.push_back(k2);
-                indices.push_back(k1 + 1);
-            }
+// The impostor instances for a width x width grid laid out like gridOffset()
+// in the shaders. A single sphere is white, grid spheres get hashed colors.
+void buildGridInstances(std::vector<SphereInstance>& instances, int width, float spacing, float radius,
+                        const glm::vec3& origin) {
+    instances.resize((size_t)width * width);
+    int middle = width / 2;
+    for (int i = 0; i < width * width; ++i) {
+        SphereInstance& s = instances[i];
+        s.center[0] = origin.x + (i % width - middle) * spacing;
+        s.center[1] = origin.y + (i / width - middle) * spacing;
+        s.center[2] = origin.z;
+        s.radius = radius;
+        uint32_t h = width == 1 ? 0xFFFFFFFFu : (uint32_t)i * 2654435761u;
+        s.color[0] = 96 + (h >> 24) % 160;
+        s.color[1] = 96 + (h >> 16 & 0xFF) % 160;
+        s.color[2] = 96 + (h >> 8 & 0xFF) % 160;
+        s.color[3] = 255;
+    }
+}
 
-            if (i != (stackCount - 1)) {
-                indices.push_back(k1 + 1);
-                indices.push_back(k2);
-                indices.push_back(k2 + 1);
-            }
-        }
+// Fills the screen with spheres of a given on-screen radius and times a fill
+// pass with impostors against one with icosphere meshes at the selected LOD.
+// Impostors cost little per sphere but ray-cast every covered pixel with early
+// depth testing off; meshes cost per triangle. The crossover is the radius
+// above which the meshes win.
+void runImpostorCrossover(GLuint meshProgram, const GpuMesh& icosphere, SphereImpostorRenderer& impostors) {
+    const float distance = 10.0f;
+    const float pixelRadii[] = { 1.0f, 2.0f, 4.0f, 8.0f, 16.0f, 32.0f, 64.0f, 128.0f, 256.0f };
+    glm::mat4 view(1.0f);  // looking down -z from the origin
+    glm::mat4 projection = glm::perspective(glm::radians(fov), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+    float pixelsPerUnit = projection[1][1] * SCR_HEIGHT * 0.5f;
+    unsigned int maxLevel = icosphere.lods.empty() ? 0 : icosphere.lods.size() - 1;
+
+    std::cout << "Impostor crossover, " << CROSSOVER_FRAMES << " frames per size:" << std::endl;
+    float crossover = 0.0f;
+    std::vector<SphereInstance> instances;
+    for (size_t i = 0; i < sizeof(pixelRadii) / sizeof(pixelRadii[0]); ++i) {
+        float pixels = pixelRadii[i];
+        float radius = pixels * distance / pixelsPerUnit;
+        int width = std::max(1, (int)(SCR_HEIGHT / (2.0f * pixels)));
+        if (width % 2 == 0)
+            ++width;
+        IcosphereLODSelector selector(maxLevel);
+        unsigned int level = selector.select(radius, distance, glm::radians(fov), (float)SCR_HEIGHT);
+
+        buildGridInstances(instances, width, 2.0f * radius, radius, glm::vec3(0.0f, 0.0f, -distance));
+        uploadSphereInstances(impostors, instances.data(), instances.size());
+        RenderBenchmark impostor = benchmarkRender([&]() {
+            drawSphereImpostors(impostors, glm::value_ptr(view), glm::value_ptr(projection));
+        }, CROSSOVER_FRAMES);
+
+        // The mesh grid is the same one, from gridOffset() in unit-sphere space scaled by the model matrix
+        glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -distance)), glm::vec3(radius));
+        RenderBenchmark mesh = benchmarkRender([&]() {
+            glUseProgram(meshProgram);
+            setMatrixUniforms(meshProgram, model, view, projection);
+            glUniform1i(glGetUniformLocation(meshProgram, "gridWidth"), width);
+            glUniform1f(glGetUniformLocation(meshProgram, "gridSpacing"), 2.0f);
+            glUniform1i(glGetUniformLocation(meshProgram, "isWireframe"), GL_FALSE);
+            setMeshDecodeUniforms(meshProgram, icosphere);
+            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+            drawMeshLOD(icosphere, level, GL_TRIANGLES, width * width);
+        }, CROSSOVER_FRAMES);
+
+        std::cout << "  " << pixels << " px, " << width * width << " spheres: impostors " << impostor.gpuMs
+                  << " ms, LOD " << level << " meshes " << mesh.gpuMs << " ms ("
+                  << mesh.primitives << " triangles)" << std::endl;
+        if (crossover == 0.0f && mesh.gpuMs < impostor.gpuMs)
+            crossover = pixels;
     }
+    if (crossover > 0.0f)
+        std::cout << "Meshes win from about " << crossover << " px radius up" << std::endl;
+    else
+        std::cout << "Impostors win at every size tried" << std::endl;
 }
 
 int main() {
     glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "OpenGL Sphere with Camera Control", NULL, NULL);
+    // Tessellation needs a 4.x context, fall back to 3.3 without it
+    const int contextVersions[2][2] = { { 4, 1 }, { 3, 3 } };
+    GLFWwindow* window = NULL;
+    for (int i = 0; i < 2 && window == NULL; ++i) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, contextVersions[i][0]);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, contextVersions[i][1]);
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "OpenGL Sphere with Camera Control", NULL, NULL);
+    }
     if (window == NULL) {
         std::cout << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
@@ -147,25 +462,68 @@ int main() {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
-
-    std::vector<float> vertices;
-    std::vector<unsigned int> indices;
-    createSphere(vertices, indices, 1.0f, 36, 18); // Radius, sectors, stacks
-
-    unsigned int VBO, VAO, EBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
-
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+    installGLStateCache();
+
+    // The spheres never move on their own, so the loop sleeps until the
+    // camera or one of the modes changes
+    IdleFrames idleFrames;
+    initIdleFrames(idleFrames, window);
+
+    // Use the exported meshes when meshExport has been run, otherwise build them here
+    GpuMesh uvSphere = loadMeshOr("meshes/sphere.rwm", [] { return createSphereMesh(1.0f, 36, 18); }); // Radius, sectors, stacks
+
+    // Every icosphere level lives in one VBO/EBO pair, a draw just picks its LOD range
+    GpuMesh icosphere = loadMeshOr("meshes/icosphere.rwm", [] { return createIcosphereMesh(1.0f, ICOSPHERE_MAX_LEVEL); });
+    unsigned int maxLevel = icosphere.lods.empty() ? 0 : icosphere.lods.size() - 1;
+    IcosphereLODSelector lodSelector(maxLevel);
+    unsigned int lastLevel = maxLevel + 1;
+
+    // Same LOD chain in the order the generators produce it, with float vertices, to compare draw times against
+    GpuMesh uvSphereRaw = uploadMesh(createSphereMesh(1.0f, 36, 18));
+    GpuMesh icosphereRaw = uploadMesh(createIcosphereMesh(1.0f, ICOSPHERE_MAX_LEVEL));
+
+    // Meshlet bounds in SoA form for the per-frame culling pass. The raw meshes have no meshlets.
+    MeshletCuller uvSphereCuller, icosphereCuller;
+    initMeshletCuller(uvSphereCuller, uvSphere);
+    initMeshletCuller(icosphereCuller, icosphere);
+
+    // Base mesh for the tessellation path, the only geometry it keeps around
+    GpuMesh tessBase = uploadMesh(createIcosphereMesh(1.0f, 0));
+    GLuint tessProgram = 0;
+    if (GLVersion.major >= 4 && GLAD_GL_ARB_tessellation_shader)
+        tessProgram = createShaderProgram(tessVertexShaderSource, fragmentShaderSource, NULL,
+                                          tessControlShaderSource, tessEvaluationShaderSource);
+    tessellationSupported = tessProgram != 0;
+    GLuint tessWireProgram = 0;
+    if (tessellationSupported)
+        tessWireProgram = createWireframeProgram(tessVertexShaderSource, tessControlShaderSource, tessEvaluationShaderSource);
+
+    // The procedural path has no vertex data, but core profile still wants a VAO bound to draw
+    GLuint emptyVAO;
+    glGenVertexArrays(1, &emptyVAO);
+    GLuint proceduralProgram = createShaderProgram(proceduralVertexShaderSource, fragmentShaderSource);
+
+    // Single-pass wireframe variants of the programs above
+    GLuint wireProgram = createWireframeProgram(vertexShaderSource);
+    GLuint proceduralWireProgram = createWireframeProgram(proceduralVertexShaderSource);
+
+    // Impostor instances, rebuilt when the grid size changes
+    SphereImpostorRenderer impostors;
+    initSphereImpostors(impostors);
+    std::vector<SphereInstance> gridInstances;
+    int impostorGrid = -1;
+    if (!tessellationSupported)
+        std::cout << "Tessellation shaders unavailable (GL " << GLVersion.major << "." << GLVersion.minor
+                  << "), T only cycles the other paths" << std::endl;
+
+    // Primitives drawn per frame for the HUD, read back once the GPU is done with them
+    GLuint primitiveQuery;
+    glGenQueries(1, &primitiveQuery);
+    bool primitiveQueryPending = false;
+    GLuint64 primitivesDrawn = 0;
+
+    FrameStats frameStats;
+    initFrameStats(frameStats, "OpenGL Sphere with Camera Control");
 
     unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
     glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
@@ -208,36 +566,211 @@ int main() {
 
         processInput(window);
 
+        // Everything the uniforms and draws below are derived from. A pending
+        // triangle count keeps the loop going until the HUD has it.
+        uint64_t frameState = hashFrameValue(FRAME_HASH_SEED, cameraPos);
+        frameState = hashFrameValue(frameState, cameraFront);
+        frameState = hashFrameValue(frameState, fov);
+        frameState = hashFrameValue(frameState, useIcosphere);
+        frameState = hashFrameValue(frameState, useOptimized);
+        frameState = hashFrameValue(frameState, useMeshletCulling);
+        frameState = hashFrameValue(frameState, spherePath);
+        frameState = hashFrameValue(frameState, sphereGrid);
+        frameState = hashFrameValue(frameState, singlePassWireframe);
+        frameState = hashFrameValue(frameState, benchmarkRequested);
+        frameState = hashFrameValue(frameState, crossoverRequested);
+        frameState = hashFrameValue(frameState, primitivesDrawn);
+        if (!frameNeedsRender(idleFrames, frameState) && !primitiveQueryPending) {
+            waitForFrameChange(idleFrames, lastFrame);
+            continue;
+        }
+
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glUseProgram(shaderProgram);
-
         glm::mat4 model = glm::mat4(1.0f);
         glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-        glm::mat4 projection = glm::perspective(glm::radians(fov), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-
-        // Render the Sphere
-        glUniform1i(glGetUniformLocation(shaderProgram, "isWireframe"), GL_FALSE);
-        glBindVertexArray(VAO);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-
-        // Draw wireframe outline
-        glUniform1i(glGetUniformLocation(shaderProgram, "isWireframe"), GL_TRUE);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        float farPlane = sphereGrid > SPHERE_GRID_MESH_LIMIT ? 5000.0f : 100.0f;  // the big grid is 2.5 km across
+        glm::mat4 projection = glm::perspective(glm::radians(fov), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, farPlane);
+
+        // Pick the icosphere level from how big the sphere is on screen
+        unsigned int level = lodSelector.select(1.0f, glm::length(cameraPos), glm::radians(fov), (float)SCR_HEIGHT);
+        if (useIcosphere && level != lastLevel && level < icosphere.lods.size()) {
+            std::cout << "Icosphere LOD " << level << " (" << icosphere.lods[level].indexCount / 3 << " triangles)" << std::endl;
+            lastLevel = level;
+        }
+        const GpuMesh& sphere = useIcosphere ? (useOptimized ? icosphere : icosphereRaw)
+                                             : (useOptimized ? uvSphere : uvSphereRaw);
+
+        // Draws one frame of the sphere (solid, then wireframe) the given way
+        GLsizei instances = SPHERE_GRID_WIDTHS[sphereGrid] * SPHERE_GRID_WIDTHS[sphereGrid];
+        if (impostorGrid != sphereGrid) {
+            buildGridInstances(gridInstances, SPHERE_GRID_WIDTHS[sphereGrid], SPHERE_GRID_SPACING, 1.0f, glm::vec3(0.0f));
+            uploadSphereInstances(impostors, gridInstances.data(), gridInstances.size());
+            impostorGrid = sphereGrid;
+        }
+        MeshletCuller* culler = NULL;
+        auto renderSphere = [&](SpherePath path) {
+            culler = NULL;
+            if (path == SPHERE_PATH_IMPOSTOR) {
+                // Shaded spheres with exact depth, so there is no wireframe pass
+                glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+                drawSphereImpostors(impostors, glm::value_ptr(view * model), glm::value_ptr(projection));
+                return;
+            }
+            if (path == SPHERE_PATH_PROCEDURAL) {
+                GLuint program = singlePassWireframe ? proceduralWireProgram : proceduralProgram;
+                glUseProgram(program);
+                setMatrixUniforms(program, model, view, projection);
+                glUniform1f(glGetUniformLocation(program, "radius"), 1.0f);
+                glUniform1i(glGetUniformLocation(program, "sectors"), PROCEDURAL_SECTORS);
+                glUniform1i(glGetUniformLocation(program, "stacks"), PROCEDURAL_STACKS);
+                glBindVertexArray(emptyVAO);
+                drawSolidAndWireframe(program, singlePassWireframe, [&]() {
+                    glDrawArraysInstanced(GL_TRIANGLES, 0, PROCEDURAL_SECTORS * PROCEDURAL_STACKS * 6, instances);
+                });
+                return;
+            }
+            if (path == SPHERE_PATH_TESSELLATION) {
+                GLuint program = singlePassWireframe ? tessWireProgram : tessProgram;
+                glUseProgram(program);
+                setMatrixUniforms(program, model, view, projection);
+                glUniform1f(glGetUniformLocation(program, "radius"), 1.0f);
+                glUniform1f(glGetUniformLocation(program, "pixelsPerUnit"), projection[1][1] * SCR_HEIGHT * 0.5f);
+                glUniform1f(glGetUniformLocation(program, "targetEdgePixels"), TESS_TARGET_EDGE_PIXELS);
+                glPatchParameteri(GL_PATCH_VERTICES, 3);
+                drawSolidAndWireframe(program, singlePassWireframe, [&]() {
+                    drawMesh(tessBase, GL_PATCHES, instances);
+                });
+                return;
+            }
+
+            GLuint program = singlePassWireframe ? wireProgram : shaderProgram;
+            glUseProgram(program);
+            setMatrixUniforms(program, model, view, projection);
+            setMeshDecodeUniforms(program, sphere);
+
+            // Cull the meshlets of the LOD about to be drawn, both passes reuse the result.
+            // The culler only knows about one sphere, so the grid is drawn whole.
+            if (useMeshletCulling && !sphere.meshlets.empty() && instances == 1) {
+                culler = useIcosphere ? &icosphereCuller : &uvSphereCuller;
+                size_t first = 0, count = sphere.meshlets.size();
+                if (!sphere.lods.empty()) {
+                    const MeshLOD& lod = sphere.lods[std::min<size_t>(level, sphere.lods.size() - 1)];
+                    meshletRange(sphere.meshlets, lod.firstIndex, lod.indexCount, first, count);
+                }
+                glm::mat4 mvp = projection * view * model;
+                glm::vec3 eye = glm::vec3(glm::inverse(model) * glm::vec4(cameraPos, 1.0f));
+                cullMeshlets(*culler, sphere, first, count, glm::value_ptr(mvp), &eye[0]);
+            }
+
+            // Render the Sphere with its wireframe outline
+            drawSolidAndWireframe(program, singlePassWireframe, [&]() {
+                if (culler)
+                    drawCulledMeshlets(*culler, sphere);
+                else
+                    drawMeshLOD(sphere, level, GL_TRIANGLES, instances);
+            });
+        };
+
+        if (benchmarkRequested) {
+            benchmarkRequested = false;
+            std::cout << "Benchmark, " << BENCHMARK_FRAMES << " frames per path from the current view, "
+                      << instances << (instances == 1 ? " sphere:" : " spheres:") << std::endl;
+            for (int p = 0; p < SPHERE_PATH_COUNT; ++p) {
+                if (p == SPHERE_PATH_TESSELLATION && !tessellationSupported)
+                    continue;
+                if (p != SPHERE_PATH_IMPOSTOR && sphereGrid > SPHERE_GRID_MESH_LIMIT) {
+                    std::cout << "  " << spherePathNames[p] << ": skipped at this grid size" << std::endl;
+                    continue;
+                }
+                size_t bytes = p == SPHERE_PATH_TESSELLATION ? meshGeometryBytes(tessBase)
+                             : p == SPHERE_PATH_PROCEDURAL ? 0
+                             : p == SPHERE_PATH_IMPOSTOR ? sphereImpostorBytes(impostors) : meshGeometryBytes(sphere);
+                // Triangle paths are timed with both wireframe methods
+                bool savedWireframe = singlePassWireframe;
+                for (int singlePass = 1; singlePass >= (p == SPHERE_PATH_IMPOSTOR ? 1 : 0); --singlePass) {
+                    singlePassWireframe = singlePass != 0;
+                    RenderBenchmark result = benchmarkRender([&]() { renderSphere((SpherePath)p); }, BENCHMARK_FRAMES);
+                    std::cout << "  " << spherePathNames[p];
+                    if (p != SPHERE_PATH_IMPOSTOR)
+                        std::cout << (singlePass ? " (single-pass wireframe)" : " (two-pass wireframe)");
+                    std::cout << ": " << result.cpuMs << " ms CPU, " << result.gpuMs << " ms GPU, "
+                              << result.primitives / spherePassCount((SpherePath)p) << " triangles, "
+                              << bytes << " bytes of geometry" << std::endl;
+                }
+                singlePassWireframe = savedWireframe;
+            }
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        }
+        if (crossoverRequested) {
+            crossoverRequested = false;
+            runImpostorCrossover(shaderProgram, icosphere, impostors);
+            uploadSphereInstances(impostors, gridInstances.data(), gridInstances.size());
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        }
+
+        beginGpuTimer(frameStats);
+        bool countPrimitives = !primitiveQueryPending;
+        if (countPrimitives)
+            glBeginQuery(GL_PRIMITIVES_GENERATED, primitiveQuery);
+        renderSphere(spherePath);
+        if (countPrimitives) {
+            glEndQuery(GL_PRIMITIVES_GENERATED);
+            primitiveQueryPending = true;
+        }
+        endGpuTimer(frameStats);
+
+        GLuint available = 0;
+        glGetQueryObjectuiv(primitiveQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (primitiveQueryPending && available) {
+            glGetQueryObjectui64v(primitiveQuery, GL_QUERY_RESULT, &primitivesDrawn);
+            primitiveQueryPending = false;
+        }
+
+        std::ostringstream hud;
+        if (spherePath == SPHERE_PATH_IMPOSTOR) {
+            hud << "ray-cast impostors, " << sphereImpostorBytes(impostors) << " B instance data";
+        } else if (spherePath == SPHERE_PATH_PROCEDURAL) {
+            hud << "procedural UV sphere " << PROCEDURAL_SECTORS << "x" << PROCEDURAL_STACKS << ", 0 B geometry";
+        } else if (spherePath == SPHERE_PATH_TESSELLATION) {
+            hud << "tessellated icosahedron, " << TESS_TARGET_EDGE_PIXELS << " px edges, "
+                << meshGeometryBytes(tessBase) << " B geometry";
+        } else {
+            hud << (useIcosphere ? "icosphere LOD " : "UV sphere");
+            if (useIcosphere)
+                hud << level;
+            hud << (useOptimized ? ", optimized" : ", raw order") << ", " << sphere.vertexStride << " B/vertex";
+            if (culler)
+                hud << ", " << (int)(meshletCulledTriangleRatio(culler->stats) * 100.0f + 0.5f) << "% triangles culled in "
+                    << culler->stats.meshlets << " meshlets";
+        }
+        if (instances > 1)
+            hud << ", " << instances << " spheres";
+        if (spherePath != SPHERE_PATH_IMPOSTOR)
+            hud << (singlePassWireframe ? ", 1-pass" : ", 2-pass") << " wireframe";
+        hud << ", " << primitivesDrawn / spherePassCount(spherePath) << " triangles, idle " << idleFrames.waits << " times";
+        frameStats.hud = hud.str();
+        updateFrameStats(frameStats, window, deltaTime);
 
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
+    destroyMesh(uvSphere);
+    destroyMesh(icosphere);
+    destroyMesh(uvSphereRaw);
+    destroyMesh(icosphereRaw);
+    destroyMesh(tessBase);
+    glDeleteQueries(1, &primitiveQuery);
+    glDeleteProgram(tessProgram);
+    glDeleteProgram(proceduralProgram);
+    glDeleteProgram(tessWireProgram);
+    glDeleteProgram(wireProgram);
+    glDeleteProgram(proceduralWireProgram);
+    glDeleteVertexArrays(1, &emptyVAO);
+    destroySphereImpostors(impostors);
+    destroyFrameStats(frameStats);
 
     glfwTerminate();
     return 0;
@@ -0,0 +1,154 @@
+#ifndef SPHERE_IMPOSTOR_H
+#define SPHERE_IMPOSTOR_H
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <cstddef>
+#include "shaderUtil.h"
+
+// Ray-cast sphere impostors. Each sphere is one camera-facing quad (four
+// vertices from gl_VertexID, no vertex buffer); the fragment shader intersects
+// the view ray with the sphere, discards misses and writes the true depth and
+// normal of the hit. A sphere costs one instance record and two triangles no
+// matter how close it gets, instead of a few hundred to a few thousand
+// triangles for a mesh.
+//
+// The quad sits at the near side of the sphere, perpendicular to the
+// eye-to-center ray, with half-size equal to the radius. The silhouette cone
+// is narrower than that at that depth, so the quad always covers it.
+
+struct SphereInstance {
+    float center[3];   // world space
+    float radius;
+    uint8_t color[4];  // RGBA8
+};
+
+const char* const sphereImpostorVertexShaderSource = R"glsl(
+#version 330 core
+layout (location = 0) in vec4 aSphere;  // center, radius (per instance)
+layout (location = 1) in vec4 aColor;
+uniform mat4 view;
+uniform mat4 projection;
+out vec3 viewPos;
+flat out vec3 sphereCenter;
+flat out float sphereRadius;
+flat out vec3 sphereColor;
+void main()
+{
+    vec3 center = vec3(view * vec4(aSphere.xyz, 1.0));
+    float radius = aSphere.w;
+    sphereCenter = center;
+    sphereRadius = radius;
+    sphereColor = aColor.rgb;
+
+    // Camera inside the sphere: collapse the quad
+    float centerDistance = length(center);
+    if (centerDistance <= radius) {
+        viewPos = vec3(0.0);
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        return;
+    }
+    vec3 dir = center / centerDistance;
+    vec3 up = abs(dir.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+    vec3 right = normalize(cross(dir, up));
+    up = cross(right, dir);
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+    viewPos = center - dir * radius + (right * corner.x + up * corner.y) * radius;
+    gl_Position = projection * vec4(viewPos, 1.0);
+}
+)glsl";
+
+const char* const sphereImpostorFragmentShaderSource = R"glsl(
+#version 330 core
+in vec3 viewPos;
+flat in vec3 sphereCenter;
+flat in float sphereRadius;
+flat in vec3 sphereColor;
+uniform mat4 projection;
+out vec4 FragColor;
+void main()
+{
+    // Ray from the eye (the view space origin) through this fragment
+    vec3 rayDir = normalize(viewPos);
+    float b = dot(rayDir, sphereCenter);
+    float h = b * b - dot(sphereCenter, sphereCenter) + sphereRadius * sphereRadius;
+    if (h < 0.0)
+        discard;
+    vec3 hit = rayDir * (b - sqrt(h));
+    vec3 normal = (hit - sphereCenter) / sphereRadius;
+
+    vec4 clip = projection * vec4(hit, 1.0);
+    gl_FragDepth = clip.z / clip.w * 0.5 + 0.5;  // default glDepthRange(0, 1)
+
+    float diffuse = max(dot(normal, -rayDir), 0.0);  // light at the eye
+    FragColor = vec4(sphereColor * (0.2 + 0.8 * diffuse), 1.0);
+}
+)glsl";
+
+struct SphereImpostorRenderer {
+    GLuint program;
+    GLuint VAO;
+    GLuint instanceBuffer;
+    GLsizei instanceCount;
+    size_t capacity;  // instances the buffer can hold without reallocating
+};
+
+// Returns false if the shaders did not build
+inline bool initSphereImpostors(SphereImpostorRenderer& renderer) {
+    renderer.program = createShaderProgram(sphereImpostorVertexShaderSource, sphereImpostorFragmentShaderSource);
+    renderer.instanceCount = 0;
+    renderer.capacity = 0;
+
+    glGenVertexArrays(1, &renderer.VAO);
+    glGenBuffers(1, &renderer.instanceBuffer);
+    glBindVertexArray(renderer.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, renderer.instanceBuffer);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(SphereInstance), (void*)offsetof(SphereInstance, center));
+    glEnableVertexAttribArray(0);
+    glVertexAttribDivisor(0, 1);
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SphereInstance), (void*)offsetof(SphereInstance, color));
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(1, 1);
+    glBindVertexArray(0);
+    return renderer.program != 0;
+}
+
+// Replaces the instance data. The buffer only grows, so switching between
+// scenes of different sizes does not reallocate every time.
+inline void uploadSphereInstances(SphereImpostorRenderer& renderer, const SphereInstance* instances, size_t count) {
+    glBindBuffer(GL_ARRAY_BUFFER, renderer.instanceBuffer);
+    if (count > renderer.capacity) {
+        glBufferData(GL_ARRAY_BUFFER, count * sizeof(SphereInstance), instances, GL_STATIC_DRAW);
+        renderer.capacity = count;
+    } else if (count) {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(SphereInstance), instances);
+    }
+    renderer.instanceCount = (GLsizei)count;
+}
+
+// view and projection are column-major 4x4 matrices. Uses the renderer's
+// own program, so the caller's program needs rebinding afterwards.
+inline void drawSphereImpostors(const SphereImpostorRenderer& renderer, const float* view, const float* projection) {
+    if (!renderer.instanceCount)
+        return;
+    glUseProgram(renderer.program);
+    glUniformMatrix4fv(glGetUniformLocation(renderer.program, "view"), 1, GL_FALSE, view);
+    glUniformMatrix4fv(glGetUniformLocation(renderer.program, "projection"), 1, GL_FALSE, projection);
+    glBindVertexArray(renderer.VAO);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, renderer.instanceCount);
+}
+
+inline size_t sphereImpostorBytes(const SphereImpostorRenderer& renderer) {
+    return (size_t)renderer.instanceCount * sizeof(SphereInstance);
+}
+
+inline void destroySphereImpostors(SphereImpostorRenderer& renderer) {
+    glDeleteProgram(renderer.program);
+    glDeleteBuffers(1, &renderer.instanceBuffer);
+    glDeleteVertexArrays(1, &renderer.VAO);
+    renderer.program = renderer.instanceBuffer = renderer.VAO = 0;
+    renderer.instanceCount = 0;
+    renderer.capacity = 0;
+}
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Ring buffer for data written by the CPU every frame (text quads, per-draw
+// uniform blocks, ...) that never makes the driver wait or copy.
+//
+// Updating one small buffer with glBufferSubData between draws makes the
+// driver either stall until the GPU has finished the previous draw or copy
+// the data aside. Here the buffer is split into STREAM_BUFFER_REGIONS
+// regions, one per frame in flight. A frame bump-allocates ranges from its
+// region, writes into them and draws from them; endStreamFrame() puts a fence
+// after the frame's commands, and a region is only handed out again once its
+// fence has passed, which with three regions is normally long ago.
+//
+// With GL_ARB_buffer_storage (GL 4.4) the buffer is mapped once, persistent
+// and coherent, and allocations point straight into it. Without it they point
+// into a copy in system memory and flushStreamBuffer() uploads what was
+// written into the (fenced, so idle) region before the draws that use it.
+
+const int STREAM_BUFFER_REGIONS = 3;
+
+struct StreamRange {
+    void* data;       // write here; NULL when the region is full
+    GLintptr offset;  // in the buffer, for glVertexAttribPointer, glBindBufferRange or draw offsets
+};
+
+struct StreamBuffer {
+    GLuint buffer;
+    size_t regionSize;
+    size_t regionAlignment; // regions start on multiples of this
+    int region;             // the one this frame allocates from
+    size_t used;            // bytes allocated from it so far
+    size_t flushed;         // bytes of it already uploaded (fallback only)
+    unsigned char* mapped;  // whole buffer, persistent mapping
+    std::vector<unsigned char> staging;  // one region, without buffer storage
+    GLsync fences[STREAM_BUFFER_REGIONS];
+    int stalls;             // frames that had to wait for their region
+    int overflows;          // allocations that did not fit
+};
+
+inline bool streamBufferPersistent() {
+    return GLAD_GL_ARB_buffer_storage || GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 4);
+}
+
+inline size_t streamUniformAlignment() {
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    return (size_t)alignment;
+}
+
+// regionSize is the most one frame can allocate. It is rounded up to 256
+// bytes or the uniform buffer offset alignment, whichever is larger, so
+// allocations aligned within a region are aligned in the buffer.
+inline void initStreamBuffer(StreamBuffer& sb, size_t regionSize) {
+    sb = StreamBuffer();
+    size_t uniformAlignment = streamUniformAlignment();
+    sb.regionAlignment = uniformAlignment > 256 ? uniformAlignment : 256;
+    regionSize = (regionSize + sb.regionAlignment - 1) / sb.regionAlignment * sb.regionAlignment;
+    sb.regionSize = regionSize;
+    sb.region = STREAM_BUFFER_REGIONS - 1;  // the first beginStreamFrame moves to region 0
+    size_t size = regionSize * STREAM_BUFFER_REGIONS;
+    glGenBuffers(1, &sb.buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, sb.buffer);
+    if (streamBufferPersistent()) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_WRITE_BUFFER, size, NULL, flags);
+        sb.mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+    } else {
+        glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STREAM_DRAW);
+        sb.staging.resize(regionSize);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+// Moves on to the next region, waiting for the GPU to finish with it first
+inline void beginStreamFrame(StreamBuffer& sb) {
+    sb.region = (sb.region + 1) % STREAM_BUFFER_REGIONS;
+    sb.used = sb.flushed = 0;
+    GLsync& fence = sb.fences[sb.region];
+    if (!fence)
+        return;
+    if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+        ++sb.stalls;
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {
+        }
+    }
+    glDeleteSync(fence);
+    fence = 0;
+}
+
+// Fences the commands that used this frame's region. Call after the frame's
+// last draw from the buffer.
+inline void endStreamFrame(StreamBuffer& sb) {
+    sb.fences[sb.region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+// Bytes from this frame's region, aligned to `alignment` (a power of two no
+// larger than sb.regionAlignment: vertex stride, or streamUniformAlignment()
+// for uniform blocks)
+inline StreamRange streamAllocate(StreamBuffer& sb, size_t bytes, size_t alignment = 16) {
+    size_t start = (sb.used + alignment - 1) & ~(alignment - 1);
+    StreamRange range = { NULL, 0 };
+    if (start + bytes > sb.regionSize) {
+        ++sb.overflows;
+        return range;
+    }
+    sb.used = start + bytes;
+    range.offset = (GLintptr)(sb.region * sb.regionSize + start);
+    range.data = sb.mapped ? sb.mapped + range.offset : sb.staging.data() + start;
+    return range;
+}
+
+// Makes everything allocated so far visible to the GPU. Nothing to do with a
+// persistent coherent mapping; otherwise uploads the new bytes.
+inline void flushStreamBuffer(StreamBuffer& sb) {
+    if (sb.mapped || sb.used == sb.flushed)
+        return;
+    glBindBuffer(GL_COPY_WRITE_BUFFER, sb.buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, sb.region * sb.regionSize + sb.flushed, sb.used - sb.flushed,
+                    sb.staging.data() + sb.flushed);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    sb.flushed = sb.used;
+}
+
+inline void destroyStreamBuffer(StreamBuffer& sb) {
+    for (int i = 0; i < STREAM_BUFFER_REGIONS; ++i)
+        if (sb.fences[i])
+            glDeleteSync(sb.fences[i]);
+    if (sb.mapped) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, sb.buffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &sb.buffer);
+    sb = StreamBuffer();
+}
+
+#endif
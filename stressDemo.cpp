@@ -0,0 +1,607 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include "shapes.h"
+#include "meshFile.h"
+#include "frameStats.h"
+#include "shaderUtil.h"
+#include "geometryArena.h"
+#include "frustumCull.h"
+#include "occlusionCull.h"
+
+// Stress scene: up to a million copies of the demo shapes in a block, each
+// spinning and bobbing on its own. Per-object data lives in one instance
+// buffer and each shape is a single instanced draw, so the workload is vertex
+// throughput and, with CPU animation on, the cost of touching and uploading
+// every object each frame.
+//
+// Usage: ./stressDemo [object count] [cube|pyramid|diamond|sphere]
+//
+// = and - double and halve the object count, 0 mixes all shapes, 1-4 pick
+// one, U moves the bobbing animation from the vertex shader to the CPU, I
+// switches between the geometry arena (one multi-draw-indirect call for
+// everything, needs GL 4.3) and a VAO and instanced draw per shape. C toggles
+// frustum culling (see frustumCull.h): the visible objects are gathered into
+// a second instance buffer each frame and only those are drawn. K times the
+// culling paths on the current view. O toggles two-phase Hi-Z occlusion
+// culling on the GPU (see occlusionCull.h, arena path only), which takes over
+// frustum culling as well.
+
+const char* vertexShaderSource = R"glsl(
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 3) in vec4 aOffset;  // per instance: position, scale
+layout (location = 4) in vec4 aSpin;    // per instance: axis, radians per second
+layout (location = 5) in vec4 aColor;   // per instance
+
+uniform mat4 viewProjection;  // multiplied once on the CPU, not per vertex
+uniform vec3 positionScale;  // packed vertex decode, see vertexCompress.h
+uniform vec3 positionBias;
+uniform float time;
+uniform bool gpuBob;         // false when the CPU has already moved the instances
+
+out vec3 FragPos;
+out vec3 Color;
+
+vec3 rotateAxisAngle(vec3 v, vec3 axis, float angle)
+{
+    float c = cos(angle), s = sin(angle);
+    return v * c + cross(axis, v) * s + axis * dot(axis, v) * (1.0 - c);
+}
+
+void main()
+{
+    vec3 p = (aPos * positionScale + positionBias) * aOffset.w;
+    p = rotateAxisAngle(p, aSpin.xyz, time * aSpin.w);
+    vec3 offset = aOffset.xyz;
+    if (gpuBob)
+        offset.y += 0.5 * sin(time * 2.0 + offset.x + offset.z);
+    FragPos = p + offset;
+    Color = aColor.rgb;
+    gl_Position = viewProjection * vec4(FragPos, 1.0);
+}
+)glsl";
+
+const char* fragmentShaderSource = R"glsl(
+#version 330 core
+in vec3 FragPos;
+in vec3 Color;
+out vec4 FragColor;
+void main()
+{
+    // Flat normals from the screen-space derivatives, the shapes have none of their own
+    vec3 norm = normalize(cross(dFdx(FragPos), dFdy(FragPos)));
+    float diff = abs(dot(norm, normalize(vec3(0.4, 0.8, 0.6))));
+    FragColor = vec4(Color * (0.25 + 0.75 * diff), 1.0);
+}
+)glsl";
+
+const unsigned int SCR_WIDTH = 800;
+const unsigned int SCR_HEIGHT = 600;
+
+// One record per object, 36 bytes
+struct StressInstance {
+    float position[3];
+    float scale;
+    float axis[3];     // spin axis, unit length
+    float spinSpeed;   // radians per second
+    uint8_t color[4];
+};
+
+const int STRESS_MESH_COUNT = 4;
+const char* stressMeshNames[STRESS_MESH_COUNT] = { "cube", "pyramid", "diamond", "sphere" };
+const unsigned int STRESS_SPHERE_LOD = 2;  // 320 triangles
+const size_t STRESS_MAX_OBJECTS = 1000000;
+const float STRESS_SPACING = 2.5f;
+
+size_t objectCount = 10000;
+int stressShape = -1;  // -1 mixes all shapes, otherwise one of stressMeshNames
+bool cpuBob = false;
+bool useArena = true;
+bool arenaSupported = false;
+bool useCulling = true;
+bool cullBenchmarkRequested = false;
+bool useOcclusion = true;
+bool occlusionSupported = false;
+bool sceneDirty = true;
+bool attribsStale = true;  // instance attributes must be pointed at their buffer again
+bool moreKeyWasPressed = false, lessKeyWasPressed = false, bobKeyWasPressed = false, arenaKeyWasPressed = false;
+bool cullKeyWasPressed = false, benchKeyWasPressed = false, occlusionKeyWasPressed = false;
+bool shapeKeyWasPressed[STRESS_MESH_COUNT + 1] = {};
+
+// Camera
+glm::vec3 cameraPos   = glm::vec3(0.0f, 0.0f, 3.0f);
+glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
+glm::vec3 cameraUp    = glm::vec3(0.0f, 1.0f, 0.0f);
+float cameraSpeedScale = 1.0f;
+float fov = 45.0f;
+
+// Timing
+float deltaTime = 0.0f;
+float lastFrame = 0.0f;
+
+void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
+    glViewport(0, 0, width, height);
+}
+
+void processInput(GLFWwindow *window) {
+    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, true);
+
+    float cameraSpeed = 2.5f * cameraSpeedScale * deltaTime;
+    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+        cameraPos += cameraSpeed * cameraFront;
+    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+        cameraPos -= cameraSpeed * cameraFront;
+    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+        cameraPos -= glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
+    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+        cameraPos += glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
+
+    bool moreKeyPressed = glfwGetKey(window, GLFW_KEY_EQUAL) == GLFW_PRESS;
+    if (moreKeyPressed && !moreKeyWasPressed && objectCount < STRESS_MAX_OBJECTS) {
+        objectCount = std::min(objectCount * 2, STRESS_MAX_OBJECTS);
+        sceneDirty = true;
+    }
+    moreKeyWasPressed = moreKeyPressed;
+
+    bool lessKeyPressed = glfwGetKey(window, GLFW_KEY_MINUS) == GLFW_PRESS;
+    if (lessKeyPressed && !lessKeyWasPressed && objectCount > 1) {
+        objectCount /= 2;
+        sceneDirty = true;
+    }
+    lessKeyWasPressed = lessKeyPressed;
+
+    for (int i = 0; i <= STRESS_MESH_COUNT; ++i) {
+        bool pressed = glfwGetKey(window, GLFW_KEY_0 + i) == GLFW_PRESS;
+        if (pressed && !shapeKeyWasPressed[i] && stressShape != i - 1) {
+            stressShape = i - 1;
+            sceneDirty = true;
+        }
+        shapeKeyWasPressed[i] = pressed;
+    }
+
+    bool bobKeyPressed = glfwGetKey(window, GLFW_KEY_U) == GLFW_PRESS;
+    if (bobKeyPressed && !bobKeyWasPressed) {
+        cpuBob = !cpuBob;
+        std::cout << (cpuBob ? "CPU animation" : "GPU animation") << std::endl;
+    }
+    bobKeyWasPressed = bobKeyPressed;
+
+    bool arenaKeyPressed = glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS;
+    if (arenaKeyPressed && !arenaKeyWasPressed && arenaSupported) {
+        useArena = !useArena;
+        attribsStale = true;
+        std::cout << (useArena ? "Geometry arena, one indirect draw" : "One VAO and draw per shape") << std::endl;
+    }
+    arenaKeyWasPressed = arenaKeyPressed;
+
+    bool cullKeyPressed = glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS;
+    if (cullKeyPressed && !cullKeyWasPressed) {
+        useCulling = !useCulling;
+        attribsStale = true;
+        std::cout << (useCulling ? "Frustum culling on" : "Frustum culling off") << std::endl;
+    }
+    cullKeyWasPressed = cullKeyPressed;
+
+    bool benchKeyPressed = glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS;
+    if (benchKeyPressed && !benchKeyWasPressed)
+        cullBenchmarkRequested = true;
+    benchKeyWasPressed = benchKeyPressed;
+
+    bool occlusionKeyPressed = glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS;
+    if (occlusionKeyPressed && !occlusionKeyWasPressed && occlusionSupported) {
+        useOcclusion = !useOcclusion;
+        attribsStale = true;
+        std::cout << (useOcclusion ? "Occlusion culling on" : "Occlusion culling off") << std::endl;
+    }
+    occlusionKeyWasPressed = occlusionKeyPressed;
+}
+
+// Small deterministic hash so every run builds the same scene
+inline uint32_t hashIndex(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7FEB352Du;
+    x ^= x >> 15;
+    x *= 0x846CA68Bu;
+    x ^= x >> 16;
+    return x;
+}
+
+inline float hashUnit(uint32_t x) {
+    return (hashIndex(x) >> 8) * (1.0f / 16777216.0f);
+}
+
+// Lays `count` objects out on a cube-shaped grid. The instance array is
+// grouped by shape so each shape draws one contiguous range; firstInstance
+// and instanceCount receive the ranges. Returns the half-size of the block.
+float buildStressScene(size_t count, int shape, std::vector<StressInstance>& instances,
+                       size_t firstInstance[STRESS_MESH_COUNT], size_t instanceCount[STRESS_MESH_COUNT]) {
+    for (int m = 0; m < STRESS_MESH_COUNT; ++m)
+        instanceCount[m] = shape < 0 ? count / STRESS_MESH_COUNT + (m < (int)(count % STRESS_MESH_COUNT)) : (m == shape ? count : 0);
+    size_t next[STRESS_MESH_COUNT];
+    size_t first = 0;
+    for (int m = 0; m < STRESS_MESH_COUNT; ++m) {
+        firstInstance[m] = next[m] = first;
+        first += instanceCount[m];
+    }
+
+    int side = (int)ceil(cbrt((double)count));
+    float half = (side - 1) * STRESS_SPACING * 0.5f;
+    instances.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        int m = shape < 0 ? (int)(i % STRESS_MESH_COUNT) : shape;
+        StressInstance& inst = instances[next[m]++];
+        inst.position[0] = (i % side) * STRESS_SPACING - half;
+        inst.position[1] = (i / side % side) * STRESS_SPACING - half;
+        inst.position[2] = (i / ((size_t)side * side)) * STRESS_SPACING - half;
+        inst.scale = 0.5f + 0.5f * hashUnit(4 * i);
+        glm::vec3 axis = glm::normalize(glm::vec3(hashUnit(4 * i + 1), hashUnit(4 * i + 2), hashUnit(4 * i + 3)) - 0.5f + 1e-3f);
+        inst.axis[0] = axis.x;
+        inst.axis[1] = axis.y;
+        inst.axis[2] = axis.z;
+        inst.spinSpeed = 0.5f + 2.0f * hashUnit(i ^ 0x9E3779B9u);
+        uint32_t h = hashIndex(i + 12345);
+        inst.color[0] = 64 + (h & 0xFF) % 192;
+        inst.color[1] = 64 + (h >> 8 & 0xFF) % 192;
+        inst.color[2] = 64 + (h >> 16 & 0xFF) % 192;
+        inst.color[3] = 255;
+    }
+    return half;
+}
+
+// Culling bounds for the scene. Objects spin about their origin, so the
+// sphere around the origin that holds the whole mesh covers every rotation;
+// the box adds the bobbing height in y. meshRadius is that sphere at scale 1.
+void buildStressBounds(const std::vector<StressInstance>& instances, const float meshRadius[STRESS_MESH_COUNT],
+                       const size_t firstInstance[STRESS_MESH_COUNT], FrustumCuller& culler) {
+    resizeFrustumCuller(culler, instances.size());
+    for (int m = 0; m < STRESS_MESH_COUNT; ++m) {
+        for (size_t i = firstInstance[m]; i < (m + 1 < STRESS_MESH_COUNT ? firstInstance[m + 1] : instances.size()); ++i) {
+            float r = meshRadius[m] * instances[i].scale;
+            float extent[3] = { r, r + 0.5f, r };
+            setCullBounds(culler, i, instances[i].position, r + 0.5f, extent);
+        }
+    }
+}
+
+// Points the per-instance attributes of a VAO at the instance buffer from
+// firstInstance on. Per-shape VAOs get their range start baked in here since
+// GL 3.3 has no base instance; the arena VAO uses 0 and lets each indirect
+// command's baseInstance pick the range.
+void bindInstanceAttribs(GLuint vao, GLuint instanceBuffer, size_t firstInstance) {
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    size_t base = firstInstance * sizeof(StressInstance);
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(StressInstance), (void*)(base + offsetof(StressInstance, position)));
+    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(StressInstance), (void*)(base + offsetof(StressInstance, axis)));
+    glVertexAttribPointer(5, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(StressInstance), (void*)(base + offsetof(StressInstance, color)));
+    for (GLuint location = 3; location <= 5; ++location) {
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, 1);
+    }
+    glBindVertexArray(0);
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1)
+        objectCount = std::max<size_t>(1, std::min<size_t>(strtoul(argv[1], NULL, 10), STRESS_MAX_OBJECTS));
+    if (argc > 2) {
+        for (int m = 0; m < STRESS_MESH_COUNT; ++m)
+            if (strcmp(argv[2], stressMeshNames[m]) == 0)
+                stressShape = m;
+    }
+
+    glfwInit();
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    // Multi-draw indirect needs a 4.3 context, fall back to 3.3 without it
+    const int contextVersions[2][2] = { { 4, 3 }, { 3, 3 } };
+    GLFWwindow* window = NULL;
+    for (int i = 0; i < 2 && window == NULL; ++i) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, contextVersions[i][0]);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, contextVersions[i][1]);
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Stress Demo", NULL, NULL);
+    }
+    if (window == NULL) {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return -1;
+    }
+    installGLStateCache();
+
+    GpuMesh meshes[STRESS_MESH_COUNT] = {
+        loadMeshOr("meshes/cube.rwm", [] { return createCubeMesh(); }),
+        loadMeshOr("meshes/triPyramid.rwm", [] { return createTriPyramidMesh(); }),
+        loadMeshOr("meshes/diamond.rwm", [] { return createDiamondMesh(); }),
+        loadMeshOr("meshes/icosphere.rwm", [] { return createIcosphereMesh(1.0f, 5); }),
+    };
+    size_t meshTriangles[STRESS_MESH_COUNT];
+    for (int m = 0; m < STRESS_MESH_COUNT; ++m) {
+        const GpuMesh& mesh = meshes[m];
+        GLsizei indices = mesh.lods.empty() ? mesh.indexCount
+                        : mesh.lods[std::min<size_t>(STRESS_SPHERE_LOD, mesh.lods.size() - 1)].indexCount;
+        meshTriangles[m] = (mesh.indexType ? indices : mesh.vertexCount) / 3;
+    }
+    float meshRadius[STRESS_MESH_COUNT];
+    for (int m = 0; m < STRESS_MESH_COUNT; ++m) {
+        const MeshBounds& b = meshes[m].bounds;
+        meshRadius[m] = sqrtf(b.center[0] * b.center[0] + b.center[1] * b.center[1] + b.center[2] * b.center[2]) + b.radius;
+    }
+
+    // The same four shapes again, all in one set of buffers
+    MeshData shapeData[STRESS_MESH_COUNT] = {
+        createCubeMesh(), createTriPyramidMesh(), createDiamondMesh(), createIcosphereMesh(1.0f, 5)
+    };
+    GeometryArena arena;
+    for (int m = 0; m < STRESS_MESH_COUNT; ++m)
+        addArenaMesh(arena, shapeData[m], stressMeshNames[m]);
+    uploadGeometryArena(arena);
+    arenaSupported = arenaIndirectSupported() && arena.meshes.size() == STRESS_MESH_COUNT;
+    useArena = arenaSupported;
+    if (!arenaSupported)
+        std::cout << "Multi-draw indirect unavailable (GL " << GLVersion.major << "." << GLVersion.minor
+                  << "), drawing each shape on its own" << std::endl;
+    std::vector<DrawElementsIndirectCommand> commands;
+
+    // GPU occlusion culling draws through the arena with GPU-written commands
+    OcclusionCuller occlusion = OcclusionCuller();
+    if (arenaSupported && occlusionCullSupported())
+        occlusionSupported = initOcclusionCuller(occlusion);
+    useOcclusion = occlusionSupported;
+    if (!occlusionSupported)
+        std::cout << "Occlusion culling unavailable, it needs GL 4.3 compute shaders" << std::endl;
+    const int arenaMeshIds[STRESS_MESH_COUNT] = { 0, 1, 2, 3 };
+    const float bobPadding[3] = { 0.0f, 0.5f, 0.0f };  // the bobbing the vertex shader adds
+
+    GLuint shaderProgram = createShaderProgram(vertexShaderSource, fragmentShaderSource);
+
+    // All instances, and the ones that survived this frame's cull
+    GLuint instanceBuffer, visibleBuffer;
+    glGenBuffers(1, &instanceBuffer);
+    glGenBuffers(1, &visibleBuffer);
+    std::vector<StressInstance> instances, visibleInstances;
+    FrustumCuller culler;
+    std::cout << "Frustum culling: " << frustumCullPathNames[bestFrustumCullPath()] << ", up to "
+              << frustumCullThreadCount(STRESS_MAX_OBJECTS) << " threads" << std::endl;
+    std::vector<float> restingY;  // CPU animation moves position[1] away from these
+    bool cpuBobWasOn = cpuBob;
+    size_t firstInstance[STRESS_MESH_COUNT], instanceCount[STRESS_MESH_COUNT];
+
+    glEnable(GL_DEPTH_TEST);
+
+    FrameStats frameStats;
+    initFrameStats(frameStats, "Stress Demo");
+    double submitMsSum = 0.0;
+    int submitFrames = 0;
+    double submitMs = 0.0;
+    // Occlusion counters are read back once per report, and the GPU time of
+    // report intervals spent entirely with or without it kept for comparison
+    bool occlusionStatsDue = true;
+    bool occlusionWasActive = false, occlusionModeChanged = true;
+    double gpuMsWithOcclusion = 0.0, gpuMsWithoutOcclusion = 0.0;
+
+    while (!glfwWindowShouldClose(window)) {
+        float currentFrame = glfwGetTime();
+        deltaTime = currentFrame - lastFrame;
+        lastFrame = currentFrame;
+
+        processInput(window);
+
+        if (sceneDirty) {
+            float half = buildStressScene(objectCount, stressShape, instances, firstInstance, instanceCount);
+            restingY.resize(instances.size());
+            for (size_t i = 0; i < instances.size(); ++i)
+                restingY[i] = instances[i].position[1];
+            glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+            glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(StressInstance), instances.data(), GL_STREAM_DRAW);
+            buildStressBounds(instances, meshRadius, firstInstance, culler);
+            if (occlusionSupported)
+                setOcclusionObjects(occlusion, arena, instances.size(), sizeof(StressInstance), arenaMeshIds,
+                                    firstInstance, instanceCount, meshRadius, STRESS_MESH_COUNT, STRESS_SPHERE_LOD);
+            attribsStale = true;
+
+            // Back off far enough to see the whole front face of the block
+            cameraPos = glm::vec3(0.0f, 0.0f, half + (half * 1.2f + 2.0f) / tanf(glm::radians(fov) * 0.5f));
+            cameraSpeedScale = std::max(1.0f, half * 0.25f);
+            std::cout << objectCount << " objects (" << instances.size() * sizeof(StressInstance) / 1024
+                      << " KB of instance data)" << std::endl;
+            sceneDirty = false;
+        }
+        // Back to the shader's animation, which bobs around the resting height
+        if (cpuBobWasOn && !cpuBob) {
+            for (size_t i = 0; i < instances.size(); ++i)
+                instances[i].position[1] = restingY[i];
+            glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+            glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(StressInstance), instances.data(), GL_STREAM_DRAW);
+        }
+        cpuBobWasOn = cpuBob;
+
+        // Occlusion culling renders into its own target so it can read the depth
+        bool occlusionActive = occlusionSupported && useOcclusion && useArena;
+        if (occlusionActive != occlusionWasActive)
+            occlusionModeChanged = true;
+        occlusionWasActive = occlusionActive;
+        bool cpuCulling = useCulling && !occlusionActive;
+        if (occlusionActive) {
+            int width, height;
+            glfwGetFramebufferSize(window, &width, &height);
+            resizeOcclusionTargets(occlusion, width, height);
+            glBindFramebuffer(GL_FRAMEBUFFER, occlusion.framebuffer);
+        }
+
+        glClearColor(0.1f, 0.1f, 0.12f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        float farPlane = glm::length(cameraPos) * 2.0f + 100.0f;
+        glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
+        glm::mat4 projection = glm::perspective(glm::radians(fov), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, farPlane);
+        glm::mat4 viewProjection = projection * view;
+
+        if (cullBenchmarkRequested) {
+            benchmarkFrustumCull(culler, glm::value_ptr(viewProjection));
+            cullBenchmarkRequested = false;
+        }
+
+        // Submission: everything the CPU does for the objects this frame
+        double submitStart = glfwGetTime();
+        if (cpuBob) {
+            for (size_t i = 0; i < instances.size(); ++i) {
+                StressInstance& inst = instances[i];
+                inst.position[1] = restingY[i] + 0.5f * sinf(currentFrame * 2.0f + inst.position[0] + inst.position[2]);
+            }
+            // Orphan the old storage so the upload does not wait on last frame's draws.
+            // With culling on only the visible instances are uploaded, below.
+            if (!cpuCulling) {
+                glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+                glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(StressInstance), NULL, GL_STREAM_DRAW);
+                glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(StressInstance), instances.data());
+            }
+        }
+
+        // The instance range each shape draws from, in whichever buffer is drawn
+        size_t drawFirst[STRESS_MESH_COUNT], drawCount[STRESS_MESH_COUNT];
+        if (cpuCulling) {
+            // The visible list is ascending, so it is still grouped by shape
+            size_t visible = frustumCull(culler, glm::value_ptr(viewProjection));
+            const uint32_t* visibleIndex = culler.visible.data();
+            visibleInstances.resize(visible);
+            for (size_t v = 0; v < visible; ++v)
+                visibleInstances[v] = instances[visibleIndex[v]];
+            for (int m = 0; m < STRESS_MESH_COUNT; ++m) {
+                drawFirst[m] = std::lower_bound(visibleIndex, visibleIndex + visible, (uint32_t)firstInstance[m]) - visibleIndex;
+                drawCount[m] = std::lower_bound(visibleIndex, visibleIndex + visible,
+                                                (uint32_t)(firstInstance[m] + instanceCount[m])) - visibleIndex - drawFirst[m];
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, visibleBuffer);
+            glBufferData(GL_ARRAY_BUFFER, visible * sizeof(StressInstance), NULL, GL_STREAM_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, visible * sizeof(StressInstance), visibleInstances.data());
+        } else {
+            std::copy(firstInstance, firstInstance + STRESS_MESH_COUNT, drawFirst);
+            std::copy(instanceCount, instanceCount + STRESS_MESH_COUNT, drawCount);
+        }
+        // The culled ranges move every frame, the full ones only with the scene
+        if (cpuCulling || attribsStale) {
+            GLuint drawBuffer = occlusionActive ? occlusion.drawnBuffer : cpuCulling ? visibleBuffer : instanceBuffer;
+            for (int m = 0; m < STRESS_MESH_COUNT; ++m)
+                bindInstanceAttribs(meshes[m].VAO, drawBuffer, drawFirst[m]);
+            bindInstanceAttribs(arena.VAO, drawBuffer, 0);
+            attribsStale = false;
+        }
+
+        glUseProgram(shaderProgram);
+        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "viewProjection"), 1, GL_FALSE, glm::value_ptr(viewProjection));
+        glUniform1f(glGetUniformLocation(shaderProgram, "time"), currentFrame);
+        glUniform1i(glGetUniformLocation(shaderProgram, "gpuBob"), !cpuBob);
+
+        beginGpuTimer(frameStats);
+        size_t triangles = 0;
+        int draws = 0;
+        if (occlusionActive) {
+            // Last frame's visible set, then the Hi-Z test, then what it revealed
+            const float* vp = glm::value_ptr(viewProjection);
+            beginOcclusionFrame(occlusion);
+            cullOcclusionPhase(occlusion, OCCLUSION_EARLY, instanceBuffer, vp, bobPadding);
+            glUseProgram(shaderProgram);
+            setArenaDecodeUniforms(shaderProgram, arena);
+            drawOcclusionPhase(occlusion, arena, OCCLUSION_EARLY);
+            buildHiZPyramid(occlusion);
+            cullOcclusionPhase(occlusion, OCCLUSION_LATE, instanceBuffer, vp, bobPadding);
+            glUseProgram(shaderProgram);
+            drawOcclusionPhase(occlusion, arena, OCCLUSION_LATE);
+            blitOcclusionFramebuffer(occlusion);
+            if (occlusionStatsDue) {
+                readOcclusionStats(occlusion);
+                occlusionStatsDue = false;
+            }
+            triangles = occlusion.stats.triangles;
+            draws = 2;
+        } else if (useArena) {
+            // Every shape in one call, the command list is rebuilt each frame
+            commands.clear();
+            for (int m = 0; m < STRESS_MESH_COUNT; ++m) {
+                if (!drawCount[m])
+                    continue;
+                commands.push_back(arenaDrawCommand(arena, m, STRESS_SPHERE_LOD, drawCount[m], drawFirst[m]));
+                triangles += commands.back().count / 3 * drawCount[m];
+            }
+            setArenaDecodeUniforms(shaderProgram, arena);
+            drawGeometryArena(arena, commands.data(), commands.size());
+            draws = 1;
+        } else {
+            for (int m = 0; m < STRESS_MESH_COUNT; ++m) {
+                if (!drawCount[m])
+                    continue;
+                setMeshDecodeUniforms(shaderProgram, meshes[m]);
+                drawMeshLOD(meshes[m], STRESS_SPHERE_LOD, GL_TRIANGLES, drawCount[m]);
+                triangles += meshTriangles[m] * drawCount[m];
+                ++draws;
+            }
+        }
+        endGpuTimer(frameStats);
+        submitMsSum += (glfwGetTime() - submitStart) * 1000.0;
+        ++submitFrames;
+
+        std::ostringstream hud;
+        hud << objectCount << " " << (stressShape < 0 ? "mixed" : stressMeshNames[stressShape]) << ", ";
+        if (occlusionActive) {
+            const OcclusionCullStats& o = occlusion.stats;
+            hud << o.inFrustum << " in frustum, " << o.occluded << " occluded, " << o.earlyDrawn << "+" << o.lateDrawn
+                << " drawn, ";
+        } else if (cpuCulling)
+            hud << culler.stats.visible << " visible (cull " << std::fixed << std::setprecision(2) << culler.stats.ms << " ms), ";
+        hud << std::fixed << std::setprecision(1) << triangles / 1.0e6 << "M triangles, "
+            << (cpuBob ? "CPU" : "GPU") << " animation, " << draws << (useArena ? " indirect" : "")
+            << (draws == 1 ? " draw" : " draws") << ", submit " << std::setprecision(2) << submitMs << " ms";
+        if (gpuMsWithOcclusion > 0.0 && gpuMsWithoutOcclusion > 0.0)
+            hud << ", occlusion culling " << gpuMsWithoutOcclusion << " -> " << gpuMsWithOcclusion << " ms ("
+                << std::showpos << std::setprecision(0) << (gpuMsWithOcclusion / gpuMsWithoutOcclusion - 1.0) * 100.0
+                << std::noshowpos << "%)";
+        if (frameStats.lastGpuMs > 0.0)
+            hud << ", " << std::setprecision(0) << triangles / (frameStats.lastGpuMs * 1000.0) << "M tris/s";
+        frameStats.hud = hud.str();
+        if (updateFrameStats(frameStats, window, deltaTime)) {
+            submitMs = submitMsSum / submitFrames;
+            submitMsSum = 0.0;
+            submitFrames = 0;
+            if (!occlusionModeChanged && frameStats.lastGpuMs > 0.0)
+                (occlusionActive ? gpuMsWithOcclusion : gpuMsWithoutOcclusion) = frameStats.lastGpuMs;
+            occlusionModeChanged = false;
+            occlusionStatsDue = true;
+        }
+
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+    }
+
+    destroyFrameStats(frameStats);
+    for (int m = 0; m < STRESS_MESH_COUNT; ++m)
+        destroyMesh(meshes[m]);
+    if (occlusionSupported)
+        destroyOcclusionCuller(occlusion);
+    destroyGeometryArena(arena);
+    glDeleteBuffers(1, &instanceBuffer);
+    glDeleteBuffers(1, &visibleBuffer);
+    glDeleteProgram(shaderProgram);
+
+    glfwTerminate();
+    return 0;
+}
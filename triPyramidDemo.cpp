@@ -4,16 +4,20 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
+#include "shapes.h"
+#include "meshFile.h"
+#include "objectConstants.h"
+#include "idleFrames.h"
 
 const char* vertexShaderSource = R"glsl(
 #version 330 core
 layout (location = 0) in vec3 aPos;
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform mat4 mvp;  // projection * view * model, see objectConstants.h
+uniform vec3 positionScale;  // packed vertex decode, see vertexCompress.h
+uniform vec3 positionBias;
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = mvp * vec4(aPos * positionScale + positionBias, 1.0);
 }
 )glsl";
 
@@ -54,21 +58,6 @@ void processInput(GLFWwindow *window) {
         cameraPos += glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
 }
 
-// Set up vertex data (and buffer(s)) and configure vertex attributes
-    float vertices[] = {
-        // positions
-        -0.5f, -0.5f, -0.5f,
-         0.5f, -0.5f, -0.5f,
-         0.0f,  0.5f,  0.0f,
-         0.0f, -0.5f,  0.5f
-    };
-    unsigned int indices[] = {
-        0, 1, 2,
-        1, 3, 2,
-        3, 0, 2,
-        0, 3, 1
-    };
-
 int main() {
     // Initialize and configure GLFW
     glfwInit();
@@ -91,6 +80,10 @@ int main() {
         return -1;
     }
 
+    // Nothing moves unless the camera does, so the loop sleeps in between
+    IdleFrames idleFrames;
+    initIdleFrames(idleFrames, window);
+
     // Build and compile our shader program
     // Vertex shader
     unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
@@ -128,25 +121,8 @@ int main() {
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
 
-    unsigned int VBO, VAO, EBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
-
-    glBindVertexArray(VAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-    // Position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    // Use the exported mesh when meshExport has been run, otherwise build it here
+    GpuMesh pyramid = loadMeshOr("meshes/triPyramid.rwm", [] { return createTriPyramidMesh(); });
 
     // Unbind VAO (it's always a good thing to unbind any buffer/array to prevent strange bugs)
     glEnable(GL_DEPTH_TEST);
@@ -161,27 +137,30 @@ int main() {
 
         processInput(window);
 
+        uint64_t frameState = hashFrameValue(hashFrameValue(FRAME_HASH_SEED, cameraPos), cameraFront);
+        if (!frameNeedsRender(idleFrames, frameState)) {
+            waitForFrameChange(idleFrames, lastFrame);
+            continue;
+        }
+
         // Rendering commands here
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // Clear the buffers
 
         // Activate shader program
         glUseProgram(shaderProgram);
+        setMeshDecodeUniforms(shaderProgram, pyramid);
 
         // Create transformations and pass them to the vertex shader
         glm::mat4 model = glm::mat4(1.0f);
         glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
         glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        unsigned int modelLoc = glGetUniformLocation(shaderProgram, "model");
-        unsigned int viewLoc = glGetUniformLocation(shaderProgram, "view");
-        unsigned int projLoc = glGetUniformLocation(shaderProgram, "projection");
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, &model[0][0]);
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, &view[0][0]);
-        glUniformMatrix4fv(projLoc, 1, GL_FALSE, &projection[0][0]);
+        glm::mat4 viewProjection = projection * view;
+        ObjectConstants constants = computeObjectConstants(&viewProjection[0][0], &model[0][0]);
+        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "mvp"), 1, GL_FALSE, constants.mvp);
 
         // Render the Triangular Pyramid
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, 12, GL_UNSIGNED_INT, 0);
+        drawMesh(pyramid);
 
         // Check and call events and swap the buffers
         glfwSwapBuffers(window);
@@ -189,9 +168,7 @@ int main() {
     }
 
     // Optional: de-allocate all resources once they've outlived their purpose:
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
+    destroyMesh(pyramid);
 
     glfwTerminate();
     return 0;
@@ -0,0 +1,302 @@
+#ifndef VERTEX_COMPRESS_H
+#define VERTEX_COMPRESS_H
+
+#include <glad/glad.h>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "mesh.h"
+
+// Packs float vertices into smaller GPU formats.
+//
+//   positions  location 0  3 x unorm16 over the mesh bounds (8 bytes with
+//                          padding), 3 x half float, or 10:10:10 unorm (4 bytes)
+//   normals    location 1  GL_INT_2_10_10_10_REV snorm (4 bytes) or
+//                          octahedral 2 x snorm16 (4 bytes)
+//   UVs        location 2  2 x unorm16 when they fit in [0,1], half floats otherwise
+//
+// Attributes at other locations are copied as floats. The formats are all
+// normalized, so the vertex shader gets floats and only has to apply
+// position * positionScale + positionBias (and the octahedral decode when
+// that was chosen); setMeshDecodeUniforms() sets the uniforms. Run this
+// after optimizeMesh, the overdraw pass needs float positions.
+
+enum VertexPositionFormat {
+    VERTEX_POSITION_FLOAT,
+    VERTEX_POSITION_HALF,
+    VERTEX_POSITION_UNORM16,
+    VERTEX_POSITION_UNORM10
+};
+
+enum VertexNormalFormat {
+    VERTEX_NORMAL_FLOAT,
+    VERTEX_NORMAL_INT_2_10_10_10,
+    VERTEX_NORMAL_OCTAHEDRAL
+};
+
+struct VertexFormat {
+    VertexPositionFormat position;
+    VertexNormalFormat normal;
+    bool packUVs;
+};
+
+// 16 bits of position is well under a pixel for every demo mesh
+inline VertexFormat defaultVertexFormat() {
+    VertexFormat format = { VERTEX_POSITION_UNORM16, VERTEX_NORMAL_INT_2_10_10_10, true };
+    return format;
+}
+
+inline VertexFormat uncompressedVertexFormat() {
+    VertexFormat format = { VERTEX_POSITION_FLOAT, VERTEX_NORMAL_FLOAT, false };
+    return format;
+}
+
+// Round to nearest even, with overflow to infinity and gradual underflow
+inline uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t magnitude = bits & 0x7FFFFFFF;
+
+    if (magnitude >= 0x7F800000)                      // inf or NaN
+        return sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0);
+    if (magnitude >= 0x477FF000)                      // rounds past 65504
+        return sign | 0x7C00;
+    if (magnitude < 0x38800000) {                     // half denormal or zero
+        if (magnitude < 0x33000000)
+            return sign;
+        uint32_t mantissa = (magnitude & 0x007FFFFF) | 0x00800000;
+        int shift = 126 - (magnitude >> 23);
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1)))
+            ++half;
+        return sign | half;
+    }
+    uint32_t half = (magnitude - 0x38000000) >> 13;
+    uint32_t rest = magnitude & 0x1FFF;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        ++half;
+    return sign | half;
+}
+
+inline uint32_t quantizeUnorm(float value, int bits) {
+    float maxValue = (float)((1u << bits) - 1);
+    float v = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+    return (uint32_t)(v * maxValue + 0.5f);
+}
+
+inline int32_t quantizeSnorm(float value, int bits) {
+    float maxValue = (float)((1 << (bits - 1)) - 1);
+    float v = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+    return (int32_t)floorf(v * maxValue + 0.5f);
+}
+
+// Signed 10:10:10:2 with x in the low bits, as GL_INT_2_10_10_10_REV reads it
+inline uint32_t packSnorm10x3(float x, float y, float z) {
+    return ((uint32_t)quantizeSnorm(x, 10) & 0x3FF)
+         | (((uint32_t)quantizeSnorm(y, 10) & 0x3FF) << 10)
+         | (((uint32_t)quantizeSnorm(z, 10) & 0x3FF) << 20);
+}
+
+// Maps the unit sphere onto the [-1,1] square: project onto the octahedron,
+// then fold the lower half over the diagonals
+inline void octahedralEncode(float x, float y, float z, float& u, float& v) {
+    float sum = fabsf(x) + fabsf(y) + fabsf(z);
+    if (sum == 0.0f) {
+        u = v = 0.0f;
+        return;
+    }
+    u = x / sum;
+    v = y / sum;
+    if (z < 0.0f) {
+        float fu = (1.0f - fabsf(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+        float fv = (1.0f - fabsf(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+        u = fu;
+        v = fv;
+    }
+}
+
+inline const char* vertexPositionFormatName(VertexPositionFormat format) {
+    switch (format) {
+        case VERTEX_POSITION_HALF: return "half";
+        case VERTEX_POSITION_UNORM16: return "unorm16";
+        case VERTEX_POSITION_UNORM10: return "unorm10";
+        default: return "float";
+    }
+}
+
+// Rewrites mesh.vertices in the packed layout. MeshData keeps its vertices in
+// a float vector, which works as plain 4-byte storage because every packed
+// stride is a multiple of 4. The bounds are computed before the float
+// positions go away and are kept in the mesh.
+inline bool compressVertices(MeshData& mesh, const VertexFormat& format, const char* name = NULL) {
+    if (mesh.quantized || mesh.vertices.empty())
+        return false;
+
+    const size_t vertexCount = meshVertexCount(mesh);
+    const unsigned int oldStride = mesh.stride;
+    const MeshAttrib* position = NULL;
+    const MeshAttrib* normal = NULL;
+    const MeshAttrib* uv = NULL;
+    for (size_t i = 0; i < mesh.layout.size(); ++i) {
+        const MeshAttrib& a = mesh.layout[i];
+        if (a.type != GL_FLOAT)
+            continue;
+        if (a.location == 0 && a.components == 3 && a.offset == 0)
+            position = &a;
+        else if (a.location == 1 && a.components == 3)
+            normal = &a;
+        else if (a.location == 2 && a.components == 2)
+            uv = &a;
+    }
+    if (!position) {
+        std::cerr << "ERROR::VERTEXCOMPRESS::NO_FLOAT3_POSITION" << std::endl;
+        return false;
+    }
+
+    MeshBounds bounds = computeMeshBounds(mesh.vertices.data(), vertexCount, oldStride / sizeof(float));
+    MeshDecode decode = identityMeshDecode();
+
+    // UVs go to unorm16 only if they all fit in [0,1]
+    bool uvUnorm = true;
+    if (uv) {
+        for (size_t v = 0; v < vertexCount && uvUnorm; ++v) {
+            const float* t = (const float*)((const unsigned char*)mesh.vertices.data() + v * oldStride + uv->offset);
+            uvUnorm = t[0] >= 0.0f && t[0] <= 1.0f && t[1] >= 0.0f && t[1] <= 1.0f;
+        }
+    }
+
+    // New layout: position, normal, UV, then anything else as floats
+    std::vector<MeshAttrib> layout;
+    std::vector<const MeshAttrib*> sources;
+    unsigned int offset = 0;
+    MeshAttrib out;
+
+    switch (format.position) {
+        case VERTEX_POSITION_HALF:    out = { 0, 3, GL_HALF_FLOAT, GL_FALSE, offset }; offset += 8; break;
+        case VERTEX_POSITION_UNORM16: out = { 0, 3, GL_UNSIGNED_SHORT, GL_TRUE, offset }; offset += 8; break;
+        case VERTEX_POSITION_UNORM10: out = { 0, 4, GL_UNSIGNED_INT_2_10_10_10_REV, GL_TRUE, offset }; offset += 4; break;
+        default:                      out = { 0, 3, GL_FLOAT, GL_FALSE, offset }; offset += 12; break;
+    }
+    layout.push_back(out);
+    sources.push_back(position);
+
+    if (normal) {
+        switch (format.normal) {
+            case VERTEX_NORMAL_INT_2_10_10_10: out = { 1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offset }; offset += 4; break;
+            case VERTEX_NORMAL_OCTAHEDRAL:     out = { 1, 2, GL_SHORT, GL_TRUE, offset }; offset += 4; break;
+            default:                           out = { 1, 3, GL_FLOAT, GL_FALSE, offset }; offset += 12; break;
+        }
+        layout.push_back(out);
+        sources.push_back(normal);
+    }
+    if (uv) {
+        if (!format.packUVs) {
+            out = { 2, 2, GL_FLOAT, GL_FALSE, offset };
+            offset += 8;
+        } else {
+            out = { 2, 2, (uint32_t)(uvUnorm ? GL_UNSIGNED_SHORT : GL_HALF_FLOAT), (uint32_t)(uvUnorm ? GL_TRUE : GL_FALSE), offset };
+            offset += 4;
+        }
+        layout.push_back(out);
+        sources.push_back(uv);
+    }
+    for (size_t i = 0; i < mesh.layout.size(); ++i) {
+        const MeshAttrib* a = &mesh.layout[i];
+        if (a == position || a == normal || a == uv)
+            continue;
+        out = *a;
+        out.offset = offset;
+        offset += a->components * sizeof(float);
+        layout.push_back(out);
+        sources.push_back(a);
+    }
+    const unsigned int stride = (offset + 3) & ~3u;
+
+    // Positions decode as q * scale + bias, with the scale covering the bounds
+    if (format.position == VERTEX_POSITION_UNORM16 || format.position == VERTEX_POSITION_UNORM10) {
+        for (int k = 0; k < 3; ++k) {
+            float extent = bounds.max[k] - bounds.min[k];
+            decode.positionScale[k] = extent > 0.0f ? extent : 1.0f;
+            decode.positionBias[k] = bounds.min[k];
+        }
+    }
+    if (normal && format.normal == VERTEX_NORMAL_OCTAHEDRAL)
+        decode.normalEncoding = MESH_NORMAL_OCTAHEDRAL;
+
+    std::vector<float> packed((vertexCount * stride) / sizeof(float), 0.0f);
+    const unsigned char* src = (const unsigned char*)mesh.vertices.data();
+    unsigned char* dst = (unsigned char*)packed.data();
+    for (size_t v = 0; v < vertexCount; ++v) {
+        const unsigned char* in = src + v * oldStride;
+        unsigned char* vertexOut = dst + v * stride;
+        for (size_t i = 0; i < layout.size(); ++i) {
+            const MeshAttrib& a = layout[i];
+            const MeshAttrib* s = sources[i];
+            const float* f = (const float*)(in + s->offset);
+            unsigned char* o = vertexOut + a.offset;
+
+            if (s == position && a.type != GL_FLOAT) {
+                float n[3];
+                for (int k = 0; k < 3; ++k)
+                    n[k] = (f[k] - decode.positionBias[k]) / decode.positionScale[k];
+                if (a.type == GL_HALF_FLOAT) {
+                    uint16_t h[3] = { floatToHalf(f[0]), floatToHalf(f[1]), floatToHalf(f[2]) };
+                    memcpy(o, h, sizeof(h));
+                } else if (a.type == GL_UNSIGNED_SHORT) {
+                    uint16_t q[3] = { (uint16_t)quantizeUnorm(n[0], 16), (uint16_t)quantizeUnorm(n[1], 16),
+                                      (uint16_t)quantizeUnorm(n[2], 16) };
+                    memcpy(o, q, sizeof(q));
+                } else {
+                    uint32_t q = quantizeUnorm(n[0], 10) | (quantizeUnorm(n[1], 10) << 10) | (quantizeUnorm(n[2], 10) << 20);
+                    memcpy(o, &q, sizeof(q));
+                }
+            } else if (s == normal && a.type != GL_FLOAT) {
+                float length = sqrtf(f[0] * f[0] + f[1] * f[1] + f[2] * f[2]);
+                float scale = length > 0.0f ? 1.0f / length : 0.0f;
+                float x = f[0] * scale, y = f[1] * scale, z = f[2] * scale;
+                if (a.type == GL_INT_2_10_10_10_REV) {
+                    uint32_t q = packSnorm10x3(x, y, z);
+                    memcpy(o, &q, sizeof(q));
+                } else {
+                    float u, w;
+                    octahedralEncode(x, y, z, u, w);
+                    int16_t q[2] = { (int16_t)quantizeSnorm(u, 16), (int16_t)quantizeSnorm(w, 16) };
+                    memcpy(o, q, sizeof(q));
+                }
+            } else if (s == uv && a.type != GL_FLOAT) {
+                uint16_t q[2];
+                if (a.type == GL_UNSIGNED_SHORT) {
+                    q[0] = (uint16_t)quantizeUnorm(f[0], 16);
+                    q[1] = (uint16_t)quantizeUnorm(f[1], 16);
+                } else {
+                    q[0] = floatToHalf(f[0]);
+                    q[1] = floatToHalf(f[1]);
+                }
+                memcpy(o, q, sizeof(q));
+            } else {
+                memcpy(o, in + s->offset, a.components * sizeof(float));
+            }
+        }
+    }
+
+    if (name) {
+        std::cout << name << ": " << oldStride << " -> " << stride << " bytes per vertex ("
+                  << vertexPositionFormatName(format.position) << " positions, "
+                  << (int)(100.0f * (oldStride - stride) / oldStride + 0.5f) << "% less vertex memory)" << std::endl;
+    }
+
+    mesh.vertices.swap(packed);
+    mesh.layout = layout;
+    mesh.stride = stride;
+    mesh.quantized = true;
+    mesh.decode = decode;
+    mesh.bounds = bounds;
+    return true;
+}
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef WIREFRAME_H
+#define WIREFRAME_H
+
+#include <glad/glad.h>
+#include "shaderUtil.h"
+
+// Single-pass solid + wireframe. The demos used to draw every mesh twice, once
+// filled and once with glPolygonMode(GL_LINE). Here a geometry shader gives each
+// triangle corner a barycentric coordinate, and the fragment shader darkens
+// fragments close to an edge, using fwidth() to keep the lines a constant
+// width in pixels and to anti-alias them. Vertex work and triangle setup happen
+// once, and the lines no longer depth-fight with the fill.
+//
+// Pair the geometry and fragment shaders with any vertex (or tessellation)
+// shader that writes gl_Position.
+
+const char* const wireframeGeometryShaderSource = R"glsl(
+#version 330 core
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 3) out;
+out vec3 barycentric;
+void main()
+{
+    for (int i = 0; i < 3; ++i) {
+        gl_Position = gl_in[i].gl_Position;
+        barycentric = vec3(i == 0, i == 1, i == 2);
+        EmitVertex();
+    }
+    EndPrimitive();
+}
+)glsl";
+
+const char* const wireframeFragmentShaderSource = R"glsl(
+#version 330 core
+in vec3 barycentric;
+out vec4 FragColor;
+uniform vec3 fillColor = vec3(1.0);  // the demos' white solid
+uniform vec3 lineColor = vec3(0.0);  // and black wireframe
+uniform float lineWidth = 1.0;       // pixels
+void main()
+{
+    // Distance to the nearest edge in pixels, faded over one pixel
+    vec3 edgePixels = barycentric / fwidth(barycentric);
+    float edge = min(edgePixels.x, min(edgePixels.y, edgePixels.z));
+    float line = 1.0 - smoothstep(lineWidth * 0.5 - 0.5, lineWidth * 0.5 + 0.5, edge);
+    FragColor = vec4(mix(fillColor, lineColor, line), 1.0);
+}
+)glsl";
+
+// Builds the single-pass variant of a demo program from its vertex stage (and
+// tessellation stages, if it has them)
+inline GLuint createWireframeProgram(const char* vertexSource, const char* tessControlSource = NULL,
+                                     const char* tessEvaluationSource = NULL) {
+    return createShaderProgram(vertexSource, wireframeFragmentShaderSource, wireframeGeometryShaderSource,
+                               tessControlSource, tessEvaluationSource);
+}
+
+// Draws a solid mesh with its wireframe on top. With singlePass the bound
+// program must come from createWireframeProgram and `draw` runs once;
+// otherwise it runs twice, filled and then as lines, with the program's
+// isWireframe uniform switching the color.
+template <typename DrawFn>
+void drawSolidAndWireframe(GLuint program, bool singlePass, DrawFn draw) {
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    if (singlePass) {
+        draw();
+        return;
+    }
+    glUniform1i(glGetUniformLocation(program, "isWireframe"), GL_FALSE);
+    draw();
+    glUniform1i(glGetUniformLocation(program, "isWireframe"), GL_TRUE);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    draw();
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+}
+
+#endif